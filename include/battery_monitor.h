@@ -0,0 +1,53 @@
+#ifndef BATTERY_MONITOR_H
+#define BATTERY_MONITOR_H
+
+#include <Arduino.h>
+#include <esp_adc_cal.h>
+#include <driver/adc.h>
+#include "config.h"
+#include "soc_estimator.h"
+
+// Battery voltage sampling on a fixed schedule. Each sample powers the
+// divider once, takes a burst of ADC reads, keeps the median and folds it
+// into an EMA; readers only ever see the cached, filtered value.
+// Samples taken while the radio transmits are lifted by the learned sag so
+// the filtered value and the state of charge always refer to the cell at rest.
+class BatteryMonitor {
+private:
+    esp_adc_cal_characteristics_t adcCharacteristics;
+    SocEstimator soc;
+    float filteredVoltage;
+    float lastSampleVoltage;
+    float wakeRestVoltage;    // This wake's readings, 0 until taken
+    float wakeLoadedVoltage;
+    unsigned long lastSampleTime;
+    bool hasSample;
+    bool underLoad;
+    bool charging;
+
+    float sampleDivider();
+
+public:
+    BatteryMonitor();
+
+    // Characterise the ADC and take the first sample
+    void begin();
+
+    // Call from the main loop; samples only when BATTERY_SAMPLE_INTERVAL_MS has passed
+    void update();
+    void sampleNow();
+
+    // Radio state and charger state for the next samples
+    void setUnderLoad(bool load) { underLoad = load; }
+    void setCharging(bool isCharging) { charging = isCharging; }
+
+    float getVoltage() const { return filteredVoltage; }  // Rest-equivalent
+    uint8_t getPercent() const { return soc.getPercent(); }
+    bool isLow() const { return soc.isLow(); }
+    bool isCritical() const { return soc.isCritical(); }
+    float getSagVolts() const { return soc.getSagVolts(); }
+    float getLastSampleVoltage() const { return lastSampleVoltage; }
+    bool hasReading() const { return hasSample; }
+};
+
+#endif // BATTERY_MONITOR_H
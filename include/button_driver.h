@@ -0,0 +1,94 @@
+#ifndef BUTTON_DRIVER_H
+#define BUTTON_DRIVER_H
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "config.h"
+#include "spsc_queue.h"
+#include "button_gestures.h"
+
+// Where the four buttons are read from
+enum ButtonInputMode {
+    BUTTON_INPUT_GPIO = 0,     // BUTTON_x_PIN, one edge interrupt each
+    BUTTON_INPUT_PCF8574 = 1   // Expander at PCF_I2C_ADDR, change flagged on PCF_INT_PIN
+};
+
+// Interrupt-driven button input. In GPIO mode each pin's edge interrupt
+// records the change directly; in expander mode the INT line only flags it
+// and the button task does a single I2C read. Edges closer than
+// BUTTON_DEBOUNCE_MS to the previous accepted edge of the same button are
+// dropped and the level is re-checked once the bounce has settled.
+// Accepted edges go through a lock-free queue to the button task, which
+// turns them into timestamped gesture events for the application. The task
+// runs independently of the main loop, so nothing is missed or delayed
+// while the loop blocks.
+class ButtonDriver {
+private:
+    struct PinContext {
+        ButtonDriver* driver;
+        uint8_t button;
+    };
+
+    ButtonInputMode mode;
+    PinContext pinContexts[4];
+    volatile bool levels[4];           // Accepted state, true = pressed
+    volatile uint32_t lastEdgeMs[4];
+    volatile uint8_t settlePending;    // Buttons with a dropped bounce edge
+    volatile bool expanderChanged;     // INT asserted since the last read
+    volatile uint32_t expanderEdgeMs;
+    portMUX_TYPE stateLock;            // Guards levels and serializes edge pushes
+    TaskHandle_t task;
+
+    SpscQueue<ButtonEdge, BUTTON_EVENT_QUEUE_SIZE> edges;    // ISR -> button task
+    SpscQueue<ButtonEvent, BUTTON_EVENT_QUEUE_SIZE> events;  // Button task -> application
+    volatile uint16_t droppedEvents;
+    ButtonGestures gestures;
+
+    static void IRAM_ATTR gpioIsr(void* arg);
+    static void IRAM_ATTR expanderIsr(void* arg);
+    static void taskMain(void* arg);
+    static void emitEvent(const ButtonEvent& event, void* context);
+
+    bool IRAM_ATTR handleLevel(uint8_t button, bool pressed, uint32_t nowMs, bool fromIsr);
+    bool readExpander(bool pressed[4]);
+    void readRaw(bool pressed[4]);
+    void settle(uint32_t nowMs);
+    uint32_t msUntilSettle(uint32_t nowMs) const;
+    void runTask();
+
+public:
+    ButtonDriver();
+
+    bool begin(ButtonInputMode inputMode);
+    void end();
+
+    // Compares every button's level with the accepted state, e.g. after a
+    // light sleep during which edge interrupts were off
+    void resync();
+
+    bool readEvent(ButtonEvent* event);  // Oldest event, false when empty
+    void discardEvents();
+    bool isDown(uint8_t button) const { return button < 4 && levels[button]; }
+    bool isAnyDown() const;
+    uint16_t getDroppedEvents() const { return droppedEvents; }
+    ButtonInputMode getMode() const { return mode; }
+
+    // Swaps the edge interrupts for low-level light-sleep wake sources and back
+    void enableLightSleepWakeup();
+    void disableLightSleepWakeup();
+
+    // Deep-sleep wake: GPIO buttons wake on BUTTON_1 (ext0) and the
+    // WAKE_EXT1_BUTTON_MASK button; expander boards on PCF_INT_PIN (ext0),
+    // shared by all four. Pins and sleep registers only, safe from the
+    // forced-sleep path
+    void enableDeepSleepWakeup();
+    // Reads the expander so its INT line is released before sleeping
+    void releaseWakeLine();
+    // After an ext0 wake on an expander board: the button held now, -1 if
+    // it was already released or no expander answers
+    static int readWakeButton();
+};
+
+#endif // BUTTON_DRIVER_H
@@ -0,0 +1,77 @@
+#ifndef BUTTON_GESTURES_H
+#define BUTTON_GESTURES_H
+
+#include <stdint.h>
+
+// Gesture recognition on debounced button edges. Plain C++ with no Arduino
+// dependencies so it can be exercised on the host with synthetic timings.
+
+// One debounced press or release
+struct ButtonEdge {
+    uint8_t button;   // 0..3
+    bool pressed;
+    uint32_t timeMs;  // millis() when the edge was seen
+};
+
+enum ButtonEventType {
+    BUTTON_EVENT_PRESS = 0,         // Raw edges, always reported
+    BUTTON_EVENT_RELEASE = 1,
+    BUTTON_EVENT_CLICK = 2,         // Short press, reported on release
+    BUTTON_EVENT_DOUBLE_CLICK = 3,  // Second click within the window (after its CLICK)
+    BUTTON_EVENT_LONG = 4,          // Still held after the long-press time
+    BUTTON_EVENT_VERY_LONG = 5,
+    BUTTON_EVENT_CHORD = 6          // Several buttons pressed within the chord window
+};
+
+struct ButtonEvent {
+    uint8_t type;     // ButtonEventType
+    uint8_t button;   // Lowest button involved
+    uint8_t mask;     // Every button involved, bit per button
+    uint32_t timeMs;  // When the gesture was recognized
+};
+
+struct ButtonGestureConfig {
+    uint32_t doubleClickMs;
+    uint32_t longPressMs;
+    uint32_t veryLongPressMs;
+    uint32_t chordWindowMs;
+};
+
+// Clicks are reported as soon as the button is released; a quick second
+// click adds a DOUBLE_CLICK, so a single click never waits for the double
+// click window. A press that became a long press or part of a chord
+// reports no click.
+class ButtonGestures {
+public:
+    typedef void (*EmitFn)(const ButtonEvent& event, void* context);
+
+private:
+    struct Track {
+        bool down;
+        bool inChord;
+        uint8_t longLevel;     // 0 none, 1 long, 2 very long reported
+        bool clickArmed;       // Last release was a click; the next may double it
+        uint32_t pressMs;
+        uint32_t lastClickMs;
+    };
+
+    const ButtonGestureConfig& config;
+    Track tracks[4];
+    EmitFn emitFn;
+    void* emitContext;
+
+    void emit(uint8_t type, uint8_t button, uint8_t mask, uint32_t timeMs);
+    uint8_t downMask() const;
+
+public:
+    ButtonGestures(const ButtonGestureConfig& gestureConfig, EmitFn emitFunction, void* context);
+
+    void reset();
+    void onEdge(const ButtonEdge& edge);
+    // Reports long presses that became due by nowMs
+    void tick(uint32_t nowMs);
+    // Milliseconds until tick() can report something, UINT32_MAX if nothing is pending
+    uint32_t msUntilDeadline(uint32_t nowMs) const;
+};
+
+#endif // BUTTON_GESTURES_H
@@ -0,0 +1,67 @@
+#ifndef BUZZER_H
+#define BUZZER_H
+
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "config.h"
+
+// One step of a tone sequence; frequency 0 is a rest
+struct BuzzerNote {
+    uint16_t frequency;
+    uint16_t durationMs;
+};
+
+// Predefined feedback sounds
+enum BuzzerPattern {
+    BUZZER_CLICK = 0,       // Short acknowledgement
+    BUZZER_TOGGLE_ON = 1,
+    BUZZER_TOGGLE_OFF = 2,
+    BUZZER_ERROR = 3,       // Two low beeps
+    BUZZER_CONFIRM = 4,     // Three beeps, e.g. factory reset done
+    BUZZER_ATTENTION = 5    // Before a destructive action
+};
+
+// Non-blocking buzzer. The tone comes from an LEDC channel and an esp_timer
+// one-shot steps through the notes, so play() returns immediately and the
+// sound runs alongside display refreshes and network work. Starting a new
+// sound replaces the one playing. The main task and the esp_timer task both
+// start notes, so each step (check, advance, LEDC write, re-arm) runs under
+// one mutex; a spinlock would not do, LEDC setup may block or log.
+class Buzzer {
+private:
+    esp_timer_handle_t timer;
+    SemaphoreHandle_t lock;
+    const BuzzerNote* notes;
+    uint8_t noteCount;
+    uint8_t noteIndex;
+    volatile bool playing;
+    uint32_t generation;       // Bumped by play() and stop()
+    uint32_t armedGeneration;  // Sequence the armed timer belongs to
+    bool armed;                // A note's end is pending on the timer
+    BuzzerNote customNote;     // Backing store for tone()
+    bool ready;
+
+    static void onTimer(void* arg);
+    void startNote(uint8_t index);  // Lock held
+    void silence();                 // Lock held
+
+public:
+    Buzzer();
+
+    bool begin();
+    void end();
+
+    void play(BuzzerPattern pattern);
+    void play(const BuzzerNote* sequence, uint8_t count);  // sequence must outlive playback
+    void tone(uint16_t frequency, uint16_t durationMs);
+    void stop();
+
+    bool isPlaying() const { return playing; }
+    // Blocks until the current sound has finished, at most timeoutMs.
+    // For the moments the CPU is about to stop (deep sleep, restart).
+    void finish(uint32_t timeoutMs = 2000);
+};
+
+#endif // BUZZER_H
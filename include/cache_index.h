@@ -0,0 +1,67 @@
+#ifndef CACHE_INDEX_H
+#define CACHE_INDEX_H
+
+#include <Arduino.h>
+#include "config.h"
+
+class PaperdInkHardware;
+
+// CacheEntry::frameFlags
+#define CACHE_FRAME_RENDERED 0x01  // <filename>.raw holds a pre-rendered 1-bit frame
+#define CACHE_FRAME_INVERTED 0x02  // ...rendered with the display inverted
+
+// One cached screen as stored on the SD card
+struct CacheEntry {
+    char filename[CACHE_FILENAME_MAX];  // Stored name (see CacheIndex::storedName)
+    uint32_t seq;       // Playlist position: order in which the server first served it
+    uint32_t lastUsed;  // LRU clock value of the last time the server served it
+    uint32_t size;
+    uint8_t frameFlags;
+};
+
+// Fixed-size LRU index of cached screens, persisted as a small binary file
+// next to the images so offline wakes can rotate without the network.
+class CacheIndex {
+private:
+    CacheEntry entries[MAX_CACHED_IMAGES];
+    uint8_t count;
+    uint32_t nextSeq;
+    uint32_t useClock;
+    bool loaded;
+    bool dirty;
+
+    int findSlot(const char* filename) const;
+    int leastRecentlyUsedSlot() const;
+    void removeSlot(int slot);
+
+public:
+    CacheIndex();
+
+    // Name a server filename is indexed and stored under in CACHE_DIR: the
+    // name itself when it fits CACHE_FILENAME_MAX and has no path
+    // separator, otherwise its start plus a hash of the whole name. Stored
+    // names map to themselves. All lookups below take either form.
+    static String storedName(const char* filename);
+
+    // Persistence (caller should hold the SD card across load/modify/save)
+    bool load(PaperdInkHardware* hardware);
+    bool save(PaperdInkHardware* hardware);
+    bool isLoaded() const { return loaded; }
+    void clear();
+
+    // Marks filename as served now. Returns false if adding it evicted the
+    // least recently used entry, whose filename is copied to evicted.
+    bool touch(const char* filename, uint32_t size, String* evicted);
+    bool remove(const char* filename);
+    void setFrameFlags(const char* filename, uint8_t flags);
+
+    // Lookup
+    const CacheEntry* find(const char* filename) const;
+    const CacheEntry* nextInPlaylist(uint32_t afterSeq) const;
+    const CacheEntry* prevInPlaylist(uint32_t beforeSeq) const;
+    const CacheEntry* entryAt(uint8_t index) const;
+    uint8_t size() const { return count; }
+    uint32_t getUseClock() const { return useClock; }
+};
+
+#endif // CACHE_INDEX_H
@@ -0,0 +1,62 @@
+#ifndef CIRCUIT_BREAKER_H
+#define CIRCUIT_BREAKER_H
+
+#include <stdint.h>
+
+// Circuit breaker for a dependency that is expensive to try (radio, backend).
+// Plain C++ with no Arduino dependencies; the caller passes the time in.
+
+enum CircuitState {
+    CIRCUIT_CLOSED = 0,     // Requests go through; failures are counted
+    CIRCUIT_OPEN = 1,       // Requests are skipped until retryAt
+    CIRCUIT_HALF_OPEN = 2   // One trial request is under way
+};
+
+// Persisted part; the owner keeps it somewhere that outlives a wake (RTC memory)
+struct CircuitBreakerState {
+    uint8_t state;     // CircuitState
+    uint8_t failures;  // Consecutive failures while closed
+    uint8_t trips;     // Consecutive openings since the last success; sets the backoff
+    int64_t retryAt;   // Time (s) at which an open breaker lets a trial through
+};
+
+struct CircuitBreakerConfig {
+    uint8_t failureThreshold;     // Consecutive failures that open the breaker
+    uint32_t baseBackoffSeconds;  // First open period, doubled per trip
+    uint32_t maxBackoffSeconds;
+};
+
+// Closed until failureThreshold failures in a row, then open for
+// baseBackoffSeconds. The first request after that is a trial: success
+// closes the breaker, failure opens it again for twice as long, up to
+// maxBackoffSeconds. A trial that never reported back (the wake died) counts
+// as failed.
+class CircuitBreaker {
+private:
+    CircuitBreakerState& state;
+    const CircuitBreakerConfig& config;
+
+    void open(int64_t now);
+
+public:
+    CircuitBreaker(CircuitBreakerState& persisted, const CircuitBreakerConfig& breakerConfig);
+
+    // Fresh closed state, e.g. for a cold boot
+    static CircuitBreakerState initialState();
+
+    // True if the request should be made; moves a due open breaker to half-open
+    bool allowRequest(int64_t now);
+    void recordSuccess();
+    void recordFailure(int64_t now);
+
+    CircuitState getState() const { return (CircuitState)state.state; }
+    uint8_t getFailures() const { return state.failures; }
+    uint8_t getTrips() const { return state.trips; }
+    // Attempts to spend on the request: normalAttempts while closed and
+    // healthy, a single one once something has failed
+    uint8_t attemptsAllowed(uint8_t normalAttempts) const;
+    uint32_t backoffSeconds() const;
+    uint32_t secondsUntilRetry(int64_t now) const;
+};
+
+#endif // CIRCUIT_BREAKER_H
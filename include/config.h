@@ -34,6 +34,12 @@
 // SD Card Pins
 #define SD_CS_PIN 21
 #define SD_ENABLE_PIN 5
+#define SD_POWER_UP_TIMEOUT_MS 250  // Max wait for the card after power-on
+#define SD_POLL_INTERVAL_MS 5       // Retry interval while the card comes up
+#define SD_WIPE_MAX_DEPTH 8          // Directory levels the wipe walker descends
+#define SD_WIPE_PATH_MAX 128         // Longest path the wipe walker handles
+#define SD_WIPE_PROGRESS_INTERVAL 500  // Entries removed between progress reports
+#define SD_WIPE_DISPLAY_INTERVAL_MS 10000  // Shortest gap between progress refreshes on the panel
 
 // E-paper Display Pins
 #define EPD_CS_PIN 22
@@ -41,6 +47,7 @@
 #define EPD_BUSY_PIN 34
 #define EPD_RESET_PIN 13
 #define EPD_ENABLE_PIN 12
+#define EPD_POWER_SETTLE_MS 10  // Rail rise time before the controller is reset
 
 // PCF8574 Pins
 #define PCF_INT_PIN 35
@@ -60,19 +67,59 @@
 
 // Buzzer
 #define BUZZER_PIN 26
+#define BUZZER_LEDC_CHANNEL 0           // Tone generator, notes stepped by an esp_timer
+#define BUZZER_LEDC_RESOLUTION_BITS 10
 
 // Display Configuration
 #define DISPLAY_WIDTH 400
 #define DISPLAY_HEIGHT 300
 #define DISPLAY_ROTATION 0
+#define DISPLAY_FRAME_BYTES ((DISPLAY_WIDTH * DISPLAY_HEIGHT) / 8)  // 1-bit frame buffer
 
 // Power Management
 #define DEEP_SLEEP_DURATION_SECONDS 1800  // 30 minutes default
 #define LOW_BATTERY_THRESHOLD 3.2  // Volts
 #define CRITICAL_BATTERY_THRESHOLD 3.0  // Volts
 
+// Battery Monitor (scheduled, filtered ADC sampling)
+#define BATTERY_SAMPLE_INTERVAL_MS 30000  // Between divider bursts while awake
+#define BATTERY_SAMPLE_COUNT 9            // Reads per burst, median kept
+#define BATTERY_SETTLE_MS 10              // Divider settle time after enable
+#define BATTERY_EMA_WEIGHT 0.3f           // Weight of the newest burst
+#define BATTERY_DIVIDER_RATIO 2.0f
+#define BATTERY_ADC_DEFAULT_VREF_MV 1100  // Used when the eFuse has no calibration
+
+// State of Charge (open-circuit LiPo curve {mV, %}, full to empty)
+#define BATTERY_SOC_CURVE { {4200, 100}, {4100, 92}, {4000, 81}, {3900, 68}, {3800, 55}, \
+                            {3750, 45}, {3700, 34}, {3650, 24}, {3600, 16}, {3500, 7}, \
+                            {3400, 3}, {3300, 0} }
+#define BATTERY_SOC_HYSTERESIS 3          // Percent steps smaller than this are ignored
+#define BATTERY_FLAG_HYSTERESIS 0.05f     // Volts above threshold to clear low/critical
+#define BATTERY_SAG_WEIGHT 0.25f          // EMA weight of a new TX sag measurement
+#define BATTERY_SAG_MAX 0.4f              // Larger rest/load gaps are discarded
+
+// Refresh Policy (sleep interval from battery, quiet hours and unchanged content)
+#define REFRESH_SOC_CURVE { {50, 100}, {30, 150}, {15, 250}, {5, 400} }  // {SoC %, interval %}
+#define REFRESH_QUIET_START_SECOND (23 * 3600L)  // Local time; equal start/end disables
+#define REFRESH_QUIET_END_SECOND (6 * 3600L)
+#define REFRESH_UNCHANGED_STRETCH_MAX 4          // Interval multiplier cap for repeats
+#define REFRESH_MIN_SLEEP_SECONDS 60
+#define REFRESH_MAX_SLEEP_SECONDS 86400
+#define TIME_ZONE "CET-1CEST,M3.5.0,M10.5.0/3"   // POSIX TZ for quiet hours
+#define NTP_SERVER "pool.ntp.org"
+
+// Energy Model (average current per phase; tune against a bench measurement)
+#define BATTERY_CAPACITY_MAH 2000.0f
+#define ENERGY_CPU_ACTIVE_MA 45.0f      // CPU awake at 240 MHz, radio off
+#define ENERGY_CPU_LOW_MA 22.0f         // CPU awake at 80 MHz (linear in between)
+#define ENERGY_RADIO_MA 110.0f          // Added while WiFi is on
+#define ENERGY_PANEL_REFRESH_MA 8.0f    // Added during an e-paper refresh
+#define ENERGY_DEEP_SLEEP_MA 0.08f      // Whole board in deep sleep
+#define ENERGY_AVERAGE_WEIGHT 0.2f      // EMA weight of the newest cycle
+
 // WiFi Configuration
 #define WIFI_CONNECT_TIMEOUT_MS 30000
+#define WIFI_POLL_INTERVAL_MS 20  // Association status poll while waiting
 #define WIFI_MAX_RETRIES 5
 #define CONFIG_PORTAL_TIMEOUT_MS 300000  // 5 minutes
 
@@ -81,11 +128,45 @@
 #define MAX_IMAGE_SIZE 122880  // 120KB max image size
 #define CACHE_ENABLED true
 #define MAX_CACHED_IMAGES 10
+#define CACHE_DIR "/cache"
+#define CACHE_INDEX_PATH "/cache/index.bin"
+#define CACHE_FILENAME_MAX 64
+
+// Charging Mode (cache warm-up on external power)
+#define CHARGING_PREFETCH_MAX_ITEMS MAX_CACHED_IMAGES  // Playlist items fetched per warm-up
+#define LOG_BUFFER_DIR "/logs"
+#define LOG_BUFFER_PATH "/logs/pending.log"
+#define LOG_BUFFER_MAX_BYTES 8192  // Drop new log lines once the buffer is this big
+
+// Offline Mode
+#define RADIO_BREAKER_FAILURE_THRESHOLD 3        // Failed wakes in a row before the radio is skipped
+#define RADIO_BREAKER_BASE_BACKOFF_SECONDS 900   // First radio-off period, doubled per trip
+#define RADIO_BREAKER_MAX_BACKOFF_SECONDS 21600  // Longest gap between trial wakes (6 h)
+#define DISPLAY_API_MAX_ATTEMPTS 3               // While healthy; one once the radio is failing
+
+// Idle (light sleep between events while awake)
+#define IDLE_LOOP_MAX_MS 1000        // Longest main-loop nap before re-checking schedules
+#define IDLE_POLL_INTERVAL_MS 100    // Plain delay when light sleep is not possible
+#define IDLE_LIGHT_SLEEP_MIN_MS 20   // Shorter waits are not worth a sleep transition
 
 // Button Configuration
-#define BUTTON_DEBOUNCE_MS 50
+#ifndef BUTTON_INPUT_MODE
+#define BUTTON_INPUT_MODE BUTTON_INPUT_GPIO  // BUTTON_INPUT_PCF8574 on expander boards
+#endif
+#define PCF_BUTTON_BITS { 4, 5, 6, 7 }  // Expander port bit of buttons 1..4
+#define BUTTON_EVENT_QUEUE_SIZE 16      // Edges/events buffered, power of two
+#define BUTTON_DEBOUNCE_MS 50           // Per button, from the last accepted edge
 #define BUTTON_LONG_PRESS_MS 2000
 #define BUTTON_VERY_LONG_PRESS_MS 5000
+#define BUTTON_DOUBLE_CLICK_MS 350      // Second click within this adds a double click
+#define BUTTON_CHORD_WINDOW_MS 150      // Presses this close together form a chord
+
+// Deep-sleep wake buttons with direct GPIO buttons: BUTTON_1 (refresh) wakes
+// via ext0 and exactly one more button via ext1. ESP32 ext1 only knows
+// ALL_LOW/ANY_HIGH, so with active-low buttons a multi-pin mask would wake
+// only when all of them are held together; the build rejects that
+#define WAKE_EXT1_BUTTON_MASK (1ULL << BUTTON_4_PIN)  // Local action, no radio
+#define WAKE_STATUS_SCREEN_MS 30000  // Status screen shown after a B3 wake
 
 // Debug Configuration
 #ifdef DEVELOPMENT_MODE
@@ -95,4 +176,55 @@
 #define DEBUG_ENABLED false
 #endif
 
+// Wake-cycle profiler (span timings kept in RTC memory across deep sleep)
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED DEBUG_ENABLED
+#endif
+#define PROFILER_MAX_SPANS 16       // Spans recorded per wake
+#define PROFILER_HISTORY_CYCLES 4   // Wakes kept in RTC memory
+#define PROFILER_ID_LENGTH 12       // Span names are truncated to 11 chars
+
+// CPU frequency per wake phase, driven by the profiler's phase markers
+#ifndef CPU_SCALING_ENABLED
+#define CPU_SCALING_ENABLED true
+#endif
+#ifndef CPU_SCALING_POLICY
+#define CPU_SCALING_POLICY CPU_POLICY_PHASED  // CPU_POLICY_FIXED, _PHASED or _ALTERNATE (A/B by wake)
+#endif
+#define CPU_FREQ_LOW_MHZ 80         // Radio and panel waits; WiFi needs at least 80
+#define CPU_FREQ_HIGH_MHZ 240       // TLS and PNG decode
+#define CPU_PHASE_STACK_DEPTH 8     // Nested phases tracked
+
+// Wake budget: every wake ends in deep sleep, whatever hangs
+#ifndef WAKE_WATCHDOG_ENABLED
+#define WAKE_WATCHDOG_ENABLED true
+#endif
+#define WAKE_BUDGET_MS 90000             // Soft deadline: abort network work, show cache, sleep
+#define WAKE_BUDGET_GRACE_MS 20000       // Then the hard deadline forces deep sleep
+#define WAKE_OVERRUN_RETRY_SECONDS 900   // Sleep after a forced sleep
+#define WAKE_WATCHDOG_PHASE_DEPTH 8      // Nested phases tracked for the overrun record
+
+// Firmware update (streamed into the inactive OTA slot)
+#define OTA_BUFFER_SIZE 4096             // Bytes per read/flash-write step
+#define OTA_MAX_RESUMES 5                // Range requests after a dropped transfer
+#define OTA_STALL_TIMEOUT_MS 15000       // No data for this long counts as dropped
+#define OTA_WAKE_BUDGET_MS 300000        // Wake budget while an image is downloading
+#define OTA_MIN_BATTERY_PERCENT 30       // Unless charging
+#define OTA_MAX_INSTALL_ATTEMPTS 2       // Rollbacks before an image is no longer installed
+#ifndef OTA_DELTA_ENABLED
+#define OTA_DELTA_ENABLED true           // Try firmware_delta_url before the full image
+#endif
+
+// LAN push (PUT an image straight to the panel while the radio is up; opt-in)
+#ifndef PUSH_SERVER_ENABLED
+#define PUSH_SERVER_ENABLED false
+#endif
+#define PUSH_SERVER_PORT 80
+#define PUSH_SERVER_PATH "/image"
+#ifndef PUSH_SERVER_TOKEN
+#define PUSH_SERVER_TOKEN ""             // Required; the server stays off while empty
+#endif
+#define PUSH_AWAKE_WINDOW_MS 20000       // On battery, listen this long after a refresh; 0 = charging only
+#define PUSH_READ_TIMEOUT_MS 5000        // Whole request, head and body
+
 #endif // CONFIG_H
\ No newline at end of file
@@ -0,0 +1,87 @@
+#ifndef DELTA_PATCH_H
+#define DELTA_PATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Firmware delta format and patcher. Plain C++ with no Arduino dependencies
+// so it can be exercised on the host (env:native) against real images.
+//
+// A delta file is an uncompressed header followed by a zlib stream of
+// sequential bsdiff records, all integers little-endian:
+//
+//   header   "PDDELTA1", u32 baseSize, u32 targetSize,
+//            u8[32] SHA-256 of base[0, baseSize), u8[32] SHA-256 of the target
+//   record   u32 diffLen, u32 extraLen, i32 seek,
+//            diffLen bytes   target = base[pos + i] + diff[i]; pos += diffLen
+//            extraLen bytes  copied to the target as they are
+//            pos += seek
+//
+// These are bsdiff's control/diff/extra blocks interleaved per control
+// triple, so the patch can be applied front to back: the target is written
+// strictly sequentially, the base is read at random offsets.
+
+#define DELTA_MAGIC "PDDELTA1"
+#define DELTA_HEADER_SIZE 80
+
+struct DeltaHeader {
+    uint32_t baseSize;
+    uint32_t targetSize;
+    uint8_t baseSha256[32];
+    uint8_t targetSha256[32];
+};
+
+// False if data is not a delta header
+bool parseDeltaHeader(const uint8_t* data, size_t length, DeltaHeader* header);
+
+// Reads base bytes; returns false on a read error
+typedef bool (*DeltaReadFn)(void* context, uint32_t offset, uint8_t* buffer, size_t length);
+// Takes the next target bytes; returns false to abort
+typedef bool (*DeltaWriteFn)(void* context, const uint8_t* data, size_t length);
+
+class DeltaPatcher {
+public:
+    static const size_t CHUNK_SIZE = 256;  // Base bytes read per step
+
+private:
+    enum Stage {
+        STAGE_CONTROL,
+        STAGE_DIFF,
+        STAGE_EXTRA,
+        STAGE_DONE,
+        STAGE_FAILED
+    };
+
+    DeltaReadFn readBase;
+    DeltaWriteFn writeTarget;
+    void* context;
+
+    DeltaHeader header;
+    Stage stage;
+    uint8_t control[12];
+    uint8_t controlFill;
+    uint32_t diffLeft;
+    uint32_t extraLeft;
+    int32_t seek;
+    int64_t basePos;
+    uint32_t produced;
+    uint8_t chunk[CHUNK_SIZE];
+
+    size_t applyDiff(const uint8_t* data, size_t length);
+    size_t copyExtra(const uint8_t* data, size_t length);
+    void nextRecord();
+
+public:
+    DeltaPatcher(DeltaReadFn reader, DeltaWriteFn writer, void* callbackContext);
+
+    void begin(const DeltaHeader& deltaHeader);
+    // Decompressed record bytes, in any split. False once the patch is
+    // malformed or a callback failed; further input is ignored
+    bool feed(const uint8_t* data, size_t length);
+
+    bool isComplete() const { return stage == STAGE_DONE; }
+    bool hasFailed() const { return stage == STAGE_FAILED; }
+    uint32_t getProduced() const { return produced; }
+};
+
+#endif // DELTA_PATCH_H
@@ -0,0 +1,72 @@
+#ifndef ENERGY_MODEL_H
+#define ENERGY_MODEL_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "power_phases.h"
+
+// Phases with their own current draw on top of the active CPU
+enum EnergyPhase {
+    ENERGY_RADIO = 0,  // WiFi on (WiFi.begin() until the radio is shut down)
+    ENERGY_PANEL = 1,  // E-paper refresh
+    ENERGY_PHASE_COUNT
+};
+
+// How the wake talked to the backend; each keeps its own averages
+enum ApiTransport {
+    API_TRANSPORT_TLS = 0,    // HTTPS
+    API_TRANSPORT_PLAIN = 1,  // Plain HTTP to a trusted LAN server
+    API_TRANSPORT_COUNT
+};
+
+// Per-wake energy accounting: phase durations times the ENERGY_*_MA
+// coefficients from config.h give mAh per cycle (wake plus the following
+// deep sleep). A running average lives in RTC memory and drives the
+// battery-life projection. CPU current scales with the clock PowerPhases
+// selects, and each CPU policy keeps its own average charge per wake so the
+// policies can be compared; the same goes for the API transport of wakes that
+// reached the backend. Always built in; it only keeps a few counters.
+class EnergyModel {
+public:
+    static void beginPhase(EnergyPhase phase);
+    static void endPhase(EnergyPhase phase);
+
+    // Call right before the CPU clock changes to mhz
+    static void noteCpuFrequency(uint32_t mhz);
+    // Policy this wake runs under; its charge goes into that policy's average
+    static void setCpuPolicy(CpuPolicy policy);
+    // Transport of this wake's backend requests; wakes without one are not
+    // counted per transport
+    static void setTransport(ApiTransport transport);
+
+    // Call right before deep sleep, once every phase has ended
+    static void closeCycle(uint32_t sleepSeconds);
+
+    // Charge for one cycle with the given phase durations; cpuMa is the
+    // average CPU current over the wake
+    static float cycleMah(uint32_t awakeMs, uint32_t radioMs, uint32_t panelMs, uint32_t sleepSeconds,
+                          float cpuMa = ENERGY_CPU_ACTIVE_MA);
+    static float cpuMaAt(uint32_t mhz);
+
+    static float getLastCycleMah();
+    static float getAverageCycleMah();
+    static uint32_t getAverageCycleSeconds();
+    static uint32_t getLastAwakeMs();
+
+    // Average charge of the wake alone (sleep excluded) under one policy;
+    // 0 while that policy has no cycle yet
+    static float getPolicyWakeMah(CpuPolicy policy);
+    static uint32_t getPolicyCycles(CpuPolicy policy);
+    // "fixed 0.412/6.1s/12 phased 0.377/6.4s/11" (mAh per wake / awake time / cycles)
+    static String policySummary();
+
+    static float getTransportWakeMah(ApiTransport transport);
+    static uint32_t getTransportCycles(ApiTransport transport);
+    // "https 0.412/6.1s/12 http 0.301/4.4s/9", as policySummary()
+    static String transportSummary();
+
+    // Days until empty at the average cycle cost; 0 when nothing measured yet
+    static float projectedDays(int batteryPercent);
+};
+
+#endif // ENERGY_MODEL_H
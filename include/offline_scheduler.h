@@ -0,0 +1,40 @@
+#ifndef OFFLINE_SCHEDULER_H
+#define OFFLINE_SCHEDULER_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "circuit_breaker.h"
+
+// Decides, per wake, whether the radio is worth powering up while the
+// network is down. A circuit breaker in RTC memory counts failed wakes
+// across deep sleep, skips the radio once RADIO_BREAKER_FAILURE_THRESHOLD
+// wakes in a row failed and lets a single trial through on an exponential
+// schedule. A cold boot always starts online.
+class OfflineScheduler {
+private:
+    CircuitBreaker breaker;
+
+public:
+    OfflineScheduler();
+
+    // Call once per wake, before the radio is powered. Returns false while
+    // the breaker is open, in which case the wake should only rotate cached
+    // content.
+    bool shouldAttemptRadio();
+
+    void recordRadioFailure();
+    void recordRadioSuccess();
+
+    bool isOffline() const;
+    CircuitState getBreakerState() const;
+    uint8_t getRadioFailures() const;
+    uint32_t getSecondsUntilRadio() const;
+    // Attempts a request may spend: normalAttempts while healthy, one once failing
+    uint8_t getRadioAttempts(uint8_t normalAttempts) const;
+
+    // Playlist position of the screen currently shown (CacheEntry::seq)
+    uint32_t getRotationCursor() const;
+    void setRotationCursor(uint32_t seq);
+};
+
+#endif // OFFLINE_SCHEDULER_H
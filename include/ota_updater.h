@@ -0,0 +1,101 @@
+#ifndef OTA_UPDATER_H
+#define OTA_UPDATER_H
+
+#include <Arduino.h>
+#include <WiFiClientSecure.h>
+#include <HTTPClient.h>
+#include <mbedtls/sha256.h>
+#include "config.h"
+
+// Streaming firmware update into the inactive OTA slot (min_spiffs.csv has
+// two). The HTTP body goes through a fixed OTA_BUFFER_SIZE buffer into
+// Update.write() and a running SHA-256; the image is never held in RAM. A
+// dropped or stalled transfer is resumed with a Range request from the last
+// byte written, so the whole update completes within one wake. The new slot
+// only becomes the boot image once the hash (when the server supplied one)
+// and ESP-IDF's own image check pass.
+//
+// After the restart the new image runs on probation: the first successful
+// display refresh confirms it; a wake that goes to sleep without one rolls
+// back to the previous image, as does the bootloader if it never gets that
+// far. An image that failed its health check OTA_MAX_INSTALL_ATTEMPTS times
+// is not installed again.
+//
+// With a delta URL the server sends a patch against the running image
+// instead (format in delta_patch.h). It is inflated through a 32 KB window
+// and applied record by record, reading the base from the running slot; the
+// result goes through the same hash and image checks. Any delta failure
+// falls back to the full image within the same call.
+
+struct DeltaSession;
+
+class OtaUpdater {
+private:
+    friend struct DeltaSession;
+
+    enum PumpResult {
+        PUMP_COMPLETE,     // All imageSize bytes written
+        PUMP_INTERRUPTED,  // Connection dropped or stalled; resume with Range
+        PUMP_FAILED        // Flash write failed; give up
+    };
+
+    WiFiClientSecure& client;
+    WiFiClient& plainClient;     // For http:// URLs from a LAN server
+    String plainHttpBase;        // The http:// API base URL; empty: TLS only
+    uint8_t buffer[OTA_BUFFER_SIZE];
+    mbedtls_sha256_context sha;  // Of the image written to flash
+    size_t streamSize;           // Length of the download (image or patch)
+    size_t received;             // Bytes of it consumed so far
+    size_t written;              // Image bytes accepted by Update.write()
+    String expectedSha;          // Hex; empty when unknown
+    DeltaSession* delta;         // Set while a patch is being applied
+    bool installedDelta;
+    String lastError;
+
+    bool download(const String& url, const String& apiKey);
+    int openStream(HTTPClient& http, const String& url, const String& apiKey);
+    bool restartStream(int contentLength);
+    PumpResult pumpStream(HTTPClient& http);
+    bool consume(const uint8_t* data, size_t length);
+    bool writeImage(const uint8_t* data, size_t length);
+    bool finishImage();
+
+    // Delta path
+    bool consumeDelta(const uint8_t* data, size_t length);
+    bool beginDelta();
+    void endDelta();
+    static bool readBase(void* context, uint32_t offset, uint8_t* data, size_t length);
+    static bool writeTarget(void* context, const uint8_t* data, size_t length);
+
+public:
+    OtaUpdater(WiFiClientSecure& tlsClient, WiFiClient& httpClient);
+
+    // Downloads url into the inactive slot and selects it for the next boot.
+    // expectedSha256 is lowercase or uppercase hex, empty when unknown. A
+    // deltaUrl is tried first. True means the caller should restart.
+    bool update(const String& url, const String& expectedSha256, const String& apiKey,
+                const String& deltaUrl = "");
+    const String& getLastError() const { return lastError; }
+    bool wasDelta() const { return installedDelta; }
+
+    // http:// firmware URLs are only fetched from the host and port of this
+    // base URL (the configured LAN server); empty rejects all of them
+    void setPlainHttpBase(const String& baseUrl) { plainHttpBase = baseUrl; }
+    // True if url is http:// on the same host and port as the http:// baseUrl
+    static bool isPlainHttpAllowed(const String& url, const String& baseUrl);
+
+    // Identity of an image for the rejection list: its hash when known,
+    // else the URL without the query string (signed URLs change per request)
+    static String imageKey(const String& url, const String& expectedSha256);
+    static bool isRejected(const String& key);
+
+    // Post-boot health check. beginHealthCheck() runs once early in setup();
+    // the first good refresh calls confirmHealthy(), the sleep path
+    // failHealthCheck() (rolls back and reboots while still on probation).
+    static void beginHealthCheck();
+    static bool isHealthCheckPending();
+    static void confirmHealthy();
+    static void failHealthCheck();
+};
+
+#endif // OTA_UPDATER_H
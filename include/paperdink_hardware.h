@@ -10,17 +10,17 @@
 #include <Wire.h>
 #include <Preferences.h>
 #include "config.h"
+#include "settings_store.h"
+#include "wake_snapshot.h"
+#include "battery_monitor.h"
+#include "button_driver.h"
+#include "buzzer.h"
 
 // Forward declarations
 class GxEPD2_GFX;
 
-// Button states
-enum ButtonState {
-    BUTTON_RELEASED = 0,
-    BUTTON_PRESSED = 1,
-    BUTTON_LONG_PRESS = 2,
-    BUTTON_VERY_LONG_PRESS = 3
-};
+// Progress callback for long SD operations: entries removed so far
+typedef void (*StorageProgressCallback)(uint32_t removed, void* context);
 
 // Display types
 enum DisplayType {
@@ -28,6 +28,13 @@ enum DisplayType {
     DISPLAY_3C = 1      // 3-Color (Black, White, Red)
 };
 
+// Panel power, from least to most current drawn
+enum DisplayPowerState {
+    DISPLAY_POWER_OFF = 0,         // Rail cut; the image stays, the controller is unconfigured
+    DISPLAY_POWER_HIBERNATED = 1,  // Rail on, controller in deep sleep
+    DISPLAY_POWER_READY = 2        // Initialized and able to refresh
+};
+
 // Power states
 enum PowerState {
     POWER_ACTIVE = 0,
@@ -40,41 +47,53 @@ private:
     // Display objects
     GxEPD2_GFX* display;
     DisplayType displayType;
+    uint32_t panelGeneration;  // Incremented whenever the panel is redrawn
+    DisplayPowerState displayPower;
+    bool displayInitialRefresh;  // Next init must assume unknown panel content
 
-    // Button states
-    unsigned long buttonPressTime[4];
-    ButtonState buttonStates[4];
-    bool buttonPressed[4];
+    // Buttons (interrupt driven, gestures recognized off the main loop)
+    ButtonDriver buttons;
+
+    // Buzzer (plays in the background)
+    Buzzer buzzer;
 
     // Power management
-    float batteryVoltage;
+    BatteryMonitor battery;
     bool chargingStatus;
     bool lowBattery;
+    int64_t timerWakeAt;  // System time (s) the sleep timer fires, 0 if unknown
 
-    // SD Card
+    // SD Card (mounted lazily, powered only while in use)
     bool sdCardAvailable;
+    bool sdCardProbed;
+    bool sdCardMounted;
+    uint8_t sdSessionDepth;
 
-    // Display options
-    bool invertDisplayFlag = false;
-
-    // Preferences for persistent storage
+    // Preferences for persistent storage; settings are mirrored in RAM and
+    // committed once before sleep or restart
     Preferences preferences;
+    bool preferencesOpen;
+    SettingsStore settings;
 
     // Private methods
     void initializePins();
-    bool initializeDisplay();
-    void initializeSDCard();
+    bool initializeDisplay(bool keepContent = false);
+    void wakeDisplay();
+    void sleepDisplay();
+    bool mountSDCard();
+    void unmountSDCard();
+    bool openPreferences();
     void initializeButtons();
-    void updateButtonStates();
-    float readBatteryVoltage();
     bool checkChargingStatus();
 
 public:
     PaperdInkHardware();
     ~PaperdInkHardware();
 
-    // Initialization
-    bool begin();
+    // Initialization; a snapshot from RTC memory skips the NVS read
+    bool begin(const HardwareSnapshot* snapshot = nullptr);
+    void restoreSnapshot(const HardwareSnapshot& snapshot);
+    void captureSnapshot(HardwareSnapshot& snapshot) const;
     void end();
 
     // Display methods
@@ -83,29 +102,41 @@ public:
     void updateDisplay();
     void partialUpdateDisplay();
     void displayImage(const uint8_t* imageData, size_t imageSize);
+    bool renderImageToFrame(const uint8_t* imageData, size_t imageSize, uint8_t* frame);
     void displayText(const char* text, int x, int y, int size = 2);
     void displayBitmap(const uint8_t* bitmap, int x, int y, int w, int h);
     void setRotation(int rotation);
+    // The panel is powered only while it refreshes; these force the state
     void powerOffDisplay();
     void powerOnDisplay();
+    DisplayPowerState getDisplayPowerState() const { return displayPower; }
+    uint32_t getPanelGeneration() const { return panelGeneration; }  // Bumped on every refresh
 
     // Display options
     void setInvertDisplay(bool invert);
     bool getInvertDisplay() const;
 
-    // Button methods
-    void updateButtons();
-    ButtonState getButtonState(int buttonNum);
-    bool isButtonPressed(int buttonNum);
-    bool isButtonLongPressed(int buttonNum);
-    bool isButtonVeryLongPressed(int buttonNum);
-    void resetButtonState(int buttonNum);
+    // Button methods; gestures arrive as timestamped events in order
+    bool readButtonEvent(ButtonEvent* event);
+    void discardButtonEvents();
+    bool isButtonHeld(int buttonNum);  // Physically down right now
 
     // Power management
     void enablePeripherals();
     void disablePeripherals();
     void enterLightSleep(uint32_t sleepTimeMs);
+    // Wait up to timeoutMs, returning early on a button press. Light-sleeps
+    // unless the radio is up or a button is held (long-press timing)
+    void idle(uint32_t timeoutMs);
     void enterDeepSleep(uint32_t sleepTimeSeconds);
+    // Wake watchdog's last resort, callable from any task: rails off and
+    // straight into deep sleep, skipping everything that could block
+    void forceDeepSleep(uint32_t sleepTimeSeconds);
+    // Seconds left until the wake scheduled by the last enterDeepSleep(), so a
+    // button wake can go back to sleep without shifting the refresh schedule
+    uint32_t getSecondsUntilTimerWake() const;
+    // Battery readers return the monitor's cached, filtered value
+    void updateBattery();  // Call from the main loop; samples on schedule
     float getBatteryVoltage();
     int getBatteryPercentage();
     bool isLowBattery();
@@ -113,17 +144,28 @@ public:
     bool isCharging();
 
     // SD Card methods
+    // Storage calls mount the card on demand and power it off again afterwards.
+    // Wrap several calls in acquireSDCard()/releaseSDCard() to keep it mounted.
+    bool acquireSDCard();
+    void releaseSDCard();
     bool isSDCardAvailable();
     bool writeFile(const char* path, const uint8_t* data, size_t size);
+    bool appendFile(const char* path, const uint8_t* data, size_t size);
     bool readFile(const char* path, uint8_t* buffer, size_t maxSize, size_t* actualSize);
     bool deleteFile(const char* path);
     bool fileExists(const char* path);
+    bool createDirectory(const char* path);
     size_t getFileSize(const char* path);
-    bool formatSDCard();  // Danger: deletes all files/directories on SD
+    bool wipeDirectory(const char* path, bool removeRoot,
+                       StorageProgressCallback progress = nullptr, void* context = nullptr);
+    bool wipeCache(StorageProgressCallback progress = nullptr, void* context = nullptr);
+    bool formatSDCard(StorageProgressCallback progress = nullptr, void* context = nullptr);  // Danger: deletes all files/directories on SD
 
-    // Buzzer
+    // Buzzer; all of these return immediately
     void beep(int frequency = 1000, int duration = 100);
     void playTone(int frequency, int duration);
+    void playPattern(BuzzerPattern pattern);
+    bool isBuzzerPlaying() const { return buzzer.isPlaying(); }
 
     // Preferences/Settings
     bool saveString(const char* key, const char* value);
@@ -133,6 +175,8 @@ public:
     bool saveBool(const char* key, bool value);
     bool loadBool(const char* key, bool defaultValue = false);
     void clearPreferences();
+    SettingsStore& getSettings() { return settings; }
+    bool commitSettings();
 
     // Utility methods
     String getMacAddress();
@@ -0,0 +1,42 @@
+#ifndef POWER_PHASES_H
+#define POWER_PHASES_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// How the CPU clock follows the wake phases
+enum CpuPolicy {
+    CPU_POLICY_FIXED = 0,      // Stay at the boot frequency (board_build.f_cpu)
+    CPU_POLICY_PHASED = 1,     // Low clock while waiting, high clock for crypto and decode
+    CPU_POLICY_ALTERNATE = 2   // Fixed and phased on alternate wakes, to compare their energy
+};
+
+#define CPU_POLICY_COUNT 2  // Policies actually applied (ALTERNATE picks one of them)
+
+// Power-phase manager. Driven by the profiler's phase markers
+// (PROFILE_BEGIN/END/SCOPE): each known phase asks for the low or high CPU
+// clock and the innermost open one wins. Waiting on the radio or the
+// panel's BUSY line runs at CPU_FREQ_LOW_MHZ; TLS and PNG decode at
+// CPU_FREQ_HIGH_MHZ. Unlisted phases inherit the clock of the phase around
+// them; outside any listed phase the boot clock applies. Every change is
+// reported to the EnergyModel so the cost per cycle can be compared
+// between policies.
+class PowerPhases {
+public:
+    // Picks this wake's policy; call once at boot before the first marker
+    static void beginCycle();
+
+    static void enter(const char* id);
+    static void leave(const char* id);
+
+    // Awake idle that cannot light-sleep (radio up, buzzer, held button):
+    // the low clock under either policy until endIdle() restores the clock
+    // of the open phases
+    static void beginIdle();
+    static void endIdle();
+
+    static CpuPolicy getPolicy();  // FIXED or PHASED for the current wake
+    static const char* policyName(CpuPolicy policy);
+};
+
+#endif // POWER_PHASES_H
@@ -0,0 +1,89 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "power_phases.h"
+#include "wake_watchdog.h"
+
+// Wake-cycle phase profiler. Spans are named by static strings, stamped with
+// esp_timer_get_time() and kept in RTC memory for the last
+// PROFILER_HISTORY_CYCLES wakes so they survive deep sleep. The same
+// markers drive the CPU clock (PowerPhases) and name the phase a wake
+// overran in (WakeWatchdog); with PROFILER_ENABLED, CPU_SCALING_ENABLED and
+// WAKE_WATCHDOG_ENABLED all off the macros expand to nothing.
+
+struct ProfileSpan {
+    char id[PROFILER_ID_LENGTH];
+    uint32_t startUs;     // Since reset
+    uint32_t durationUs;  // 0 while the span is still open
+};
+
+struct ProfileCycle {
+    uint32_t cycle;       // Wake counter, 0 = slot unused
+    uint32_t totalUs;     // Reset to sleep entry
+    uint8_t count;
+    ProfileSpan spans[PROFILER_MAX_SPANS];
+};
+
+class Profiler {
+public:
+    static void beginCycle();
+    static void endCycle();   // Closes spans still open; call right before sleep
+
+    static void begin(const char* id);
+    static void end(const char* id);
+
+    // ago = 0 is the current wake, 1 the one before, ...
+    static const ProfileCycle* getCycle(uint8_t ago);
+    static String summary(uint8_t ago = 0);
+    static void dump();
+};
+
+// One phase marker, fanned out to whichever consumers are built in
+inline void profileBegin(const char* id) {
+    #if PROFILER_ENABLED
+    Profiler::begin(id);
+    #endif
+    #if CPU_SCALING_ENABLED
+    PowerPhases::enter(id);
+    #endif
+    #if WAKE_WATCHDOG_ENABLED
+    WakeWatchdog::enterPhase(id);
+    #endif
+}
+
+inline void profileEnd(const char* id) {
+    #if WAKE_WATCHDOG_ENABLED
+    WakeWatchdog::leavePhase(id);
+    #endif
+    #if CPU_SCALING_ENABLED
+    PowerPhases::leave(id);
+    #endif
+    #if PROFILER_ENABLED
+    Profiler::end(id);
+    #endif
+}
+
+class ProfileScope {
+private:
+    const char* id;
+
+public:
+    explicit ProfileScope(const char* spanId) : id(spanId) { profileBegin(id); }
+    ~ProfileScope() { profileEnd(id); }
+};
+
+#if PROFILER_ENABLED || CPU_SCALING_ENABLED || WAKE_WATCHDOG_ENABLED
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_BEGIN(id) profileBegin(id)
+#define PROFILE_END(id) profileEnd(id)
+#define PROFILE_SCOPE(id) ProfileScope PROFILE_CONCAT(profileScope_, __LINE__)(id)
+#else
+#define PROFILE_BEGIN(id) ((void)0)
+#define PROFILE_END(id) ((void)0)
+#define PROFILE_SCOPE(id) ((void)0)
+#endif
+
+#endif // PROFILER_H
@@ -0,0 +1,58 @@
+#ifndef PUSH_HANDLER_H
+#define PUSH_HANDLER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "push_request.h"
+
+// Request handling of the LAN push endpoint. Plain C++ with no Arduino
+// dependencies so it can be exercised on the host (env:native): the
+// connection is a PushStream (a WiFiClient on the device, a scripted request
+// in the tests) and the limits come in a PushHandlerConfig, not config.h.
+
+// One client connection
+class PushStream {
+public:
+    virtual ~PushStream() {}
+    virtual int available() = 0;
+    virtual int read(uint8_t* buffer, size_t size) = 0;
+    virtual size_t write(const uint8_t* data, size_t length) = 0;
+    virtual bool connected() = 0;
+    virtual uint32_t nowMs() = 0;
+    virtual void idle() = 0;  // Called while waiting for data
+};
+
+struct PushHandlerConfig {
+    const char* path;
+    const char* token;         // Compared with access-token or Bearer; empty rejects all
+    size_t maxBodySize;
+    size_t frameBytes;         // Size of a raw 1-bit frame
+    uint32_t timeoutMs;        // Whole request, head and body
+};
+
+// Shows a received image; called before the reply goes out
+typedef void (*PushDisplayFn)(void* context, const uint8_t* image, size_t size);
+
+class PushRequestHandler {
+private:
+    PushRequestParser parser;
+    PushDisplayFn display;
+    void* context;
+
+    bool readBody(PushStream& stream, uint8_t* body, size_t size, size_t have,
+                  uint32_t startMs, uint32_t timeoutMs);
+    void sendStatus(PushStream& stream, int code, uint32_t renderMs = 0);
+
+public:
+    PushRequestHandler(PushDisplayFn displayFn, void* displayContext);
+
+    // Serves one request and returns the status answered (204 once the image
+    // is shown), or 0 if the client went away. latencyMs is request to reply.
+    int serve(PushStream& stream, const PushHandlerConfig& config, uint32_t* latencyMs = nullptr);
+
+    // PNG signature, BMP magic or an exact raw frame
+    static bool isSupportedImage(const uint8_t* data, size_t size, size_t frameBytes);
+    static const char* reasonPhrase(int code);
+};
+
+#endif // PUSH_HANDLER_H
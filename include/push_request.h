@@ -0,0 +1,71 @@
+#ifndef PUSH_REQUEST_H
+#define PUSH_REQUEST_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// HTTP/1.1 request head parser for the LAN push endpoint. Plain C++ with no
+// Arduino dependencies so it can be exercised on the host (env:native) with
+// recorded requests. Only what the endpoint needs is kept: method, path,
+// Content-Length, Content-Type, the access token and Expect: 100-continue.
+
+enum PushMethod {
+    PUSH_METHOD_OTHER = 0,
+    PUSH_METHOD_GET = 1,
+    PUSH_METHOD_PUT = 2
+};
+
+class PushRequestParser {
+public:
+    static const size_t LINE_LIMIT = 256;   // Longest request or header line
+    static const size_t HEAD_LIMIT = 2048;  // Request line plus all headers
+    static const size_t PATH_LIMIT = 64;
+    static const size_t TOKEN_LIMIT = 96;
+    static const size_t TYPE_LIMIT = 48;
+
+private:
+    enum Stage {
+        STAGE_REQUEST_LINE,
+        STAGE_HEADERS,
+        STAGE_DONE,
+        STAGE_FAILED
+    };
+
+    Stage stage;
+    char line[LINE_LIMIT];
+    size_t lineLength;
+    size_t headBytes;
+    int errorStatus;
+
+    PushMethod method;
+    char path[PATH_LIMIT];
+    char token[TOKEN_LIMIT];
+    char contentType[TYPE_LIMIT];
+    int64_t contentLength;  // -1 when absent
+    bool expectContinue;
+
+    bool parseRequestLine();
+    bool parseHeader();
+    void fail(int status);
+
+public:
+    PushRequestParser();
+    void reset();
+
+    // Consumes bytes up to and including the blank line that ends the head
+    // and returns how many were used; the rest belongs to the body
+    size_t feed(const uint8_t* data, size_t length);
+
+    bool isComplete() const { return stage == STAGE_DONE; }
+    bool hasFailed() const { return stage == STAGE_FAILED; }
+    int getErrorStatus() const { return errorStatus; }  // HTTP status to answer with
+
+    PushMethod getMethod() const { return method; }
+    const char* getPath() const { return path; }            // Without the query string
+    const char* getToken() const { return token; }          // access-token or Bearer
+    const char* getContentType() const { return contentType; }
+    int64_t getContentLength() const { return contentLength; }
+    bool expectsContinue() const { return expectContinue; }
+};
+
+#endif // PUSH_REQUEST_H
@@ -0,0 +1,47 @@
+#ifndef PUSH_SERVER_H
+#define PUSH_SERVER_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include "config.h"
+#include "paperdink_hardware.h"
+#include "push_handler.h"
+
+// LAN push endpoint: while the radio is up anyway (charging, or a short
+// window after a refresh) a PUT of a PNG, 1-bit BMP or raw frame to
+// PUSH_SERVER_PATH goes straight to the panel, without waiting for the next
+// scheduled wake. The body is read into RAM and handed to displayImage();
+// the reply is sent once the panel has refreshed, so the caller sees the
+// push-to-panel latency (also in the X-Render-Ms header). The request
+// itself is handled by PushRequestHandler over the accepted WiFiClient.
+//
+//   curl -T screen.png -H "access-token: <token>" http://<device-ip>/image
+class PushServer {
+private:
+    WiFiServer server;
+    PushRequestHandler handler;
+    PaperdInkHardware* hardware;
+    String token;
+    bool running;
+    uint32_t pushes;
+    uint32_t lastLatencyMs;
+
+    static void displayPushed(void* context, const uint8_t* image, size_t size);
+
+public:
+    PushServer();
+
+    // token is compared with the access-token (or Bearer) header; the
+    // server does not start without one
+    bool begin(PaperdInkHardware* hw, const String& accessToken);
+    void end();
+    bool isRunning() const { return running; }
+
+    // Serves at most one pending request; true if an image was shown
+    bool handle();
+
+    uint32_t getPushCount() const { return pushes; }
+    uint32_t getLastLatencyMs() const { return lastLatencyMs; }
+};
+
+#endif // PUSH_SERVER_H
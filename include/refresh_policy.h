@@ -0,0 +1,52 @@
+#ifndef REFRESH_POLICY_H
+#define REFRESH_POLICY_H
+
+#include <stdint.h>
+
+// Sleep-interval policy. Plain C++ with no Arduino dependencies so it can be
+// exercised on the host (env:native) with a simulated battery and clock.
+
+// One point of the state-of-charge curve: at or below `percent` the
+// server interval is scaled to `intervalPercent` (100 = unchanged).
+// Points are ordered from full to empty; values in between are interpolated.
+struct SocStretchPoint {
+    uint8_t percent;
+    uint16_t intervalPercent;
+};
+
+struct RefreshPolicyConfig {
+    const SocStretchPoint* socCurve;
+    uint8_t socCurvePoints;
+    uint32_t quietStartSecond;     // Local second of day; start == end disables
+    uint32_t quietEndSecond;
+    uint8_t unchangedStretchMax;   // Interval multiplier cap for unchanged content
+    uint32_t minSleepSeconds;
+    uint32_t maxSleepSeconds;
+};
+
+struct RefreshPolicyInput {
+    uint32_t serverRefreshSeconds;
+    int batteryPercent;            // 0..100
+    bool charging;
+    int32_t localSecondOfDay;      // -1 while the clock is not set
+    uint8_t unchangedCycles;       // Consecutive refreshes that returned the same screen
+};
+
+class RefreshPolicy {
+private:
+    const RefreshPolicyConfig& config;
+
+    uint32_t clampSleep(uint64_t seconds) const;
+
+public:
+    explicit RefreshPolicy(const RefreshPolicyConfig& policyConfig);
+
+    uint32_t nextSleepSeconds(const RefreshPolicyInput& input) const;
+
+    // Interpolated interval scale (percent) for a state of charge
+    uint16_t socIntervalPercent(int batteryPercent) const;
+    bool inQuietHours(uint32_t secondOfDay) const;
+    uint32_t secondsUntilQuietEnd(uint32_t secondOfDay) const;
+};
+
+#endif // REFRESH_POLICY_H
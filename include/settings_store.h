@@ -0,0 +1,79 @@
+#ifndef SETTINGS_STORE_H
+#define SETTINGS_STORE_H
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include "config.h"
+
+// Persistent device settings, mirrored in RAM and written to NVS as a single
+// versioned blob. Field sizes include the terminating NUL.
+struct DeviceSettings {
+    char wifiSsid[33];
+    char wifiPassword[65];
+    char apiKey[65];
+    char friendlyId[17];
+    int32_t refreshRate;
+    bool invertDisplay;
+    char apiBaseUrl[97];  // Empty: TRMNL_API_BASE_URL
+};
+
+// Dirty flags, one per field
+enum SettingsField {
+    SETTING_WIFI_SSID     = 1 << 0,
+    SETTING_WIFI_PASSWORD = 1 << 1,
+    SETTING_API_KEY       = 1 << 2,
+    SETTING_FRIENDLY_ID   = 1 << 3,
+    SETTING_REFRESH_RATE  = 1 << 4,
+    SETTING_INVERT        = 1 << 5,
+    SETTING_API_BASE_URL  = 1 << 6
+};
+
+class SettingsStore {
+private:
+    Preferences* preferences;
+    DeviceSettings settings;
+    uint32_t dirtyMask;
+    bool loaded;
+
+    void setDefaults();
+    bool migrateLegacyKeys();
+    bool migrateVersion1();
+    void setString(char* field, size_t fieldSize, const char* value, SettingsField flag);
+
+public:
+    SettingsStore();
+
+    // Loads the blob (or migrates the old per-key layout) from an open namespace
+    bool begin(Preferences* prefs);
+
+    // Adopts settings kept across deep sleep without touching NVS; the
+    // namespace only needs to be open by the time commit() runs
+    void restore(Preferences* prefs, const DeviceSettings& saved);
+    const DeviceSettings& getAll() const { return settings; }
+
+    // Writes all pending changes in one NVS commit; no-op when nothing changed
+    bool commit();
+    bool isDirty() const { return dirtyMask != 0; }
+    uint32_t getDirtyMask() const { return dirtyMask; }
+
+    // Forget everything (NVS is cleared by the caller)
+    void reset();
+
+    // Typed accessors; setters only mark a field dirty when its value changes
+    const char* getWifiSsid() const { return settings.wifiSsid; }
+    const char* getWifiPassword() const { return settings.wifiPassword; }
+    const char* getApiKey() const { return settings.apiKey; }
+    const char* getFriendlyId() const { return settings.friendlyId; }
+    int getRefreshRate() const { return settings.refreshRate; }
+    bool getInvertDisplay() const { return settings.invertDisplay; }
+    const char* getApiBaseUrl() const { return settings.apiBaseUrl; }
+
+    void setWifiCredentials(const char* ssid, const char* password);
+    void setApiKey(const char* apiKey);
+    void setFriendlyId(const char* friendlyId);
+    void setRefreshRate(int seconds);
+    void setInvertDisplay(bool invert);
+    void setApiBaseUrl(const char* url);
+};
+
+#endif // SETTINGS_STORE_H
@@ -0,0 +1,62 @@
+#ifndef SOC_ESTIMATOR_H
+#define SOC_ESTIMATOR_H
+
+#include <stdint.h>
+
+// LiPo state-of-charge estimate from a filtered voltage. Plain C++ so it can
+// be driven on the host like RefreshPolicy.
+
+// Open-circuit voltage curve, ordered from full to empty
+struct SocCurvePoint {
+    uint16_t millivolts;
+    uint8_t percent;
+};
+
+struct SocEstimatorConfig {
+    const SocCurvePoint* curve;
+    uint8_t curvePoints;
+    float lowVolts;
+    float criticalVolts;
+    float flagHysteresisVolts;   // Flags clear only this far above their threshold
+    uint8_t percentHysteresis;   // Reported percent moves in steps of at least this
+    float sagWeight;             // EMA weight for newly measured sag
+    float maxSagVolts;           // Ignore sag measurements above this (bogus pairs)
+};
+
+// Kept by the caller (in RTC memory on the device) so hysteresis and the
+// learned sag carry over between wakes
+struct SocEstimatorState {
+    uint8_t valid;
+    uint8_t reportedPercent;
+    uint8_t low;
+    uint8_t critical;
+    float sagVolts;              // Rest minus loaded voltage while the radio transmits
+};
+
+class SocEstimator {
+private:
+    const SocEstimatorConfig& config;
+    SocEstimatorState& state;
+
+public:
+    SocEstimator(const SocEstimatorConfig& estimatorConfig, SocEstimatorState& estimatorState);
+
+    // Interpolated curve lookup, no hysteresis
+    uint8_t curvePercent(float volts) const;
+
+    // Learn the load sag from a rest and a loaded reading of the same wake
+    void learnSag(float restVolts, float loadedVolts);
+
+    // Rest-equivalent voltage for a reading taken with or without radio load
+    float compensate(float volts, bool underLoad) const;
+
+    // Feed a rest-equivalent voltage; updates percent and flags
+    void update(float restEquivalentVolts, bool charging);
+
+    uint8_t getPercent() const { return state.reportedPercent; }
+    bool isLow() const { return state.low != 0; }
+    bool isCritical() const { return state.critical != 0; }
+    float getSagVolts() const { return state.sagVolts; }
+};
+
+#endif // SOC_ESTIMATOR_H
@@ -0,0 +1,51 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <stdint.h>
+#include <atomic>
+
+// Bounded single-producer/single-consumer ring buffer. push() and pop() never
+// block or take a lock, so the producer may be an ISR and the consumer a
+// task. Several producers are fine as long as their pushes are serialized
+// by the caller (e.g. under one spinlock). Plain C++ for host tests.
+template <typename T, uint32_t N>
+class SpscQueue {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscQueue size must be a power of two");
+
+private:
+    T items[N];
+    std::atomic<uint32_t> head;  // Next slot to write, advanced by the producer
+    std::atomic<uint32_t> tail;  // Next slot to read, advanced by the consumer
+
+public:
+    SpscQueue() : head(0), tail(0) {}
+
+    // Producer side; false when full (the item is dropped)
+    bool push(const T& item) {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) == N) return false;
+        items[h & (N - 1)] = item;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side; false when empty
+    bool pop(T* item) {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire)) return false;
+        *item = items[t & (N - 1)];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side: drops everything queued so far
+    void discard() {
+        tail.store(head.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+    bool empty() const {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+};
+
+#endif // SPSC_QUEUE_H
@@ -10,6 +10,9 @@
 #include <DNSServer.h>
 #include "config.h"
 #include "paperdink_hardware.h"
+#include "cache_index.h"
+#include "offline_scheduler.h"
+#include "ota_updater.h"
 
 // TRMNL API Response Status Codes
 enum TRMNLStatus {
@@ -29,6 +32,16 @@ enum DeviceState {
     STATE_OFFLINE = 5
 };
 
+// Charging-mode cache warm-up stages
+enum WarmupStage {
+    WARMUP_IDLE = 0,
+    WARMUP_PLAYLIST = 1,  // Walk the playlist, download and pre-render each item
+    WARMUP_PRUNE = 2,     // Drop screens the playlist no longer serves
+    WARMUP_RENDER = 3,    // Pre-render cached screens still lacking a frame
+    WARMUP_LOGS = 4,      // Upload buffered logs
+    WARMUP_DONE = 5
+};
+
 // API Response structures
 struct SetupResponse {
     int status;
@@ -44,6 +57,8 @@ struct DisplayResponse {
     String filename;
     bool updateFirmware;
     String firmwareUrl;
+    String firmwareSha256;  // Hex, empty when the server sends none
+    String firmwareDeltaUrl;  // Patch against FIRMWARE_VERSION, optional
     int refreshRate;
     bool resetFirmware;
     String error;
@@ -56,6 +71,7 @@ private:
 
     // Network components
     WiFiClientSecure wifiClient;
+    WiFiClient plainClient;  // http:// URLs (self-hosted server on the LAN)
     HTTPClient httpClient;
     WebServer* configServer;
     DNSServer* dnsServer;
@@ -66,6 +82,7 @@ private:
     String apiKey;
     String friendlyId;
     int refreshRate;
+    bool wifiConnectStarted;
 
     // Configuration portal
     bool configPortalActive;
@@ -73,7 +90,24 @@ private:
 
     // Cache management
     String lastImageFilename;
+    uint32_t shownPanelGeneration;  // Panel generation when lastImageFilename was drawn
+    uint8_t unchangedCycles;        // Refreshes in a row that returned the same screen
     unsigned long lastUpdateTime;
+    CacheIndex cacheIndex;
+    OfflineScheduler offlineScheduler;
+
+    // Firmware offered by the last display API response
+    OtaUpdater otaUpdater;
+    String offeredFirmwareUrl;
+    String offeredFirmwareSha256;
+    String offeredFirmwareDeltaUrl;
+
+    // Charging-mode warm-up
+    WarmupStage warmupStage;
+    uint8_t warmupItems;
+    uint8_t warmupRenderSlot;
+    uint32_t warmupStartClock;
+    bool warmupFullCycle;
 
     // Error handling
     int consecutiveErrors;
@@ -81,12 +115,16 @@ private:
 
     // Private methods
     bool connectToWiFi();
+    bool waitForWiFi(unsigned long timeoutMs);
+    void syncClock();
     bool setupConfigPortal();
     void handleConfigPortal();
     void handleRoot();
     void handleWiFiSave();
     void handleReset();
     String generateConfigPage();
+    // Trimmed, without trailing '/', empty for the default; false if invalid
+    static bool normalizeApiBaseUrl(const String& url, String& base);
 
     // API methods
     bool callSetupAPI(SetupResponse& response);
@@ -96,6 +134,9 @@ private:
     bool downloadImageAutoAlloc(const String& imageUrl, uint8_t** outBuffer, size_t* outSize);
     bool downloadFirmware(const String& firmwareUrl);
     long getRemoteContentLength(const String& url);
+    // Plain client only for http:// URLs on the configured http:// server;
+    // nullptr (and lastError set) for any other http:// URL
+    WiFiClient* transportFor(const String& url);
 
     // Utility methods
     String createRequestHeaders(bool includeAuth = false);
@@ -106,17 +147,32 @@ private:
     bool loadDeviceInfo();
 
     // Cache methods
+    // CACHE_DIR path of a cached screen, under CacheIndex::storedName()
+    static String cacheFilePath(const String& filename, const char* suffix = "");
     bool cacheImage(const String& filename, const uint8_t* imageData, size_t imageSize);
     bool loadCachedImage(const String& filename, uint8_t* buffer, size_t maxSize, size_t* actualSize);
     bool isCacheValid(const String& filename);
+    bool loadCachedScreen(const String& filename, uint8_t* buffer, size_t maxSize, size_t* actualSize);
+    bool storeRenderedFrame(const String& filename, const uint8_t* imageData, size_t imageSize);
+    void deleteCachedScreen(const String& filename);
+    uint8_t currentFrameFlags();
+    bool loadCacheIndex();
     void cleanupCache();
+    bool displayRotatedImage(bool forward);
+
+    // Warm-up steps (one unit of work each)
+    bool warmupFetchNextItem();
+    void warmupPruneStale();
+    bool warmupRenderNext();
 
 public:
     TRMNLClient(PaperdInkHardware* hw);
     ~TRMNLClient();
 
-    // Initialization and lifecycle
-    bool begin();
+    // Initialization and lifecycle; a snapshot restores the previous wake's
+    // state instead of rebuilding it
+    bool begin(const ClientSnapshot* snapshot = nullptr);
+    void captureSnapshot(ClientSnapshot& snapshot) const;
     void end();
     void loop();
 
@@ -125,6 +181,7 @@ public:
     void setState(DeviceState state) { currentState = state; }
 
     // WiFi management
+    bool startWiFiConnect();  // Non-blocking; association continues in the background
     bool isWiFiConnected();
     bool startConfigPortal();
     void stopConfigPortal();
@@ -140,8 +197,15 @@ public:
     String getApiKey() const { return apiKey; }
     String getFriendlyId() const { return friendlyId; }
 
+    // Backend: TRMNL_API_BASE_URL unless one was set in the portal. An
+    // http:// base URL talks plain HTTP (no TLS handshake) to a trusted LAN
+    // server; changing it drops the registration from the old backend.
+    String getApiBaseUrl() const;
+    bool setApiBaseUrl(const String& url);  // Empty restores the default
+    bool isPlainHttp() const;
+
     // Content management
-    bool updateContent();
+    bool updateContent(bool forceRedraw = false);  // forceRedraw: refresh the panel even if unchanged
     bool displayContent();
     bool hasNewContent();
     void forceRefresh();
@@ -149,7 +213,26 @@ public:
     // Offline mode
     bool enterOfflineMode();
     bool displayCachedContent();
+    bool displayNextCachedImage();
+    bool displayPreviousCachedImage();
     bool hasCachedContent();
+    bool clearCache(StorageProgressCallback progress = nullptr, void* context = nullptr);
+    bool shouldAttemptRadio();
+    bool isOffline() const { return offlineScheduler.isOffline(); }
+
+    // Charging mode: keep the radio up and fill the cache on external power
+    void beginChargingWarmup();
+    bool runChargingWarmupStep();  // Returns false once all jobs are done
+    void endChargingWarmup();
+    WarmupStage getWarmupStage() const { return warmupStage; }
+
+    // Buffered logs (kept on SD, uploaded while charging)
+    bool queueLog(const String& line);
+    bool flushLogs();
+
+    // Refresh policy inputs
+    uint8_t getUnchangedCycles() const { return unchangedCycles; }
+    bool isPanelShowingLastImage() const;
 
     // Settings
     void setRefreshRate(int seconds);
@@ -162,7 +245,9 @@ public:
 
     // Firmware updates
     bool checkForFirmwareUpdate();
-    bool performFirmwareUpdate(const String& firmwareUrl);
+    bool performFirmwareUpdate(const String& firmwareUrl, const String& expectedSha256 = "",
+                               const String& deltaUrl = "");
+    bool installOfferedFirmware();  // Restarts into the new image on success
 
     // Utility
     void printStatus();
@@ -0,0 +1,34 @@
+#ifndef WAKE_SNAPSHOT_H
+#define WAKE_SNAPSHOT_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "settings_store.h"
+
+// Runtime state carried across deep sleep so a timer wake can skip NVS and
+// the startup sequence entirely.
+struct HardwareSnapshot {
+    DeviceSettings settings;
+    int64_t timerWakeAt;                    // System time (s) of the scheduled wake
+};
+
+struct ClientSnapshot {
+    uint8_t state;                          // DeviceState
+    char macAddress[18];
+    char lastImageFilename[CACHE_FILENAME_MAX];
+    int32_t consecutiveErrors;
+    uint8_t panelShowsLastImage;            // Nothing else was drawn since
+    uint8_t unchangedCycles;
+};
+
+// Versioned, CRC-protected copy in RTC slow memory. Anything that does not
+// validate (cold boot, brown-out, firmware with another layout) reads as
+// absent and the caller falls back to NVS.
+class WakeSnapshot {
+public:
+    static bool load(HardwareSnapshot* hardware, ClientSnapshot* client);
+    static void store(const HardwareSnapshot& hardware, const ClientSnapshot& client);
+    static void invalidate();
+};
+
+#endif // WAKE_SNAPSHOT_H
@@ -0,0 +1,53 @@
+#ifndef WAKE_WATCHDOG_H
+#define WAKE_WATCHDOG_H
+
+#include <Arduino.h>
+#include <esp_timer.h>
+#include "config.h"
+
+// Last wake that ran out of budget, kept in RTC memory
+struct WakeOverrun {
+    uint32_t count;                   // Overruns since power-on
+    char phase[PROFILER_ID_LENGTH];   // Innermost open phase at the deadline
+    uint32_t elapsedMs;               // Reset to deadline
+    uint8_t forced;                   // Hard deadline: slept without the normal sleep path
+    uint8_t reported;                 // Already queued for the server log
+};
+
+// Wake-budget supervisor. Two esp_timer one-shots run from arm() until the
+// CPU stops in deep sleep. At the soft deadline expired() turns true: the
+// network loops give up, HTTP timeouts (clampTimeout) are already capped to
+// the budget, and the main loop shows cached content and sleeps normally.
+// If the wake is still running WAKE_BUDGET_GRACE_MS later (a call that
+// never returns), the hard deadline hands over to the forced-sleep hook
+// from the esp_timer task. Either way the innermost open profiler phase is
+// recorded so the next wake can report what overran.
+class WakeWatchdog {
+public:
+    typedef void (*ForcedSleepFn)(uint32_t sleepSeconds);
+
+    // Creates the timers; the hook must only touch pins and sleep registers
+    static bool begin(ForcedSleepFn forcedSleep);
+    // Starts (or restarts) the budget from now
+    static void arm(uint32_t budgetMs = WAKE_BUDGET_MS);
+    // Restarts the budget if armed, e.g. on user input
+    static void extend();
+    // Stops both deadlines while staying awake is intended (charging, portal)
+    static void suspend();
+
+    static bool expired();
+    static bool isArmed();
+    static uint32_t remainingMs();  // Until the soft deadline; UINT32_MAX when not armed
+    // timeoutMs capped to the remaining budget, at least 1 s
+    static uint32_t clampTimeout(uint32_t timeoutMs);
+
+    // Phase markers (fed by PROFILE_BEGIN/END)
+    static void enterPhase(const char* id);
+    static void leavePhase(const char* id);
+
+    // The previous overrun, once: true and a log line when not yet reported
+    static bool takeOverrunReport(String* line);
+    static const WakeOverrun& getLastOverrun();
+};
+
+#endif // WAKE_WATCHDOG_H
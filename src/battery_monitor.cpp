@@ -0,0 +1,112 @@
+#include "battery_monitor.h"
+
+static const SocCurvePoint socCurve[] = BATTERY_SOC_CURVE;
+static const SocEstimatorConfig socConfig = {
+    socCurve,
+    sizeof(socCurve) / sizeof(socCurve[0]),
+    LOW_BATTERY_THRESHOLD,
+    CRITICAL_BATTERY_THRESHOLD,
+    BATTERY_FLAG_HYSTERESIS,
+    BATTERY_SOC_HYSTERESIS,
+    BATTERY_SAG_WEIGHT,
+    BATTERY_SAG_MAX
+};
+
+// Hysteresis state and learned sag carry over deep sleep
+static RTC_DATA_ATTR SocEstimatorState s_socState = { 0, 0, 0, 0, 0.0f };
+
+BatteryMonitor::BatteryMonitor()
+    : soc(socConfig, s_socState)
+    , filteredVoltage(0.0f)
+    , lastSampleVoltage(0.0f)
+    , wakeRestVoltage(0.0f)
+    , wakeLoadedVoltage(0.0f)
+    , lastSampleTime(0)
+    , hasSample(false)
+    , underLoad(false)
+    , charging(false) {
+    memset(&adcCharacteristics, 0, sizeof(adcCharacteristics));
+}
+
+void BatteryMonitor::begin() {
+    adc1_config_width(ADC_WIDTH_BIT_12);
+    adc1_config_channel_atten(BATTERY_ADC_CHANNEL, ADC_ATTEN_DB_11);
+
+    // Uses the eFuse Vref/two-point values when the chip has them
+    esp_adc_cal_value_t calSource = esp_adc_cal_characterize(
+        ADC_UNIT_1, ADC_ATTEN_DB_11, ADC_WIDTH_BIT_12, BATTERY_ADC_DEFAULT_VREF_MV, &adcCharacteristics);
+
+    #if DEBUG_ENABLED
+    Serial.printf("Battery ADC calibration: %s\n",
+                  calSource == ESP_ADC_CAL_VAL_EFUSE_TP ? "eFuse two-point" :
+                  calSource == ESP_ADC_CAL_VAL_EFUSE_VREF ? "eFuse Vref" : "default Vref");
+    #else
+    (void)calSource;
+    #endif
+
+    sampleNow();
+}
+
+float BatteryMonitor::sampleDivider() {
+    uint32_t readings[BATTERY_SAMPLE_COUNT];
+
+    // Divider is only powered for the duration of the burst
+    digitalWrite(BATTERY_ENABLE_PIN, HIGH);
+    delay(BATTERY_SETTLE_MS);
+    for (int i = 0; i < BATTERY_SAMPLE_COUNT; i++) {
+        readings[i] = esp_adc_cal_raw_to_voltage(adc1_get_raw(BATTERY_ADC_CHANNEL), &adcCharacteristics);
+    }
+    digitalWrite(BATTERY_ENABLE_PIN, LOW);
+
+    // Median of the burst (insertion sort, the burst is tiny)
+    for (int i = 1; i < BATTERY_SAMPLE_COUNT; i++) {
+        uint32_t value = readings[i];
+        int j = i - 1;
+        while (j >= 0 && readings[j] > value) {
+            readings[j + 1] = readings[j];
+            j--;
+        }
+        readings[j + 1] = value;
+    }
+    uint32_t medianMv = readings[BATTERY_SAMPLE_COUNT / 2];
+
+    // 2:1 divider in front of the ADC
+    float voltage = medianMv * BATTERY_DIVIDER_RATIO / 1000.0f;
+
+    #ifdef BATTERY_CALIBRATION_OFFSET
+    voltage += BATTERY_CALIBRATION_OFFSET;
+    #endif
+
+    return voltage;
+}
+
+void BatteryMonitor::sampleNow() {
+    lastSampleVoltage = sampleDivider();
+    lastSampleTime = millis();
+
+    // A rest and a loaded reading from the same wake give the TX sag
+    if (underLoad) {
+        wakeLoadedVoltage = lastSampleVoltage;
+    } else {
+        wakeRestVoltage = lastSampleVoltage;
+    }
+    if (wakeRestVoltage > 0.0f && wakeLoadedVoltage > 0.0f) {
+        soc.learnSag(wakeRestVoltage, wakeLoadedVoltage);
+    }
+
+    float restEquivalent = soc.compensate(lastSampleVoltage, underLoad);
+    if (!hasSample) {
+        filteredVoltage = restEquivalent;
+        hasSample = true;
+    } else {
+        filteredVoltage += BATTERY_EMA_WEIGHT * (restEquivalent - filteredVoltage);
+    }
+
+    soc.update(filteredVoltage, charging);
+}
+
+void BatteryMonitor::update() {
+    if (!hasSample || millis() - lastSampleTime >= BATTERY_SAMPLE_INTERVAL_MS) {
+        sampleNow();
+    }
+}
@@ -0,0 +1,314 @@
+#include "button_driver.h"
+#include <driver/gpio.h>
+#include <driver/rtc_io.h>
+#include <esp_sleep.h>
+
+static const uint8_t buttonPins[4] = {BUTTON_1_PIN, BUTTON_2_PIN, BUTTON_3_PIN, BUTTON_4_PIN};
+static const uint8_t expanderBits[4] = PCF_BUTTON_BITS;
+
+static const ButtonGestureConfig gestureConfig = {
+    BUTTON_DOUBLE_CLICK_MS,
+    BUTTON_LONG_PRESS_MS,
+    BUTTON_VERY_LONG_PRESS_MS,
+    BUTTON_CHORD_WINDOW_MS
+};
+
+ButtonDriver::ButtonDriver()
+    : mode(BUTTON_INPUT_GPIO)
+    , settlePending(0)
+    , expanderChanged(false)
+    , expanderEdgeMs(0)
+    , stateLock(portMUX_INITIALIZER_UNLOCKED)
+    , task(nullptr)
+    , droppedEvents(0)
+    , gestures(gestureConfig, emitEvent, this) {
+    for (int i = 0; i < 4; i++) {
+        pinContexts[i] = PinContext{this, (uint8_t)i};
+        levels[i] = false;
+        lastEdgeMs[i] = 0;
+    }
+}
+
+bool ButtonDriver::begin(ButtonInputMode inputMode) {
+    mode = inputMode;
+    settlePending = 0;
+    expanderChanged = false;
+
+    bool pressed[4];
+    if (mode == BUTTON_INPUT_PCF8574) {
+        // Quasi-bidirectional port: writing 1 turns every pin into an input
+        Wire.beginTransmission(PCF_I2C_ADDR);
+        Wire.write(0xFF);
+        if (Wire.endTransmission() != 0 || !readExpander(pressed)) {
+            #if DEBUG_ENABLED
+            Serial.printf("PCF8574 not responding at 0x%02X\n", PCF_I2C_ADDR);
+            #endif
+            return false;
+        }
+    } else {
+        readRaw(pressed);
+    }
+
+    // A button held through boot (e.g. the one that woke us) starts as a press
+    uint32_t now = millis();
+    gestures.reset();
+    for (uint8_t i = 0; i < 4; i++) {
+        levels[i] = pressed[i];
+        lastEdgeMs[i] = now;
+        if (pressed[i]) gestures.onEdge(ButtonEdge{i, true, now});
+    }
+
+    // Above the Arduino loop task, so gestures are timed while it blocks
+    xTaskCreate(taskMain, "buttons", 2048, this, tskIDLE_PRIORITY + 5, &task);
+
+    if (mode == BUTTON_INPUT_PCF8574) {
+        // INT is open-drain and held low until the port is read; the read
+        // needs I2C, so the ISR only hands it to the task
+        pinMode(PCF_INT_PIN, INPUT);
+        attachInterruptArg(PCF_INT_PIN, expanderIsr, this, FALLING);
+    } else {
+        for (int i = 0; i < 4; i++) {
+            attachInterruptArg(buttonPins[i], gpioIsr, &pinContexts[i], CHANGE);
+        }
+    }
+
+    #if DEBUG_ENABLED
+    Serial.printf("Buttons: %s, interrupt driven\n",
+                  mode == BUTTON_INPUT_PCF8574 ? "PCF8574" : "GPIO");
+    #endif
+    return true;
+}
+
+void ButtonDriver::end() {
+    if (mode == BUTTON_INPUT_PCF8574) {
+        detachInterrupt(PCF_INT_PIN);
+    } else {
+        for (int i = 0; i < 4; i++) {
+            detachInterrupt(buttonPins[i]);
+        }
+    }
+    if (task) {
+        vTaskDelete(task);
+        task = nullptr;
+    }
+}
+
+void IRAM_ATTR ButtonDriver::gpioIsr(void* arg) {
+    PinContext* context = (PinContext*)arg;
+    ButtonDriver* driver = context->driver;
+    bool pressed = digitalRead(buttonPins[context->button]) == LOW;  // Active low
+    if (driver->handleLevel(context->button, pressed, millis(), true)) {
+        BaseType_t woken = pdFALSE;
+        vTaskNotifyGiveFromISR(driver->task, &woken);
+        portYIELD_FROM_ISR(woken);
+    }
+}
+
+void IRAM_ATTR ButtonDriver::expanderIsr(void* arg) {
+    ButtonDriver* driver = (ButtonDriver*)arg;
+    driver->expanderEdgeMs = millis();
+    driver->expanderChanged = true;
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(driver->task, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+void ButtonDriver::taskMain(void* arg) {
+    ((ButtonDriver*)arg)->runTask();
+}
+
+void ButtonDriver::runTask() {
+    for (;;) {
+        // Sleep until an edge arrives, a bounce has settled or a long press is due
+        uint32_t now = millis();
+        uint32_t waitMs = gestures.msUntilDeadline(now);
+        uint32_t settleMs = msUntilSettle(now);
+        if (settleMs < waitMs) waitMs = settleMs;
+        ulTaskNotifyTake(pdTRUE, waitMs == UINT32_MAX ? portMAX_DELAY : pdMS_TO_TICKS(waitMs));
+
+        if (mode == BUTTON_INPUT_PCF8574 && expanderChanged) {
+            expanderChanged = false;
+            bool pressed[4];
+            if (readExpander(pressed)) {
+                for (uint8_t i = 0; i < 4; i++) {
+                    handleLevel(i, pressed[i], expanderEdgeMs, false);
+                }
+            } else {
+                settlePending = 0x0F;  // Bus error: read again after the debounce time
+            }
+        }
+
+        now = millis();
+        if (settlePending && msUntilSettle(now) == 0) {
+            settle(now);
+        }
+
+        ButtonEdge edge;
+        while (edges.pop(&edge)) {
+            gestures.onEdge(edge);
+        }
+        gestures.tick(millis());
+    }
+}
+
+void ButtonDriver::emitEvent(const ButtonEvent& event, void* context) {
+    ButtonDriver* driver = (ButtonDriver*)context;
+    if (!driver->events.push(event)) {
+        driver->droppedEvents++;  // Application fell behind; keep the older events
+    }
+}
+
+// Returns true when the button task has something to look at
+bool IRAM_ATTR ButtonDriver::handleLevel(uint8_t button, bool pressed, uint32_t nowMs, bool fromIsr) {
+    if (fromIsr) portENTER_CRITICAL_ISR(&stateLock); else portENTER_CRITICAL(&stateLock);
+    bool changed = pressed != levels[button];
+    if (changed && nowMs - lastEdgeMs[button] < BUTTON_DEBOUNCE_MS) {
+        // Bounce: look again once the contact is quiet
+        settlePending |= (1 << button);
+    } else if (changed) {
+        levels[button] = pressed;
+        lastEdgeMs[button] = nowMs;
+        // A full edge queue means the task is stuck; the level still tracks
+        edges.push(ButtonEdge{button, pressed, nowMs});
+    }
+    if (fromIsr) portEXIT_CRITICAL_ISR(&stateLock); else portEXIT_CRITICAL(&stateLock);
+    return changed;
+}
+
+bool ButtonDriver::readExpander(bool pressed[4]) {
+    if (Wire.requestFrom((uint8_t)PCF_I2C_ADDR, (uint8_t)1) != 1) return false;
+    uint8_t port = Wire.read();
+    for (int i = 0; i < 4; i++) {
+        pressed[i] = !(port & (1 << expanderBits[i]));  // Active low
+    }
+    return true;
+}
+
+void ButtonDriver::readRaw(bool pressed[4]) {
+    if (mode == BUTTON_INPUT_PCF8574) {
+        if (readExpander(pressed)) return;
+        for (int i = 0; i < 4; i++) pressed[i] = levels[i];  // Keep state on a bus error
+        return;
+    }
+    for (int i = 0; i < 4; i++) {
+        pressed[i] = digitalRead(buttonPins[i]) == LOW;
+    }
+}
+
+void ButtonDriver::settle(uint32_t nowMs) {
+    bool pressed[4];
+    readRaw(pressed);
+    portENTER_CRITICAL(&stateLock);
+    settlePending = 0;
+    portEXIT_CRITICAL(&stateLock);
+    for (uint8_t i = 0; i < 4; i++) {
+        handleLevel(i, pressed[i], nowMs, false);
+    }
+}
+
+uint32_t ButtonDriver::msUntilSettle(uint32_t nowMs) const {
+    if (!settlePending) return UINT32_MAX;
+    uint32_t wait = 0;
+    for (int i = 0; i < 4; i++) {
+        if (!(settlePending & (1 << i))) continue;
+        uint32_t quiet = nowMs - lastEdgeMs[i];
+        if (quiet < BUTTON_DEBOUNCE_MS && BUTTON_DEBOUNCE_MS - quiet > wait) {
+            wait = BUTTON_DEBOUNCE_MS - quiet;
+        }
+    }
+    return wait;
+}
+
+void ButtonDriver::resync() {
+    settle(millis());
+    if (task) xTaskNotifyGive(task);
+}
+
+bool ButtonDriver::readEvent(ButtonEvent* event) {
+    return events.pop(event);
+}
+
+void ButtonDriver::discardEvents() {
+    events.discard();
+}
+
+bool ButtonDriver::isAnyDown() const {
+    for (int i = 0; i < 4; i++) {
+        if (levels[i]) return true;
+    }
+    return false;
+}
+
+void ButtonDriver::enableLightSleepWakeup() {
+    // A level interrupt would fire continuously while a button is held, so
+    // the edge interrupts are masked and only the wake logic sees the level
+    if (mode == BUTTON_INPUT_PCF8574) {
+        gpio_intr_disable((gpio_num_t)PCF_INT_PIN);
+        gpio_wakeup_enable((gpio_num_t)PCF_INT_PIN, GPIO_INTR_LOW_LEVEL);
+        return;
+    }
+    for (int i = 0; i < 4; i++) {
+        gpio_intr_disable((gpio_num_t)buttonPins[i]);
+        gpio_wakeup_enable((gpio_num_t)buttonPins[i], GPIO_INTR_LOW_LEVEL);  // Active low
+    }
+}
+
+void ButtonDriver::disableLightSleepWakeup() {
+    if (mode == BUTTON_INPUT_PCF8574) {
+        gpio_wakeup_disable((gpio_num_t)PCF_INT_PIN);
+        gpio_set_intr_type((gpio_num_t)PCF_INT_PIN, GPIO_INTR_NEGEDGE);
+        gpio_intr_enable((gpio_num_t)PCF_INT_PIN);
+    } else {
+        for (int i = 0; i < 4; i++) {
+            gpio_wakeup_disable((gpio_num_t)buttonPins[i]);
+            gpio_set_intr_type((gpio_num_t)buttonPins[i], GPIO_INTR_ANYEDGE);
+            gpio_intr_enable((gpio_num_t)buttonPins[i]);
+        }
+    }
+
+    // The press that ended the sleep happened while edges were masked
+    resync();
+}
+
+static_assert(WAKE_EXT1_BUTTON_MASK != 0 &&
+              (WAKE_EXT1_BUTTON_MASK & (WAKE_EXT1_BUTTON_MASK - 1)) == 0,
+              "WAKE_EXT1_BUTTON_MASK must hold exactly one button (ext1 ALL_LOW)");
+
+void ButtonDriver::enableDeepSleepWakeup() {
+    if (mode == BUTTON_INPUT_PCF8574) {
+        // INT is open-drain, active low, with the board's pull-up; GPIO 35
+        // has no internal pulls
+        esp_sleep_enable_ext0_wakeup((gpio_num_t)PCF_INT_PIN, 0);
+        return;
+    }
+
+    // Note: Button pins use INPUT_PULLUP, so a press pulls low (level 0)
+    esp_sleep_enable_ext0_wakeup((gpio_num_t)BUTTON_1_PIN, 0);
+
+    // Local-action button on EXT1; the digital pull-ups are off in deep
+    // sleep, so hold the pin high from the RTC domain instead
+    for (int pin = 0; pin < 64; pin++) {
+        if (!(WAKE_EXT1_BUTTON_MASK & (1ULL << pin))) continue;
+        rtc_gpio_pullup_en((gpio_num_t)pin);
+        rtc_gpio_pulldown_dis((gpio_num_t)pin);
+    }
+    esp_sleep_pd_config(ESP_PD_DOMAIN_RTC_PERIPH, ESP_PD_OPTION_ON);
+    esp_sleep_enable_ext1_wakeup(WAKE_EXT1_BUTTON_MASK, ESP_EXT1_WAKEUP_ALL_LOW);
+}
+
+void ButtonDriver::releaseWakeLine() {
+    if (mode != BUTTON_INPUT_PCF8574) return;
+    bool pressed[4];
+    readExpander(pressed);
+}
+
+int ButtonDriver::readWakeButton() {
+    // Runs before the hardware is initialised
+    Wire.begin(SDA_PIN, SCL_PIN);
+    if (Wire.requestFrom((uint8_t)PCF_I2C_ADDR, (uint8_t)1) != 1) return -1;
+    uint8_t port = Wire.read();
+    for (int i = 0; i < 4; i++) {
+        if (!(port & (1 << expanderBits[i]))) return i;  // Active low
+    }
+    return -1;
+}
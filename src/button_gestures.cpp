@@ -0,0 +1,110 @@
+#include "button_gestures.h"
+
+ButtonGestures::ButtonGestures(const ButtonGestureConfig& gestureConfig, EmitFn emitFunction, void* context)
+    : config(gestureConfig)
+    , emitFn(emitFunction)
+    , emitContext(context) {
+    reset();
+}
+
+void ButtonGestures::reset() {
+    for (int i = 0; i < 4; i++) {
+        tracks[i] = Track{false, false, 0, false, 0, 0};
+    }
+}
+
+void ButtonGestures::emit(uint8_t type, uint8_t button, uint8_t mask, uint32_t timeMs) {
+    if (emitFn) {
+        emitFn(ButtonEvent{type, button, mask, timeMs}, emitContext);
+    }
+}
+
+uint8_t ButtonGestures::downMask() const {
+    uint8_t mask = 0;
+    for (int i = 0; i < 4; i++) {
+        if (tracks[i].down) mask |= (1 << i);
+    }
+    return mask;
+}
+
+void ButtonGestures::onEdge(const ButtonEdge& edge) {
+    if (edge.button >= 4) return;
+    Track& track = tracks[edge.button];
+
+    if (edge.pressed) {
+        if (track.down) return;  // Missed release; keep the original press
+        track.down = true;
+        track.inChord = false;
+        track.longLevel = 0;
+        track.pressMs = edge.timeMs;
+        emit(BUTTON_EVENT_PRESS, edge.button, 1 << edge.button, edge.timeMs);
+
+        // Another button went down just before this one: a chord, and none
+        // of the buttons involved reports a click or long press any more
+        bool chord = false;
+        for (int i = 0; i < 4; i++) {
+            if (i != edge.button && tracks[i].down && !tracks[i].longLevel &&
+                edge.timeMs - tracks[i].pressMs <= config.chordWindowMs) {
+                chord = true;
+            }
+        }
+        if (chord) {
+            uint8_t mask = downMask();
+            uint8_t lowest = 0;
+            while (!(mask & (1 << lowest))) lowest++;
+            for (int i = 0; i < 4; i++) {
+                if (mask & (1 << i)) tracks[i].inChord = true;
+            }
+            emit(BUTTON_EVENT_CHORD, lowest, mask, edge.timeMs);
+        }
+        return;
+    }
+
+    if (!track.down) return;  // Release without a press we saw
+    track.down = false;
+    emit(BUTTON_EVENT_RELEASE, edge.button, 1 << edge.button, edge.timeMs);
+
+    if (track.inChord || track.longLevel) {
+        track.clickArmed = false;
+        return;
+    }
+    emit(BUTTON_EVENT_CLICK, edge.button, 1 << edge.button, edge.timeMs);
+    if (track.clickArmed && edge.timeMs - track.lastClickMs <= config.doubleClickMs) {
+        emit(BUTTON_EVENT_DOUBLE_CLICK, edge.button, 1 << edge.button, edge.timeMs);
+        track.clickArmed = false;
+    } else {
+        track.clickArmed = true;
+    }
+    track.lastClickMs = edge.timeMs;
+}
+
+void ButtonGestures::tick(uint32_t nowMs) {
+    for (uint8_t i = 0; i < 4; i++) {
+        Track& track = tracks[i];
+        if (!track.down || track.inChord) continue;
+
+        uint32_t held = nowMs - track.pressMs;
+        if (track.longLevel < 1 && held >= config.longPressMs) {
+            track.longLevel = 1;
+            emit(BUTTON_EVENT_LONG, i, 1 << i, nowMs);
+        }
+        if (track.longLevel < 2 && held >= config.veryLongPressMs) {
+            track.longLevel = 2;
+            emit(BUTTON_EVENT_VERY_LONG, i, 1 << i, nowMs);
+        }
+    }
+}
+
+uint32_t ButtonGestures::msUntilDeadline(uint32_t nowMs) const {
+    uint32_t next = UINT32_MAX;
+    for (int i = 0; i < 4; i++) {
+        const Track& track = tracks[i];
+        if (!track.down || track.inChord || track.longLevel >= 2) continue;
+
+        uint32_t due = track.longLevel < 1 ? config.longPressMs : config.veryLongPressMs;
+        uint32_t held = nowMs - track.pressMs;
+        uint32_t wait = held >= due ? 0 : due - held;
+        if (wait < next) next = wait;
+    }
+    return next;
+}
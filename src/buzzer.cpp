@@ -0,0 +1,163 @@
+#include "buzzer.h"
+
+static const BuzzerNote patternClick[] = { {2000, 30} };
+static const BuzzerNote patternToggleOn[] = { {1000, 80} };
+static const BuzzerNote patternToggleOff[] = { {600, 80} };
+static const BuzzerNote patternError[] = { {400, 200}, {0, 200}, {400, 200} };
+static const BuzzerNote patternConfirm[] = { {1000, 200}, {0, 300}, {1000, 200}, {0, 300}, {1000, 200} };
+static const BuzzerNote patternAttention[] = { {800, 120} };
+
+struct PatternEntry {
+    const BuzzerNote* notes;
+    uint8_t count;
+};
+
+#define PATTERN(p) { p, sizeof(p) / sizeof(p[0]) }
+static const PatternEntry patterns[] = {
+    PATTERN(patternClick),       // BUZZER_CLICK
+    PATTERN(patternToggleOn),    // BUZZER_TOGGLE_ON
+    PATTERN(patternToggleOff),   // BUZZER_TOGGLE_OFF
+    PATTERN(patternError),       // BUZZER_ERROR
+    PATTERN(patternConfirm),     // BUZZER_CONFIRM
+    PATTERN(patternAttention)    // BUZZER_ATTENTION
+};
+#undef PATTERN
+
+Buzzer::Buzzer()
+    : timer(nullptr)
+    , lock(nullptr)
+    , notes(nullptr)
+    , noteCount(0)
+    , noteIndex(0)
+    , playing(false)
+    , generation(0)
+    , armedGeneration(0)
+    , armed(false)
+    , customNote{0, 0}
+    , ready(false) {}
+
+bool Buzzer::begin() {
+    if (ready) return true;
+
+    lock = xSemaphoreCreateMutex();
+    if (!lock) return false;
+
+    ledcSetup(BUZZER_LEDC_CHANNEL, 2000, BUZZER_LEDC_RESOLUTION_BITS);
+    ledcAttachPin(BUZZER_PIN, BUZZER_LEDC_CHANNEL);
+    ledcWrite(BUZZER_LEDC_CHANNEL, 0);
+
+    esp_timer_create_args_t args = {};
+    args.callback = onTimer;
+    args.arg = this;
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.name = "buzzer";
+    if (esp_timer_create(&args, &timer) != ESP_OK) {
+        #if DEBUG_ENABLED
+        Serial.println("Buzzer: sequencer timer unavailable");
+        #endif
+        vSemaphoreDelete(lock);
+        lock = nullptr;
+        return false;
+    }
+    ready = true;
+    return true;
+}
+
+void Buzzer::end() {
+    if (!ready) return;
+    stop();
+    esp_timer_delete(timer);
+    timer = nullptr;
+    vSemaphoreDelete(lock);
+    lock = nullptr;
+    ledcDetachPin(BUZZER_PIN);
+    digitalWrite(BUZZER_PIN, LOW);
+    ready = false;
+}
+
+void Buzzer::play(BuzzerPattern pattern) {
+    if ((size_t)pattern >= sizeof(patterns) / sizeof(patterns[0])) return;
+    play(patterns[pattern].notes, patterns[pattern].count);
+}
+
+void Buzzer::play(const BuzzerNote* sequence, uint8_t count) {
+    if (!ready || !sequence || count == 0) return;
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    esp_timer_stop(timer);
+    generation++;
+    notes = sequence;
+    noteCount = count;
+    playing = true;
+    startNote(0);
+    xSemaphoreGive(lock);
+}
+
+void Buzzer::tone(uint16_t frequency, uint16_t durationMs) {
+    if (!ready) return;
+    // The sequence may still point at customNote
+    xSemaphoreTake(lock, portMAX_DELAY);
+    esp_timer_stop(timer);
+    armed = false;
+    customNote = BuzzerNote{frequency, durationMs};
+    xSemaphoreGive(lock);
+    play(&customNote, 1);
+}
+
+void Buzzer::stop() {
+    if (!ready) return;
+    xSemaphoreTake(lock, portMAX_DELAY);
+    esp_timer_stop(timer);
+    generation++;
+    silence();
+    xSemaphoreGive(lock);
+}
+
+void Buzzer::finish(uint32_t timeoutMs) {
+    unsigned long start = millis();
+    while (playing && millis() - start < timeoutMs) {
+        delay(10);
+    }
+    stop();
+}
+
+// Runs in the esp_timer task: the current note is over, go to the next
+void Buzzer::onTimer(void* arg) {
+    Buzzer* buzzer = (Buzzer*)arg;
+    xSemaphoreTake(buzzer->lock, portMAX_DELAY);
+    // Stale when play(), tone() or stop() ran after this expiry was
+    // dispatched: they replaced the sequence, or re-armed the timer for a
+    // note that is still sounding
+    bool stale = !buzzer->armed || buzzer->armedGeneration != buzzer->generation ||
+                 esp_timer_is_active(buzzer->timer);
+    if (!stale) {
+        buzzer->startNote(buzzer->noteIndex + 1);
+    }
+    xSemaphoreGive(buzzer->lock);
+}
+
+void Buzzer::startNote(uint8_t index) {
+    armed = false;
+    if (!playing || index >= noteCount) {
+        silence();
+        return;
+    }
+
+    BuzzerNote note = notes[index];
+    noteIndex = index;
+    if (note.frequency > 0) {
+        ledcWriteTone(BUZZER_LEDC_CHANNEL, note.frequency);  // 50% duty
+    } else {
+        ledcWrite(BUZZER_LEDC_CHANNEL, 0);
+    }
+    armedGeneration = generation;
+    armed = esp_timer_start_once(timer, (uint64_t)note.durationMs * 1000ULL) == ESP_OK;
+}
+
+void Buzzer::silence() {
+    ledcWrite(BUZZER_LEDC_CHANNEL, 0);
+    armed = false;
+    playing = false;
+    notes = nullptr;
+    noteCount = 0;
+}
@@ -0,0 +1,221 @@
+#include "cache_index.h"
+#include "paperdink_hardware.h"
+
+// On-card layout: header followed by `count` CacheEntry records
+static const uint32_t CACHE_INDEX_MAGIC = 0x49434450;  // "PDCI"
+static const uint16_t CACHE_INDEX_VERSION = 2;
+
+struct CacheIndexHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t count;
+    uint32_t nextSeq;
+    uint32_t useClock;
+};
+
+CacheIndex::CacheIndex()
+    : count(0)
+    , nextSeq(0)
+    , useClock(0)
+    , loaded(false)
+    , dirty(false) {
+}
+
+String CacheIndex::storedName(const char* filename) {
+    size_t length = strlen(filename);
+    bool plain = length > 0 && length < CACHE_FILENAME_MAX;
+    for (size_t i = 0; i < length && plain; i++) {
+        if (filename[i] == '/' || filename[i] == '\\') plain = false;
+    }
+    if (plain) return String(filename);
+
+    // FNV-1a keeps long names with the same start apart; the extension is
+    // kept so the file type still shows on the card
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (uint8_t)filename[i];
+        hash *= 16777619u;
+    }
+    const char* dot = strrchr(filename, '.');
+    String extension = (dot && strlen(dot) <= 8 && !strpbrk(dot, "/\\")) ? String(dot) : String("");
+    char tag[12];
+    snprintf(tag, sizeof(tag), "~%08lx", (unsigned long)hash);
+
+    size_t keep = CACHE_FILENAME_MAX - 1 - strlen(tag) - extension.length();
+    String name;
+    for (size_t i = 0; i < length && name.length() < keep; i++) {
+        char c = filename[i];
+        name += (c == '/' || c == '\\') ? '_' : c;
+    }
+    return name + tag + extension;
+}
+
+void CacheIndex::clear() {
+    count = 0;
+    nextSeq = 0;
+    useClock = 0;
+    loaded = true;
+    dirty = true;
+}
+
+bool CacheIndex::load(PaperdInkHardware* hardware) {
+    if (loaded) return true;
+
+    uint8_t buffer[sizeof(CacheIndexHeader) + sizeof(entries)];
+    size_t bytesRead = 0;
+    count = 0;
+    nextSeq = 0;
+    useClock = 0;
+    loaded = true;
+
+    if (!hardware->readFile(CACHE_INDEX_PATH, buffer, sizeof(buffer), &bytesRead) ||
+        bytesRead < sizeof(CacheIndexHeader)) {
+        // No index yet (or unreadable): start empty
+        return false;
+    }
+
+    CacheIndexHeader header;
+    memcpy(&header, buffer, sizeof(header));
+    if (header.magic != CACHE_INDEX_MAGIC || header.version != CACHE_INDEX_VERSION ||
+        header.count > MAX_CACHED_IMAGES ||
+        bytesRead < sizeof(header) + header.count * sizeof(CacheEntry)) {
+        #if DEBUG_ENABLED
+        Serial.println("Cache index invalid; starting empty");
+        #endif
+        return false;
+    }
+
+    count = (uint8_t)header.count;
+    nextSeq = header.nextSeq;
+    useClock = header.useClock;
+    memcpy(entries, buffer + sizeof(header), count * sizeof(CacheEntry));
+    for (uint8_t i = 0; i < count; i++) {
+        entries[i].filename[CACHE_FILENAME_MAX - 1] = '\0';
+    }
+    dirty = false;
+
+    #if DEBUG_ENABLED
+    Serial.printf("Cache index loaded: %u entries\n", count);
+    #endif
+    return true;
+}
+
+bool CacheIndex::save(PaperdInkHardware* hardware) {
+    if (!dirty) return true;
+
+    uint8_t buffer[sizeof(CacheIndexHeader) + sizeof(entries)];
+    CacheIndexHeader header;
+    header.magic = CACHE_INDEX_MAGIC;
+    header.version = CACHE_INDEX_VERSION;
+    header.count = count;
+    header.nextSeq = nextSeq;
+    header.useClock = useClock;
+    memcpy(buffer, &header, sizeof(header));
+    memcpy(buffer + sizeof(header), entries, count * sizeof(CacheEntry));
+
+    hardware->createDirectory(CACHE_DIR);
+    if (!hardware->writeFile(CACHE_INDEX_PATH, buffer, sizeof(header) + count * sizeof(CacheEntry))) {
+        return false;
+    }
+    dirty = false;
+    return true;
+}
+
+int CacheIndex::findSlot(const char* filename) const {
+    String name = storedName(filename);
+    for (uint8_t i = 0; i < count; i++) {
+        if (strcmp(entries[i].filename, name.c_str()) == 0) return i;
+    }
+    return -1;
+}
+
+int CacheIndex::leastRecentlyUsedSlot() const {
+    int slot = -1;
+    for (uint8_t i = 0; i < count; i++) {
+        if (slot < 0 || entries[i].lastUsed < entries[slot].lastUsed) slot = i;
+    }
+    return slot;
+}
+
+void CacheIndex::removeSlot(int slot) {
+    for (uint8_t i = slot; i + 1 < count; i++) {
+        entries[i] = entries[i + 1];
+    }
+    count--;
+    dirty = true;
+}
+
+bool CacheIndex::touch(const char* filename, uint32_t size, String* evicted) {
+    bool fits = true;
+    int slot = findSlot(filename);
+
+    if (slot < 0) {
+        if (count >= MAX_CACHED_IMAGES) {
+            int lru = leastRecentlyUsedSlot();
+            if (evicted) *evicted = entries[lru].filename;
+            removeSlot(lru);
+            fits = false;
+        }
+        slot = count++;
+        String name = storedName(filename);
+        strncpy(entries[slot].filename, name.c_str(), CACHE_FILENAME_MAX - 1);
+        entries[slot].filename[CACHE_FILENAME_MAX - 1] = '\0';
+        entries[slot].seq = nextSeq++;
+        entries[slot].frameFlags = 0;
+    }
+
+    if (entries[slot].size != size) {
+        entries[slot].frameFlags = 0;  // Content changed; pre-rendered frame is stale
+    }
+    entries[slot].lastUsed = ++useClock;
+    entries[slot].size = size;
+    dirty = true;
+    return fits;
+}
+
+bool CacheIndex::remove(const char* filename) {
+    int slot = findSlot(filename);
+    if (slot < 0) return false;
+    removeSlot(slot);
+    return true;
+}
+
+void CacheIndex::setFrameFlags(const char* filename, uint8_t flags) {
+    int slot = findSlot(filename);
+    if (slot < 0 || entries[slot].frameFlags == flags) return;
+    entries[slot].frameFlags = flags;
+    dirty = true;
+}
+
+const CacheEntry* CacheIndex::find(const char* filename) const {
+    int slot = findSlot(filename);
+    return slot < 0 ? nullptr : &entries[slot];
+}
+
+const CacheEntry* CacheIndex::nextInPlaylist(uint32_t afterSeq) const {
+    // Smallest seq after afterSeq, wrapping around to the smallest overall
+    const CacheEntry* next = nullptr;
+    const CacheEntry* first = nullptr;
+    for (uint8_t i = 0; i < count; i++) {
+        const CacheEntry* e = &entries[i];
+        if (!first || e->seq < first->seq) first = e;
+        if (e->seq > afterSeq && (!next || e->seq < next->seq)) next = e;
+    }
+    return next ? next : first;
+}
+
+const CacheEntry* CacheIndex::prevInPlaylist(uint32_t beforeSeq) const {
+    // Largest seq before beforeSeq, wrapping around to the largest overall
+    const CacheEntry* prev = nullptr;
+    const CacheEntry* last = nullptr;
+    for (uint8_t i = 0; i < count; i++) {
+        const CacheEntry* e = &entries[i];
+        if (!last || e->seq > last->seq) last = e;
+        if (e->seq < beforeSeq && (!prev || e->seq > prev->seq)) prev = e;
+    }
+    return prev ? prev : last;
+}
+
+const CacheEntry* CacheIndex::entryAt(uint8_t index) const {
+    return index < count ? &entries[index] : nullptr;
+}
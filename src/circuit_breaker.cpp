@@ -0,0 +1,72 @@
+#include "circuit_breaker.h"
+
+CircuitBreaker::CircuitBreaker(CircuitBreakerState& persisted, const CircuitBreakerConfig& breakerConfig)
+    : state(persisted)
+    , config(breakerConfig) {
+}
+
+CircuitBreakerState CircuitBreaker::initialState() {
+    return CircuitBreakerState{ CIRCUIT_CLOSED, 0, 0, 0 };
+}
+
+uint32_t CircuitBreaker::backoffSeconds() const {
+    // base * 2^(trips - 1), capped
+    uint32_t backoff = config.baseBackoffSeconds;
+    for (uint8_t i = 1; i < state.trips && backoff < config.maxBackoffSeconds; i++) {
+        backoff *= 2;
+    }
+    return backoff < config.maxBackoffSeconds ? backoff : config.maxBackoffSeconds;
+}
+
+void CircuitBreaker::open(int64_t now) {
+    if (state.trips < UINT8_MAX) state.trips++;
+    state.state = CIRCUIT_OPEN;
+    state.retryAt = now + backoffSeconds();
+}
+
+bool CircuitBreaker::allowRequest(int64_t now) {
+    switch (state.state) {
+        case CIRCUIT_OPEN:
+            // Due, or the clock jumped back (e.g. first time sync) beyond any backoff
+            if (now >= state.retryAt || state.retryAt - now > (int64_t)config.maxBackoffSeconds) {
+                state.state = CIRCUIT_HALF_OPEN;
+                return true;
+            }
+            return false;
+
+        case CIRCUIT_HALF_OPEN:
+            // The previous trial never reported back
+            open(now);
+            return false;
+
+        default:
+            return true;
+    }
+}
+
+void CircuitBreaker::recordSuccess() {
+    state = initialState();
+}
+
+void CircuitBreaker::recordFailure(int64_t now) {
+    if (state.state == CIRCUIT_HALF_OPEN) {
+        open(now);
+        return;
+    }
+    if (state.state == CIRCUIT_OPEN) return;
+
+    if (state.failures < UINT8_MAX) state.failures++;
+    if (state.failures >= config.failureThreshold) {
+        open(now);
+    }
+}
+
+uint8_t CircuitBreaker::attemptsAllowed(uint8_t normalAttempts) const {
+    if (state.state == CIRCUIT_CLOSED && state.failures == 0) return normalAttempts;
+    return 1;
+}
+
+uint32_t CircuitBreaker::secondsUntilRetry(int64_t now) const {
+    if (state.state != CIRCUIT_OPEN || now >= state.retryAt) return 0;
+    return (uint32_t)(state.retryAt - now);
+}
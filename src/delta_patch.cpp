@@ -0,0 +1,126 @@
+#include "delta_patch.h"
+#include <string.h>
+
+static uint32_t readU32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+bool parseDeltaHeader(const uint8_t* data, size_t length, DeltaHeader* header) {
+    if (length < DELTA_HEADER_SIZE || memcmp(data, DELTA_MAGIC, 8) != 0) return false;
+    header->baseSize = readU32(data + 8);
+    header->targetSize = readU32(data + 12);
+    memcpy(header->baseSha256, data + 16, 32);
+    memcpy(header->targetSha256, data + 48, 32);
+    return header->targetSize > 0;
+}
+
+DeltaPatcher::DeltaPatcher(DeltaReadFn reader, DeltaWriteFn writer, void* callbackContext)
+    : readBase(reader)
+    , writeTarget(writer)
+    , context(callbackContext)
+    , header()
+    , stage(STAGE_FAILED)
+    , controlFill(0)
+    , diffLeft(0)
+    , extraLeft(0)
+    , seek(0)
+    , basePos(0)
+    , produced(0) {
+}
+
+void DeltaPatcher::begin(const DeltaHeader& deltaHeader) {
+    header = deltaHeader;
+    stage = STAGE_CONTROL;
+    controlFill = 0;
+    diffLeft = 0;
+    extraLeft = 0;
+    seek = 0;
+    basePos = 0;
+    produced = 0;
+}
+
+void DeltaPatcher::nextRecord() {
+    basePos += seek;
+    controlFill = 0;
+    stage = produced == header.targetSize ? STAGE_DONE : STAGE_CONTROL;
+}
+
+size_t DeltaPatcher::applyDiff(const uint8_t* data, size_t length) {
+    size_t n = length < diffLeft ? length : diffLeft;
+    if (n > CHUNK_SIZE) n = CHUNK_SIZE;
+    if (basePos < 0 || basePos + (int64_t)n > (int64_t)header.baseSize ||
+        !readBase(context, (uint32_t)basePos, chunk, n)) {
+        stage = STAGE_FAILED;
+        return 0;
+    }
+    for (size_t i = 0; i < n; i++) {
+        chunk[i] = (uint8_t)(chunk[i] + data[i]);
+    }
+    if (!writeTarget(context, chunk, n)) {
+        stage = STAGE_FAILED;
+        return 0;
+    }
+    basePos += n;
+    produced += n;
+    diffLeft -= n;
+    return n;
+}
+
+size_t DeltaPatcher::copyExtra(const uint8_t* data, size_t length) {
+    size_t n = length < extraLeft ? length : extraLeft;
+    if (!writeTarget(context, data, n)) {
+        stage = STAGE_FAILED;
+        return 0;
+    }
+    produced += n;
+    extraLeft -= n;
+    return n;
+}
+
+bool DeltaPatcher::feed(const uint8_t* data, size_t length) {
+    while (length > 0 && stage != STAGE_FAILED) {
+        size_t used = 0;
+        switch (stage) {
+            case STAGE_CONTROL: {
+                used = sizeof(control) - controlFill;
+                if (used > length) used = length;
+                memcpy(control + controlFill, data, used);
+                controlFill += used;
+                if (controlFill < sizeof(control)) break;
+
+                diffLeft = readU32(control);
+                extraLeft = readU32(control + 4);
+                seek = (int32_t)readU32(control + 8);
+                // A record may not write past the announced target
+                if ((uint64_t)produced + diffLeft + extraLeft > header.targetSize) {
+                    stage = STAGE_FAILED;
+                    break;
+                }
+                stage = diffLeft > 0 ? STAGE_DIFF : (extraLeft > 0 ? STAGE_EXTRA : STAGE_CONTROL);
+                if (stage == STAGE_CONTROL) nextRecord();
+                break;
+            }
+
+            case STAGE_DIFF:
+                used = applyDiff(data, length);
+                if (stage == STAGE_DIFF && diffLeft == 0) {
+                    if (extraLeft > 0) stage = STAGE_EXTRA;
+                    else nextRecord();
+                }
+                break;
+
+            case STAGE_EXTRA:
+                used = copyExtra(data, length);
+                if (stage == STAGE_EXTRA && extraLeft == 0) nextRecord();
+                break;
+
+            default:
+                // Trailing bytes after the last record
+                stage = STAGE_FAILED;
+                break;
+        }
+        data += used;
+        length -= used;
+    }
+    return stage != STAGE_FAILED;
+}
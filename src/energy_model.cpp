@@ -0,0 +1,199 @@
+#include "energy_model.h"
+#include <esp_timer.h>
+
+struct EnergyState {
+    uint32_t cycles;
+    float lastMah;
+    float averageMah;           // EMA over cycles
+    float averageCycleSeconds;  // EMA of wake plus sleep time
+    uint32_t lastAwakeMs;
+};
+
+// Per CPU policy (and per API transport), wake charge only: sleep length
+// depends on the server and the refresh policy, not on either
+struct PolicyEnergy {
+    uint32_t cycles;
+    float averageWakeMah;       // EMA over this policy's cycles
+    float averageAwakeMs;
+};
+
+static RTC_DATA_ATTR EnergyState s_energy = { 0, 0.0f, 0.0f, 0.0f, 0 };
+static RTC_DATA_ATTR PolicyEnergy s_policyEnergy[CPU_POLICY_COUNT] = {};
+static RTC_DATA_ATTR PolicyEnergy s_transportEnergy[API_TRANSPORT_COUNT] = {};
+
+// Per-wake phase bookkeeping (RAM, starts from zero every boot)
+static int64_t s_phaseStartUs[ENERGY_PHASE_COUNT] = { 0 };
+static uint32_t s_phaseMs[ENERGY_PHASE_COUNT] = { 0 };
+
+// CPU charge so far this wake, integrated at every clock change
+static uint32_t s_cpuMhz = 0;       // 0 = still at the boot clock
+static int64_t s_cpuSinceUs = 0;
+static float s_cpuMaMs = 0.0f;
+static CpuPolicy s_policy = CPU_POLICY_FIXED;
+static int s_transport = -1;  // No backend request this wake yet
+
+static const char* const kTransportNames[API_TRANSPORT_COUNT] = { "https", "http" };
+
+static void addWake(PolicyEnergy& energy, float wakeMah, uint32_t awakeMs) {
+    if (energy.cycles == 0) {
+        energy.averageWakeMah = wakeMah;
+        energy.averageAwakeMs = awakeMs;
+    } else {
+        energy.averageWakeMah += ENERGY_AVERAGE_WEIGHT * (wakeMah - energy.averageWakeMah);
+        energy.averageAwakeMs += ENERGY_AVERAGE_WEIGHT * (awakeMs - energy.averageAwakeMs);
+    }
+    energy.cycles++;
+}
+
+// "<name> mAh/awake s/cycles" for every entry with a cycle
+static String wakeSummary(const PolicyEnergy* energy, int count, const char* (*name)(int)) {
+    String line;
+    for (int i = 0; i < count; i++) {
+        if (energy[i].cycles == 0) continue;
+        if (line.length() > 0) line += " ";
+        line += String(name(i)) + " " +
+                String(energy[i].averageWakeMah, 3) + "/" +
+                String(energy[i].averageAwakeMs / 1000.0f, 1) + "s/" + String(energy[i].cycles);
+    }
+    return line;
+}
+
+void EnergyModel::beginPhase(EnergyPhase phase) {
+    if (s_phaseStartUs[phase] == 0) {
+        s_phaseStartUs[phase] = esp_timer_get_time();
+    }
+}
+
+void EnergyModel::endPhase(EnergyPhase phase) {
+    if (s_phaseStartUs[phase] != 0) {
+        s_phaseMs[phase] += (uint32_t)((esp_timer_get_time() - s_phaseStartUs[phase]) / 1000);
+        s_phaseStartUs[phase] = 0;
+    }
+}
+
+float EnergyModel::cpuMaAt(uint32_t mhz) {
+    if (mhz <= 80) return ENERGY_CPU_LOW_MA;
+    if (mhz >= 240) return ENERGY_CPU_ACTIVE_MA;
+    return ENERGY_CPU_LOW_MA + (ENERGY_CPU_ACTIVE_MA - ENERGY_CPU_LOW_MA) * (mhz - 80) / 160.0f;
+}
+
+void EnergyModel::noteCpuFrequency(uint32_t mhz) {
+    int64_t now = esp_timer_get_time();
+    uint32_t current = s_cpuMhz ? s_cpuMhz : getCpuFrequencyMhz();
+    s_cpuMaMs += (now - s_cpuSinceUs) / 1000.0f * cpuMaAt(current);
+    s_cpuMhz = mhz;
+    s_cpuSinceUs = now;
+}
+
+void EnergyModel::setCpuPolicy(CpuPolicy policy) {
+    s_policy = policy;
+}
+
+void EnergyModel::setTransport(ApiTransport transport) {
+    s_transport = transport;
+}
+
+float EnergyModel::cycleMah(uint32_t awakeMs, uint32_t radioMs, uint32_t panelMs, uint32_t sleepSeconds,
+                            float cpuMa) {
+    // mA * ms -> mAh: divide by 3.6e6
+    float mAms = awakeMs * cpuMa +
+                 radioMs * ENERGY_RADIO_MA +
+                 panelMs * ENERGY_PANEL_REFRESH_MA +
+                 sleepSeconds * 1000.0f * ENERGY_DEEP_SLEEP_MA;
+    return mAms / 3600000.0f;
+}
+
+void EnergyModel::closeCycle(uint32_t sleepSeconds) {
+    for (int phase = 0; phase < ENERGY_PHASE_COUNT; phase++) {
+        endPhase((EnergyPhase)phase);
+    }
+
+    // Close the time at the current clock
+    noteCpuFrequency(getCpuFrequencyMhz());
+
+    uint32_t awakeMs = (uint32_t)(esp_timer_get_time() / 1000);
+    float cpuMa = awakeMs > 0 ? s_cpuMaMs / awakeMs : ENERGY_CPU_ACTIVE_MA;
+    float mah = cycleMah(awakeMs, s_phaseMs[ENERGY_RADIO], s_phaseMs[ENERGY_PANEL], sleepSeconds, cpuMa);
+    float wakeMah = cycleMah(awakeMs, s_phaseMs[ENERGY_RADIO], s_phaseMs[ENERGY_PANEL], 0, cpuMa);
+    float cycleSeconds = awakeMs / 1000.0f + sleepSeconds;
+
+    if (s_energy.cycles == 0) {
+        s_energy.averageMah = mah;
+        s_energy.averageCycleSeconds = cycleSeconds;
+    } else {
+        s_energy.averageMah += ENERGY_AVERAGE_WEIGHT * (mah - s_energy.averageMah);
+        s_energy.averageCycleSeconds += ENERGY_AVERAGE_WEIGHT * (cycleSeconds - s_energy.averageCycleSeconds);
+    }
+    s_energy.cycles++;
+    s_energy.lastMah = mah;
+    s_energy.lastAwakeMs = awakeMs;
+
+    addWake(s_policyEnergy[s_policy], wakeMah, awakeMs);
+    if (s_transport >= 0) {
+        addWake(s_transportEnergy[s_transport], wakeMah, awakeMs);
+    }
+
+    #if DEBUG_ENABLED
+    Serial.printf("Energy: awake %lu ms (CPU %.1f mA avg), radio %lu ms, panel %lu ms, sleep %lu s => %.4f mAh (avg %.4f)\n",
+                  (unsigned long)awakeMs, cpuMa, (unsigned long)s_phaseMs[ENERGY_RADIO],
+                  (unsigned long)s_phaseMs[ENERGY_PANEL], (unsigned long)sleepSeconds,
+                  mah, s_energy.averageMah);
+    Serial.printf("Energy per wake by CPU policy: %s\n", policySummary().c_str());
+    Serial.printf("Energy per wake by API transport: %s\n", transportSummary().c_str());
+    #endif
+}
+
+float EnergyModel::getLastCycleMah() {
+    return s_energy.lastMah;
+}
+
+float EnergyModel::getAverageCycleMah() {
+    return s_energy.averageMah;
+}
+
+uint32_t EnergyModel::getAverageCycleSeconds() {
+    return (uint32_t)s_energy.averageCycleSeconds;
+}
+
+uint32_t EnergyModel::getLastAwakeMs() {
+    return s_energy.lastAwakeMs;
+}
+
+float EnergyModel::projectedDays(int batteryPercent) {
+    if (s_energy.cycles == 0 || s_energy.averageMah <= 0.0f || s_energy.averageCycleSeconds <= 0.0f) {
+        return 0.0f;
+    }
+    float remainingMah = BATTERY_CAPACITY_MAH * batteryPercent / 100.0f;
+    float mahPerDay = s_energy.averageMah * (86400.0f / s_energy.averageCycleSeconds);
+    return remainingMah / mahPerDay;
+}
+
+float EnergyModel::getPolicyWakeMah(CpuPolicy policy) {
+    if (policy >= CPU_POLICY_COUNT) return 0.0f;
+    return s_policyEnergy[policy].averageWakeMah;
+}
+
+uint32_t EnergyModel::getPolicyCycles(CpuPolicy policy) {
+    if (policy >= CPU_POLICY_COUNT) return 0;
+    return s_policyEnergy[policy].cycles;
+}
+
+String EnergyModel::policySummary() {
+    return wakeSummary(s_policyEnergy, CPU_POLICY_COUNT,
+                       [](int i) { return PowerPhases::policyName((CpuPolicy)i); });
+}
+
+float EnergyModel::getTransportWakeMah(ApiTransport transport) {
+    if (transport >= API_TRANSPORT_COUNT) return 0.0f;
+    return s_transportEnergy[transport].averageWakeMah;
+}
+
+uint32_t EnergyModel::getTransportCycles(ApiTransport transport) {
+    if (transport >= API_TRANSPORT_COUNT) return 0;
+    return s_transportEnergy[transport].cycles;
+}
+
+String EnergyModel::transportSummary() {
+    return wakeSummary(s_transportEnergy, API_TRANSPORT_COUNT,
+                       [](int i) { return kTransportNames[i]; });
+}
@@ -17,18 +17,44 @@
 #include "config.h"
 #include "paperdink_hardware.h"
 #include "trmnl_client.h"
+#include "profiler.h"
+#include "energy_model.h"
+#include "power_phases.h"
+#include "wake_watchdog.h"
+#include "ota_updater.h"
+#include "push_server.h"
+#include "refresh_policy.h"
 #include "secrets.h"
+#include <esp_timer.h>
 
 // Global objects
 PaperdInkHardware hardware;
 TRMNLClient trmnlClient(&hardware);
+PushServer pushServer;
+
+// Sleep-interval policy, configured from config.h
+static const SocStretchPoint refreshSocCurve[] = REFRESH_SOC_CURVE;
+static const RefreshPolicyConfig refreshPolicyConfig = {
+    refreshSocCurve,
+    sizeof(refreshSocCurve) / sizeof(refreshSocCurve[0]),
+    REFRESH_QUIET_START_SECOND,
+    REFRESH_QUIET_END_SECOND,
+    REFRESH_UNCHANGED_STRETCH_MAX,
+    REFRESH_MIN_SLEEP_SECONDS,
+    REFRESH_MAX_SLEEP_SECONDS
+};
+RefreshPolicy refreshPolicy(refreshPolicyConfig);
 
 // State variables
 unsigned long lastUpdateTime = 0;
 unsigned long lastButtonCheck = 0;
 bool systemInitialized = false;
 bool forceRefresh = false;
+bool forceRedraw = false;   // Button asked for it: redraw even an unchanged screen
+bool chargingMode = false;  // On external power: radio stays up, cache warm-up runs
 static bool suppressStartupUI = false; // Skip boot/ready screens on deep-sleep wake
+static bool pushWindowOpen = false;     // On battery: awake for pushed images until pushWindowEnd
+static unsigned long pushWindowEnd = 0;
 
 // Function prototypes
 void setup();
@@ -38,61 +64,72 @@ void handleSystemStates();
 void performStartupSequence();
 void showStartupScreen();
 void showErrorScreen(const String& error);
-void showStatusScreen();
+void showStatusScreen(uint32_t timeoutMs = 0);
 void enterSleepMode();
-bool checkWakeupReason();
+void sleepFor(uint32_t sleepSeconds);
+bool checkWakeupReason(int* wakeButton);
+void handleLocalWake(int button);
+bool wakeButtonHeldLong(int button);
 void handleFactoryReset();
+void handleWakeOverrun();
+bool startPushServer();
+void showWipeProgress(uint32_t removed, void* context);
+void printBootBanner();
+uint32_t computeSleepDuration();
+int32_t getLocalSecondOfDay();
 
 void setup() {
+    Profiler::beginCycle();
+    PowerPhases::beginCycle();
+    // Armed before anything can hang; only deep sleep or an intended long
+    // stay awake (charging, setup portal) ends it
+    WakeWatchdog::begin([](uint32_t sleepSeconds) { hardware.forceDeepSleep(sleepSeconds); });
+    WakeWatchdog::arm();
+    PROFILE_SCOPE("setup");
+
     // Initialize serial communication for debugging
     Serial.begin(115200);
-    delay(3000);  // Longer delay for stable boot
-
-    // Ensure we're fully booted
-    Serial.println();
-    Serial.println("*** BOOT START ***");
-    Serial.flush();
-    delay(100);
 
-    Serial.println();
-    Serial.println("========================================");
-    Serial.println("=== paperd.ink TRMNL Firmware v1.0 ===");
-    Serial.println("========================================");
-    Serial.println();
-
-    Serial.print("ESP32 Chip ID: ");
-    Serial.println(ESP.getChipModel());
-    Serial.print("MAC Address: ");
-    Serial.println(hardware.getMacAddress());
-    Serial.print("Free Heap: ");
-    Serial.println(ESP.getFreeHeap());
-    Serial.println();
-
-    Serial.println("Configuration:");
-    Serial.println("- DEBUG_ENABLED: " + String(DEBUG_ENABLED));
-    Serial.println("- DEVELOPMENT_MODE: " + String(DEVELOPMENT_MODE));
-    Serial.println("- WiFi SSID: " + String(WIFI_SSID));
-    #ifdef CUSTOM_FRIENDLY_ID
-    Serial.println("- Device ID: " + String(CUSTOM_FRIENDLY_ID));
-    #else
-    Serial.println("- Device ID: (not set)");
-    #endif
-    #ifdef CUSTOM_API_KEY
-    Serial.println("- API Key: " + String(CUSTOM_API_KEY).substring(0, 8) + "...");
-    #else
-    Serial.println("- API Key: (not set)");
-    #endif
-    Serial.println();
-
-    Serial.println("Starting hardware initialization...");
+    // A freshly installed image stays on probation until its first good refresh
+    OtaUpdater::beginHealthCheck();
+
+    // Check wakeup reason; a button wake also reports which button
+    int wakeButton = -1;
+    bool userWakeup = checkWakeupReason(&wakeButton);
+
+    // Timer or button wake with a valid RTC snapshot: start associating with
+    // the AP first thing and bring the rest of the hardware up while the radio works
+    HardwareSnapshot hardwareSnapshot;
+    ClientSnapshot clientSnapshot;
+    bool sleepWake = wakeButton >= 0 || esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_TIMER;
+    bool warmBoot = sleepWake && WakeSnapshot::load(&hardwareSnapshot, &clientSnapshot);
+    // Registered and running, possibly through an outage (offline)
+    bool registeredWake = warmBoot && (clientSnapshot.state == STATE_OPERATIONAL ||
+                                       clientSnapshot.state == STATE_OFFLINE);
+    // Every button but refresh is served from the SD cache with the radio off
+    bool localWake = registeredWake && wakeButton > 0;
+    bool radioAllowed = true;
+    if (warmBoot) {
+        hardware.restoreSnapshot(hardwareSnapshot);
+        // During an outage most timer wakes only rotate cached screens; decide
+        // before the radio is powered. The refresh button always tries
+        if (localWake) {
+            radioAllowed = false;
+        } else if (wakeButton < 0 && registeredWake) {
+            radioAllowed = trmnlClient.shouldAttemptRadio();
+        }
+        if (radioAllowed) {
+            trmnlClient.startWiFiConnect();
+        }
+    } else {
+        printBootBanner();
+    }
 
-    // Check wakeup reason
-    bool userWakeup = checkWakeupReason();
-    // If we woke from deep sleep (timer or button), suppress boot/ready UI
-    suppressStartupUI = !userWakeup;
+    // If we woke from deep sleep (timer, or button with a snapshot), suppress boot/ready UI
+    suppressStartupUI = !userWakeup || warmBoot;
 
     // Initialize hardware
-    if (!hardware.begin()) {
+    if (!hardware.begin(warmBoot ? &hardwareSnapshot : nullptr)) {
         #if DEBUG_ENABLED
         Serial.println("ERROR: Hardware initialization failed!");
         #endif
@@ -107,14 +144,8 @@ void setup() {
         showStartupScreen();
     }
 
-    // Check for factory reset (Button 4 held during startup)
-    if (hardware.isButtonVeryLongPressed(3)) {  // Button 4 (index 3)
-        handleFactoryReset();
-        return;
-    }
-
     // Initialize TRMNL client
-    if (!trmnlClient.begin()) {
+    if (!trmnlClient.begin(warmBoot ? &clientSnapshot : nullptr)) {
         #if DEBUG_ENABLED
         Serial.println("ERROR: TRMNL client initialization failed!");
         #endif
@@ -122,15 +153,42 @@ void setup() {
         delay(5000);
     }
 
-    // Perform startup sequence
-    performStartupSequence();
-    if (suppressStartupUI) return; // keep current content on screen
+    // An earlier wake ran out of budget: tell the server with the next log batch
+    String overrunLine;
+    if (WakeWatchdog::takeOverrunReport(&overrunLine)) {
+        #if DEBUG_ENABLED
+        Serial.println("Previous wake: " + overrunLine);
+        #endif
+        trmnlClient.queueLog(overrunLine);
+    }
+
+    if (localWake) {
+        handleLocalWake(wakeButton);  // Ends in deep sleep
+        return;
+    }
+
+    // Perform startup sequence, unless the snapshot already has us operational
+    if (!warmBoot || trmnlClient.getState() != STATE_OPERATIONAL) {
+        performStartupSequence();
+    }
 
     systemInitialized = true;
     // Trigger an immediate first content refresh after startup
     forceRefresh = true;
     lastUpdateTime = millis();
 
+    if (suppressStartupUI) {
+        // Timer wake during an outage: rotate cached screens without the radio
+        if (!warmBoot && trmnlClient.getState() == STATE_OPERATIONAL) {
+            radioAllowed = trmnlClient.shouldAttemptRadio();
+        }
+        if (trmnlClient.getState() == STATE_OPERATIONAL && !radioAllowed) {
+            trmnlClient.displayNextCachedImage();
+            enterSleepMode();
+        }
+        return; // keep current content on screen
+    }
+
     #if DEBUG_ENABLED
     Serial.println("=== System initialized successfully ===");
     hardware.printSystemInfo();
@@ -161,6 +219,12 @@ void loop() {
         }
     }
 
+    // Wake budget spent (setup included): cached content, then sleep
+    if (WakeWatchdog::expired()) {
+        handleWakeOverrun();
+        return;
+    }
+
     if (!systemInitialized) {
         #if DEBUG_ENABLED
         Serial.println("Loop: systemInitialized is false, returning");
@@ -170,41 +234,98 @@ void loop() {
     }
 
     // Update hardware states
-    hardware.updateButtons();
+    hardware.updateBattery();
 
-    // Handle button inputs
+    // Handle button events queued since the last pass
     handleButtons();
 
     // Handle TRMNL client operations
     trmnlClient.loop();
 
+    // Pushed images; each one keeps the device reachable a while longer
+    if (pushServer.handle()) {
+        WakeWatchdog::extend();
+        if (pushWindowOpen) pushWindowEnd = millis() + PUSH_AWAKE_WINDOW_MS;
+    }
+    if (pushWindowOpen && (long)(millis() - pushWindowEnd) >= 0) {
+        pushWindowOpen = false;
+        pushServer.end();
+        enterSleepMode();
+        return;
+    }
+
     // Handle system states
     handleSystemStates();
 
+    // Charging mode: one warm-up job per loop, back to battery schedule on unplug
+    if (chargingMode) {
+        if (!hardware.isCharging()) {
+            #if DEBUG_ENABLED
+            Serial.println("Charging ended: leaving charging mode");
+            #endif
+            chargingMode = false;
+            WakeWatchdog::arm();
+            pushServer.end();
+            trmnlClient.endChargingWarmup();
+            enterSleepMode();
+            return;
+        }
+        trmnlClient.runChargingWarmupStep();
+    }
+
     // Check if it's time for a content update
     unsigned long currentTime = millis();
     if (forceRefresh ||
         (currentTime - lastUpdateTime >= (unsigned long)trmnlClient.getRefreshRate() * 1000UL)) {
 
-        if (trmnlClient.updateContent()) {
+        if (trmnlClient.updateContent(forceRedraw)) {
             lastUpdateTime = currentTime;
             forceRefresh = false;
+            forceRedraw = false;
 
             #if DEBUG_ENABLED
             Serial.println("Content updated successfully");
             #endif
 
-            // Nach erfolgreichem Update sofort schlafen, Wake per Timer/Button
-            enterSleepMode();
-            return;
+            // Firmware offered with this screen; restarts on success
+            trmnlClient.installOfferedFirmware();
+
+            // On external power stay awake and warm the cache instead
+            if (hardware.isCharging()) {
+                if (!chargingMode) {
+                    chargingMode = true;
+                    WakeWatchdog::suspend();  // Staying awake is the point now
+                    // No sleep-time commit while plugged in; persist now
+                    hardware.commitSettings();
+                    trmnlClient.beginChargingWarmup();
+                    startPushServer();
+                }
+            } else if (!pushWindowOpen && PUSH_AWAKE_WINDOW_MS > 0 && startPushServer()) {
+                // Stay reachable for pushed images for a short window first
+                pushWindowOpen = true;
+                pushWindowEnd = millis() + PUSH_AWAKE_WINDOW_MS;
+            } else if (!pushWindowOpen) {
+                // Nach erfolgreichem Update sofort schlafen, Wake per Timer/Button
+                enterSleepMode();
+                return;
+            }
         } else {
             #if DEBUG_ENABLED
             Serial.println("Content update failed: " + trmnlClient.getLastError());
             #endif
 
-            // Try offline mode if available
-            if (trmnlClient.hasCachedContent()) {
-                trmnlClient.displayCachedContent();
+            // Aborted by the wake budget rather than failed on its own
+            if (WakeWatchdog::expired()) {
+                handleWakeOverrun();
+                return;
+            }
+
+            // Registered device lost the network: rotate cached content and
+            // back off the radio on later wakes
+            if (trmnlClient.hasWiFiCredentials() && trmnlClient.isDeviceRegistered()) {
+                trmnlClient.enterOfflineMode();
+                enterSleepMode();
+                return;
             }
         }
     }
@@ -216,64 +337,50 @@ void loop() {
         enterSleepMode();
     }
 
-    // Small delay to prevent excessive CPU usage
-    delay(100);
+    // Nap until a button is pressed or the next scheduled check
+    hardware.idle(IDLE_LOOP_MAX_MS);
 }
 
 void handleButtons() {
-    static unsigned long lastButtonTime = 0;
-    unsigned long currentTime = millis();
-
-    if (currentTime - lastButtonTime < BUTTON_DEBOUNCE_MS) {
-        return;
-    }
-
-    // Button 1: Manual refresh / Wake
-    if (hardware.getButtonState(0) == BUTTON_PRESSED) {
+    ButtonEvent event;
+    while (hardware.readButtonEvent(&event)) {
         #if DEBUG_ENABLED
-        Serial.println("Button 1 pressed: Manual refresh");
+        Serial.printf("Button event %u, button %u, mask 0x%02X at %lu ms\n",
+                      event.type, event.button, event.mask, (unsigned long)event.timeMs);
         #endif
-        forceRefresh = true;
-        hardware.resetButtonState(0);
-        lastButtonTime = currentTime;
-    }
 
-    // Button 2: Toggle invert display
-    if (hardware.getButtonState(1) == BUTTON_PRESSED) {
-        bool inv = !hardware.getInvertDisplay();
-        hardware.setInvertDisplay(inv);
-        #if DEBUG_ENABLED
-        Serial.printf("Button 2 pressed: Invert %s\n", inv ? "ON" : "OFF");
-        #endif
-        hardware.beep(inv ? 1000 : 600, 80);
-        forceRefresh = true; // redraw current content with new invert mode
-        hardware.resetButtonState(1);
-        lastButtonTime = currentTime;
-    }
+        // Button 1: Manual refresh
+        if (event.type == BUTTON_EVENT_CLICK && event.button == 0) {
+            forceRefresh = true;
+            forceRedraw = true;
+        }
 
-    // Button 3: Settings/Configuration mode
-    if (hardware.getButtonState(2) == BUTTON_LONG_PRESS) {
-        #if DEBUG_ENABLED
-        Serial.println("Button 3 long press: Configuration mode");
-        #endif
-        showStatusScreen();
-        hardware.resetButtonState(2);
-        lastButtonTime = currentTime;
-    }
+        // Button 2: Toggle invert display
+        if (event.type == BUTTON_EVENT_CLICK && event.button == 1) {
+            bool inv = !hardware.getInvertDisplay();
+            hardware.setInvertDisplay(inv);
+            #if DEBUG_ENABLED
+            Serial.printf("Button 2: Invert %s\n", inv ? "ON" : "OFF");
+            #endif
+            hardware.playPattern(inv ? BUZZER_TOGGLE_ON : BUZZER_TOGGLE_OFF);
+            forceRefresh = true; // redraw current content with new invert mode
+            forceRedraw = true;
+        }
 
-    // Button 4: Power/Sleep toggle
-    if (hardware.getButtonState(3) == BUTTON_PRESSED) {
-        #if DEBUG_ENABLED
-        Serial.println("Button 4 pressed: Sleep mode");
-        #endif
-        enterSleepMode();
-        hardware.resetButtonState(3);
-        lastButtonTime = currentTime;
-    }
+        // Button 3: Settings/Configuration mode
+        if (event.type == BUTTON_EVENT_LONG && event.button == 2) {
+            showStatusScreen();
+        }
+
+        // Button 4: Power/Sleep toggle
+        if (event.type == BUTTON_EVENT_CLICK && event.button == 3) {
+            enterSleepMode();
+        }
 
-    // Button 4 very long press: Factory reset (handled in setup)
-    if (hardware.getButtonState(3) == BUTTON_VERY_LONG_PRESS) {
-        handleFactoryReset();
+        // Button 4 very long press (also when held through boot): Factory reset
+        if (event.type == BUTTON_EVENT_VERY_LONG && event.button == 3) {
+            handleFactoryReset();
+        }
     }
 }
 
@@ -340,8 +447,9 @@ void handleSystemStates() {
                 }
             } else {
                 // WiFi is connected, check for updates periodically
+                // Charging mode refreshes on the regular schedule between warm-up jobs
                 static unsigned long lastUpdateCheck = 0;
-                if (millis() - lastUpdateCheck > 60000) {  // Check every minute
+                if (!chargingMode && millis() - lastUpdateCheck > 60000) {  // Check every minute
                     #if DEBUG_ENABLED
                     Serial.println("Checking for content updates...");
                     #endif
@@ -443,13 +551,12 @@ void showErrorScreen(const String& error) {
     hardware.displayText("to continue", 10, 180, 1);
     hardware.updateDisplay();
 
-    // Beep to indicate error
-    hardware.beep(400, 200);
-    delay(200);
-    hardware.beep(400, 200);
+    // Beep to indicate error (plays while the caller carries on)
+    hardware.playPattern(BUZZER_ERROR);
 }
 
-void showStatusScreen() {
+// Waits for B3, or at most timeoutMs when non-zero
+void showStatusScreen(uint32_t timeoutMs) {
     hardware.clearDisplay();
     hardware.displayText("Status", 10, 20, 2);
 
@@ -502,35 +609,116 @@ void showStatusScreen() {
     String ramLine = String("Free RAM: ") + String(hardware.getFreeHeap()/1024) + " KB";
     hardware.displayText(ramLine.c_str(), 10, 215, 1);
 
-    hardware.displayText("Press B3 to exit | Hold B1: format SD", 10, 235, 1);
+    // Energy per wake cycle and projected battery life
+    String energyLine = String("Energy: ");
+    if (EnergyModel::getAverageCycleMah() > 0.0f) {
+        energyLine += String(EnergyModel::getAverageCycleMah(), 3) + " mAh/cycle, ~" +
+                      String((int)EnergyModel::projectedDays(hardware.getBatteryPercentage())) + " days left";
+    } else {
+        energyLine += "no cycle measured yet";
+    }
+    hardware.displayText(energyLine.c_str(), 10, 230, 1);
+
+    // Phase timings of the previous wake (ms), when the profiler is built in
+    String profileLine = Profiler::summary(1);
+    if (profileLine.length() > 0) {
+        profileLine = profileLine.substring(0, 64);
+        hardware.displayText(profileLine.c_str(), 10, 245, 1);
+    }
+
+    // Energy per wake under each CPU policy run so far
+    #if CPU_SCALING_ENABLED
+    String cpuLine = String("CPU ") + PowerPhases::policyName(PowerPhases::getPolicy()) + ": " +
+                     EnergyModel::policySummary();
+    hardware.displayText(cpuLine.substring(0, 64).c_str(), 10, 260, 1);
+    #endif
+
+    // Backend transport in use and energy per wake under each one seen
+    String apiLine = String("API ") + (trmnlClient.isPlainHttp() ? "http" : "https") + ": " +
+                     EnergyModel::transportSummary();
+    hardware.displayText(apiLine.substring(0, 64).c_str(), 10, 275, 1);
+
+    hardware.displayText("Press B3 to exit | Hold B1: format SD", 10, 290, 1);
     hardware.updateDisplay();
 
     // Wait loop: B3 exits, long-press B1 formats SD (with beep)
-    while (true) {
-        hardware.updateButtons();
-        if (hardware.getButtonState(2) == BUTTON_PRESSED) { // B3 short press
-            hardware.resetButtonState(2);
-            break;
+    unsigned long shownAt = millis();
+    bool exitRequested = false;
+    while (!exitRequested && (timeoutMs == 0 || millis() - shownAt < timeoutMs)) {
+        ButtonEvent event;
+        if (!hardware.readButtonEvent(&event)) {
+            hardware.idle(IDLE_LOOP_MAX_MS);
+            continue;
+        }
+        if (event.type == BUTTON_EVENT_CLICK && event.button == 2) { // B3 short press
+            exitRequested = true;
         }
-        if (hardware.getButtonState(0) == BUTTON_LONG_PRESS) { // B1 long press
-            hardware.beep(800, 120);
-            hardware.displayText("Formatting SD...", 10, 255, 1);
+        if (event.type == BUTTON_EVENT_LONG && event.button == 0) { // B1 long press
+            hardware.playPattern(BUZZER_ATTENTION);
+            hardware.displayText("Formatting SD...", 10, 275, 1);
             hardware.updateDisplay();
-            bool ok = hardware.formatSDCard();
-            hardware.displayText(ok ? "SD format: OK" : "SD format: FAIL", 10, 270, 1);
+            // A full card can take minutes; keep the budget out of it, and
+            // off again afterwards in charging mode
+            bool watchdogArmed = WakeWatchdog::isArmed();
+            WakeWatchdog::suspend();
+            bool ok = hardware.formatSDCard(showWipeProgress, (void*)"Formatting SD");
+            if (watchdogArmed) WakeWatchdog::arm();
+            trmnlClient.clearCache();  // drop the in-memory cache index as well
+            hardware.displayText(ok ? "SD format: OK" : "SD format: FAIL", 10, 290, 1);
             hardware.updateDisplay();
-            // consume press
-            hardware.resetButtonState(0);
         }
-        delay(100);
     }
 }
 
 void enterSleepMode() {
+    // Sleep duration: server refresh_rate shaped by the refresh policy
+    sleepFor(computeSleepDuration());
+}
+
+// Wake budget spent: put cached content up (an outage for a registered
+// device, so the radio backs off too) and sleep on the regular schedule
+void handleWakeOverrun() {
+    #if DEBUG_ENABLED
+    Serial.println("Wake budget exceeded: showing cached content and sleeping");
+    #endif
+    if (trmnlClient.isDeviceRegistered() && trmnlClient.hasWiFiCredentials()) {
+        trmnlClient.enterOfflineMode();
+    } else {
+        trmnlClient.displayCachedContent();
+    }
+    enterSleepMode();
+}
+
+// LAN push endpoint (opt-in); needs its own PUSH_SERVER_TOKEN
+bool startPushServer() {
+    #if PUSH_SERVER_ENABLED
+    if (!trmnlClient.isWiFiConnected()) return false;
+    if (strlen(PUSH_SERVER_TOKEN) == 0) {
+        #if DEBUG_ENABLED
+        Serial.println("Push server not started: PUSH_SERVER_TOKEN is empty");
+        #endif
+        return false;
+    }
+    return pushServer.begin(&hardware, PUSH_SERVER_TOKEN);
+    #else
+    return false;
+    #endif
+}
+
+void sleepFor(uint32_t sleepDuration) {
+    // New image that never got a good refresh: back to the previous one
+    OtaUpdater::failHealthCheck();
+
+    PROFILE_BEGIN("sleep");
     #if DEBUG_ENABLED
     Serial.println("Entering sleep mode...");
     #endif
 
+    #if PROFILER_ENABLED
+    // Phase timings go out with the batched logs
+    trmnlClient.queueLog("profile " + Profiler::summary());
+    #endif
+
     // Do NOT change the E-Paper content before sleeping.
     // The current image should remain visible during deep sleep.
     #if DEBUG_ENABLED
@@ -540,23 +728,128 @@ void enterSleepMode() {
     // Disable peripherals to save power
     hardware.disablePeripherals();
 
-    // Calculate sleep duration: exactly the server-provided refresh_rate (seconds)
-    uint32_t sleepDuration = trmnlClient.getRefreshRate();
+    #if DEBUG_ENABLED
+    Serial.printf("Awake for %lu ms (reset to radio off)\n",
+                  (unsigned long)(esp_timer_get_time() / 1000));
+    #endif
+
+    // Keep runtime state in RTC memory for the next timer wake
+    HardwareSnapshot hardwareSnapshot;
+    ClientSnapshot clientSnapshot;
+    hardware.captureSnapshot(hardwareSnapshot);
+    trmnlClient.captureSnapshot(clientSnapshot);
+    WakeSnapshot::store(hardwareSnapshot, clientSnapshot);
 
     // Enter deep sleep
     hardware.enterDeepSleep(sleepDuration);
 }
 
-bool checkWakeupReason() {
+// Cold boot only: give the serial monitor time to attach, then dump config
+void printBootBanner() {
+    delay(3000);  // Longer delay for stable boot
+
+    // Ensure we're fully booted
+    Serial.println();
+    Serial.println("*** BOOT START ***");
+    Serial.flush();
+    delay(100);
+
+    Serial.println();
+    Serial.println("========================================");
+    Serial.println("=== paperd.ink TRMNL Firmware v1.0 ===");
+    Serial.println("========================================");
+    Serial.println();
+
+    Serial.print("ESP32 Chip ID: ");
+    Serial.println(ESP.getChipModel());
+    Serial.print("MAC Address: ");
+    Serial.println(hardware.getMacAddress());
+    Serial.print("Free Heap: ");
+    Serial.println(ESP.getFreeHeap());
+    Serial.println();
+
+    Serial.println("Configuration:");
+    Serial.println("- DEBUG_ENABLED: " + String(DEBUG_ENABLED));
+    Serial.println("- DEVELOPMENT_MODE: " + String(DEVELOPMENT_MODE));
+    Serial.println("- WiFi SSID: " + String(WIFI_SSID));
+    #ifdef CUSTOM_FRIENDLY_ID
+    Serial.println("- Device ID: " + String(CUSTOM_FRIENDLY_ID));
+    #else
+    Serial.println("- Device ID: (not set)");
+    #endif
+    #ifdef CUSTOM_API_KEY
+    Serial.println("- API Key: " + String(CUSTOM_API_KEY).substring(0, 8) + "...");
+    #else
+    Serial.println("- API Key: (not set)");
+    #endif
+    Serial.println();
+
+    Serial.println("Starting hardware initialization...");
+}
+
+uint32_t computeSleepDuration() {
+    RefreshPolicyInput input;
+    input.serverRefreshSeconds = trmnlClient.getRefreshRate();
+    input.batteryPercent = hardware.getBatteryPercentage();
+    input.charging = hardware.isCharging();
+    input.localSecondOfDay = getLocalSecondOfDay();
+    input.unchangedCycles = trmnlClient.getUnchangedCycles();
+
+    uint32_t sleepSeconds = refreshPolicy.nextSleepSeconds(input);
+
+    #if DEBUG_ENABLED
+    Serial.printf("Refresh policy: server %lu s, battery %d%%, charging %s, unchanged %u => %lu s\n",
+                  (unsigned long)input.serverRefreshSeconds, input.batteryPercent,
+                  input.charging ? "yes" : "no", input.unchangedCycles, (unsigned long)sleepSeconds);
+    #endif
+    return sleepSeconds;
+}
+
+// Local second of the day, or -1 while the clock has never been synced
+int32_t getLocalSecondOfDay() {
+    time_t now = time(nullptr);
+    if (now < 1609459200) return -1;  // Before 2021: not set
+
+    struct tm local;
+    localtime_r(&now, &local);
+    return local.tm_hour * 3600L + local.tm_min * 60L + local.tm_sec;
+}
+
+// Returns true for a user-initiated start; wakeButton gets the index of the
+// button that woke us from deep sleep, or -1
+bool checkWakeupReason(int* wakeButton) {
     esp_sleep_wakeup_cause_t wakeupReason = esp_sleep_get_wakeup_cause();
+    const int buttonPins[4] = {BUTTON_1_PIN, BUTTON_2_PIN, BUTTON_3_PIN, BUTTON_4_PIN};
+    *wakeButton = -1;
 
     switch (wakeupReason) {
         case ESP_SLEEP_WAKEUP_EXT0:
-        case ESP_SLEEP_WAKEUP_EXT1:
+            // GPIO buttons: only BUTTON_1 is on EXT0. Expander boards wake on
+            // its shared INT line, so the port tells which button it was; one
+            // released before we got here counts as a refresh
+            *wakeButton = 0;
+            if (BUTTON_INPUT_MODE == BUTTON_INPUT_PCF8574) {
+                int held = ButtonDriver::readWakeButton();
+                if (held >= 0) *wakeButton = held;
+            }
+            #if DEBUG_ENABLED
+            Serial.printf("Wakeup caused by external signal (button %d)\n", *wakeButton + 1);
+            #endif
+            return true;
+
+        case ESP_SLEEP_WAKEUP_EXT1: {
+            uint64_t wakeMask = esp_sleep_get_ext1_wakeup_status();
+            for (int i = 0; i < 4; i++) {
+                if (wakeMask & (1ULL << buttonPins[i])) {
+                    *wakeButton = i;
+                    break;
+                }
+            }
             #if DEBUG_ENABLED
-            Serial.println("Wakeup caused by external signal (button)");
+            Serial.printf("Wakeup caused by external signal (button %d)\n", *wakeButton + 1);
             #endif
             return true;
+        }
 
         case ESP_SLEEP_WAKEUP_TIMER:
             #if DEBUG_ENABLED
@@ -584,11 +877,73 @@ bool checkWakeupReason() {
     }
 }
 
+// Button wake served from the SD cache with the radio off, then back to
+// sleep for what is left of the scheduled interval
+// With GPIO buttons only B1 and the WAKE_EXT1_BUTTON_MASK button can wake
+// the device, so only one of the routes below is reachable there
+void handleLocalWake(int button) {
+    PROFILE_SCOPE("local");
+    bool held = wakeButtonHeldLong(button);
+
+    switch (button) {
+        case 1:  // B2: toggle invert, redraw the current screen
+            hardware.setInvertDisplay(!hardware.getInvertDisplay());
+            trmnlClient.displayCachedContent();
+            break;
+
+        case 2:  // B3: status screen, then back to the current screen
+            showStatusScreen(WAKE_STATUS_SCREEN_MS);
+            trmnlClient.displayCachedContent();
+            break;
+
+        case 3:  // B4: next cached screen, held: previous
+            if (held) {
+                trmnlClient.displayPreviousCachedImage();
+            } else {
+                trmnlClient.displayNextCachedImage();
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    // Timer already due: wake again right away for the regular refresh
+    uint32_t remaining = hardware.getSecondsUntilTimerWake();
+    sleepFor(remaining > 0 ? remaining : 1);
+}
+
+// Follows the button that woke us until it is released; true if it was
+// still down after BUTTON_LONG_PRESS_MS
+bool wakeButtonHeldLong(int button) {
+    // The driver reports a button held through boot as a press, followed by
+    // either its release or a long press
+    bool held = hardware.isButtonHeld(button);
+    unsigned long start = millis();
+    while (held && millis() - start <= BUTTON_LONG_PRESS_MS + BUTTON_DEBOUNCE_MS) {
+        ButtonEvent event;
+        if (!hardware.readButtonEvent(&event)) {
+            delay(BUTTON_DEBOUNCE_MS);
+            continue;
+        }
+        if (event.button != button) continue;
+        if (event.type == BUTTON_EVENT_RELEASE) held = false;
+        if (event.type == BUTTON_EVENT_LONG) break;
+    }
+
+    // The wake press is handled here, not by later button checks
+    hardware.discardButtonEvents();
+    return held;
+}
+
 void handleFactoryReset() {
     #if DEBUG_ENABLED
     Serial.println("Factory reset requested!");
     #endif
 
+    // Wiping the cache can take minutes; the restart at the end ends this wake
+    WakeWatchdog::suspend();
+
     hardware.clearDisplay();
     hardware.displayText("FACTORY RESET", 10, 80, 2);
     hardware.displayText("Clearing all data...", 10, 120, 1);
@@ -601,19 +956,32 @@ void handleFactoryReset() {
 
     // Clear SD card cache if available
     if (hardware.isSDCardAvailable()) {
-        // TODO: Clear cache files
+        trmnlClient.clearCache(showWipeProgress, (void*)"Clearing cache");
     }
 
     hardware.displayText("Reset complete!", 10, 160, 1);
     hardware.displayText("Restarting...", 10, 180, 1);
     hardware.updateDisplay();
 
-    // Beep to confirm reset
-    for (int i = 0; i < 3; i++) {
-        hardware.beep(1000, 200);
-        delay(300);
-    }
+    // Beep to confirm reset; restart() lets it play out
+    hardware.playPattern(BUZZER_CONFIRM);
 
     delay(2000);
     hardware.restart();
+}
+
+void showWipeProgress(uint32_t removed, void* context) {
+    static unsigned long lastShownAt = 0;
+    const char* label = (const char*)context;
+    String line = String(label) + ": " + String((unsigned long)removed) + " entries removed";
+    #if DEBUG_ENABLED
+    Serial.println(line);
+    #endif
+
+    // A full refresh takes seconds and wears the panel; the rest only goes to serial
+    if (lastShownAt != 0 && millis() - lastShownAt < SD_WIPE_DISPLAY_INTERVAL_MS) return;
+    lastShownAt = millis();
+    hardware.displayText(label, 10, 100, 2);
+    hardware.displayText(line.c_str(), 10, 140, 1);
+    hardware.updateDisplay();
 }
\ No newline at end of file
@@ -0,0 +1,89 @@
+#include "offline_scheduler.h"
+
+struct OfflineState {
+    CircuitBreakerState radio;
+    uint32_t rotationCursor;
+};
+
+// Initialized on cold boot, retained across deep sleep
+static RTC_DATA_ATTR OfflineState s_offlineState = { { CIRCUIT_CLOSED, 0, 0, 0 }, UINT32_MAX };
+
+static const CircuitBreakerConfig s_radioBreakerConfig = {
+    RADIO_BREAKER_FAILURE_THRESHOLD,
+    RADIO_BREAKER_BASE_BACKOFF_SECONDS,
+    RADIO_BREAKER_MAX_BACKOFF_SECONDS
+};
+
+// System time survives deep sleep (RTC); before the first sync it counts from boot
+static int64_t now() {
+    return (int64_t)time(nullptr);
+}
+
+OfflineScheduler::OfflineScheduler()
+    : breaker(s_offlineState.radio, s_radioBreakerConfig) {
+}
+
+bool OfflineScheduler::shouldAttemptRadio() {
+    bool allowed = breaker.allowRequest(now());
+
+    #if DEBUG_ENABLED
+    if (!allowed) {
+        Serial.printf("Offline: radio breaker open, next trial in %lu s\n",
+                      (unsigned long)breaker.secondsUntilRetry(now()));
+    } else if (breaker.getState() == CIRCUIT_HALF_OPEN) {
+        Serial.println("Offline: radio breaker half-open, trial wake");
+    }
+    #endif
+    return allowed;
+}
+
+void OfflineScheduler::recordRadioFailure() {
+    breaker.recordFailure(now());
+
+    #if DEBUG_ENABLED
+    if (breaker.getState() == CIRCUIT_OPEN) {
+        Serial.printf("Offline: radio breaker open (trip %u), skipping radio for %lu s\n",
+                      breaker.getTrips(), (unsigned long)breaker.secondsUntilRetry(now()));
+    } else {
+        Serial.printf("Offline: radio failure %u of %u\n",
+                      breaker.getFailures(), RADIO_BREAKER_FAILURE_THRESHOLD);
+    }
+    #endif
+}
+
+void OfflineScheduler::recordRadioSuccess() {
+    #if DEBUG_ENABLED
+    if (isOffline()) {
+        Serial.println("Offline: radio recovered, breaker closed");
+    }
+    #endif
+    breaker.recordSuccess();
+}
+
+bool OfflineScheduler::isOffline() const {
+    return breaker.getState() != CIRCUIT_CLOSED || breaker.getFailures() > 0;
+}
+
+CircuitState OfflineScheduler::getBreakerState() const {
+    return breaker.getState();
+}
+
+uint8_t OfflineScheduler::getRadioFailures() const {
+    return breaker.getFailures();
+}
+
+uint32_t OfflineScheduler::getSecondsUntilRadio() const {
+    return breaker.secondsUntilRetry(now());
+}
+
+uint8_t OfflineScheduler::getRadioAttempts(uint8_t normalAttempts) const {
+    return breaker.attemptsAllowed(normalAttempts);
+}
+
+uint32_t OfflineScheduler::getRotationCursor() const {
+    return s_offlineState.rotationCursor;
+}
+
+void OfflineScheduler::setRotationCursor(uint32_t seq) {
+    s_offlineState.rotationCursor = seq;
+}
@@ -0,0 +1,535 @@
+#include "ota_updater.h"
+#include <Update.h>
+#include <Preferences.h>
+#include <esp_ota_ops.h>
+#include <esp32/rom/miniz.h>
+#include <new>
+#include "delta_patch.h"
+#include "profiler.h"
+#include "wake_watchdog.h"
+
+#define OTA_PREFS_NAMESPACE "ota"
+#define OTA_RANGE_MISMATCH (-100)  // 206 that does not continue where we stopped
+
+// Patch being applied: header, inflate state and the record patcher
+struct DeltaSession {
+    const esp_partition_t* base;
+    uint8_t header[DELTA_HEADER_SIZE];
+    size_t headerFill;
+    DeltaHeader info;
+    tinfl_decompressor inflater;
+    uint8_t* window;   // TINFL_LZ_DICT_SIZE, inflate's back-reference window
+    size_t windowPos;
+    bool inflated;     // End of the zlib stream seen
+    DeltaPatcher patcher;
+
+    explicit DeltaSession(void* owner)
+        : base(nullptr)
+        , headerFill(0)
+        , info()
+        , window(nullptr)
+        , windowPos(0)
+        , inflated(false)
+        , patcher(OtaUpdater::readBase, OtaUpdater::writeTarget, owner) {
+    }
+};
+
+static bool s_healthCheckPending = false;
+
+// The Arduino core would otherwise confirm a new image as soon as it boots;
+// we do that ourselves once a refresh has worked
+extern "C" bool verifyRollbackLater() {
+    return true;
+}
+
+static String toHex(const uint8_t* digest) {
+    char hex[65];
+    for (int i = 0; i < 32; i++) {
+        snprintf(hex + i * 2, 3, "%02x", digest[i]);
+    }
+    return String(hex);
+}
+
+OtaUpdater::OtaUpdater(WiFiClientSecure& tlsClient, WiFiClient& httpClient)
+    : client(tlsClient)
+    , plainClient(httpClient)
+    , streamSize(0)
+    , received(0)
+    , written(0)
+    , delta(nullptr)
+    , installedDelta(false) {
+}
+
+// "host[:port]" of an http:// URL, lowercase and without a default :80;
+// empty for anything else, including URLs with user info
+static String plainHttpAuthority(const String& url) {
+    if (!url.startsWith("http://")) return "";
+    unsigned int end = 7;
+    while (end < url.length() && url[end] != '/' && url[end] != '?' && url[end] != '#') end++;
+    String authority = url.substring(7, end);
+    authority.toLowerCase();
+    if (authority.indexOf('@') >= 0) return "";
+    if (authority.endsWith(":80")) authority.remove(authority.length() - 3);
+    return authority;
+}
+
+bool OtaUpdater::isPlainHttpAllowed(const String& url, const String& baseUrl) {
+    String authority = plainHttpAuthority(url);
+    return authority.length() > 0 && authority == plainHttpAuthority(baseUrl);
+}
+
+int OtaUpdater::openStream(HTTPClient& http, const String& url, const String& apiKey) {
+    // download() has turned away http:// URLs from anywhere else
+    if (isPlainHttpAllowed(url, plainHttpBase)) http.begin(plainClient, url);
+    else http.begin(client, url);
+    http.addHeader("User-Agent", "paperdink-trmnl/1.0");
+    http.addHeader("access-token", apiKey);
+    http.useHTTP10(true);  // No chunked encoding on the raw stream
+    http.setFollowRedirects(HTTPC_STRICT_FOLLOW_REDIRECTS);
+    http.setTimeout(WakeWatchdog::clampTimeout(OTA_STALL_TIMEOUT_MS));
+    if (received > 0) {
+        http.addHeader("Range", "bytes=" + String(received) + "-");
+    }
+    const char* headers[] = { "Content-Range" };
+    http.collectHeaders(headers, 1);
+
+    int code = http.GET();
+    if (code == 206) {
+        // "bytes <first>-<last>/<total>" must pick up exactly where we stopped
+        String range = http.header("Content-Range");
+        int space = range.indexOf(' ');
+        int slash = range.indexOf('/');
+        long first = space >= 0 ? range.substring(space + 1).toInt() : -1;
+        long total = slash >= 0 ? range.substring(slash + 1).toInt() : -1;
+        if (first != (long)received || total != (long)streamSize) {
+            #if DEBUG_ENABLED
+            Serial.printf("OTA: unexpected Content-Range '%s' at %u\n", range.c_str(), (unsigned)received);
+            #endif
+            return OTA_RANGE_MISMATCH;
+        }
+    }
+    return code;
+}
+
+bool OtaUpdater::restartStream(int contentLength) {
+    if (Update.isRunning()) {
+        Update.abort();
+    }
+    streamSize = 0;
+    received = 0;
+    written = 0;
+
+    if (contentLength <= 0) {
+        lastError = "no Content-Length";
+        return false;
+    }
+    streamSize = (size_t)contentLength;
+
+    if (delta) {
+        // Update.begin() waits for the target size in the patch header
+        delta->headerFill = 0;
+        delta->windowPos = 0;
+        delta->inflated = false;
+        tinfl_init(&delta->inflater);
+        return true;
+    }
+
+    if (!Update.begin(streamSize)) {
+        lastError = String("begin: ") + Update.errorString();
+        return false;
+    }
+    mbedtls_sha256_starts_ret(&sha, 0);
+    return true;
+}
+
+OtaUpdater::PumpResult OtaUpdater::pumpStream(HTTPClient& http) {
+    WiFiClient* stream = http.getStreamPtr();
+    if (!stream) return PUMP_INTERRUPTED;
+
+    uint32_t lastDataMs = millis();
+    while (received < streamSize) {
+        if (WakeWatchdog::expired()) return PUMP_INTERRUPTED;
+
+        size_t available = stream->available();
+        if (available == 0) {
+            if (!stream->connected() || millis() - lastDataMs > OTA_STALL_TIMEOUT_MS) {
+                return PUMP_INTERRUPTED;
+            }
+            delay(1);
+            continue;
+        }
+
+        size_t want = available < sizeof(buffer) ? available : sizeof(buffer);
+        if (want > streamSize - received) want = streamSize - received;
+        int got = stream->read(buffer, want);
+        if (got <= 0) continue;
+        lastDataMs = millis();
+
+        if (!consume(buffer, (size_t)got)) {
+            return PUMP_FAILED;
+        }
+        received += (size_t)got;
+    }
+    return PUMP_COMPLETE;
+}
+
+bool OtaUpdater::consume(const uint8_t* data, size_t length) {
+    return delta ? consumeDelta(data, length) : writeImage(data, length);
+}
+
+bool OtaUpdater::writeImage(const uint8_t* data, size_t length) {
+    mbedtls_sha256_update_ret(&sha, data, length);
+    if (Update.write(const_cast<uint8_t*>(data), length) != length) {
+        lastError = String("write: ") + Update.errorString();
+        return false;
+    }
+    written += length;
+    return true;
+}
+
+bool OtaUpdater::finishImage() {
+    if (delta && (!delta->patcher.isComplete() || !delta->inflated)) {
+        Update.abort();
+        lastError = "delta: patch ended early";
+        return false;
+    }
+
+    uint8_t digest[32];
+    mbedtls_sha256_finish_ret(&sha, digest);
+    String hex = toHex(digest);
+
+    #if DEBUG_ENABLED
+    Serial.printf("OTA: %u bytes, SHA-256 %s\n", (unsigned)written, hex.c_str());
+    #endif
+
+    if (expectedSha.length() > 0 && !expectedSha.equalsIgnoreCase(hex)) {
+        Update.abort();
+        lastError = "SHA-256 mismatch";
+        return false;
+    }
+
+    // Checks the image (header, segments, appended hash) and switches the boot slot
+    if (!Update.end()) {
+        lastError = String("end: ") + Update.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool OtaUpdater::download(const String& url, const String& apiKey) {
+    streamSize = 0;
+    received = 0;
+    written = 0;
+
+    // No firmware (or access token) in the clear except from the LAN server
+    if (url.startsWith("http://") && !isPlainHttpAllowed(url, plainHttpBase)) {
+        lastError = "plain http:// URL not allowed";
+        return false;
+    }
+
+    bool complete = false;
+    for (uint8_t attempt = 0; attempt <= OTA_MAX_RESUMES && !complete; attempt++) {
+        if (WakeWatchdog::expired()) {
+            lastError = "wake budget spent";
+            break;
+        }
+
+        HTTPClient http;
+        int code = openStream(http, url, apiKey);
+        if (code == 200) {
+            // First request, or a server that ignored the Range header
+            if (!restartStream(http.getSize())) {
+                http.end();
+                break;
+            }
+        } else if (code == OTA_RANGE_MISMATCH) {
+            http.end();
+            received = 0;  // Start over without Range
+            continue;
+        } else if (code != 206) {
+            http.end();
+            lastError = "HTTP " + String(code);
+            // Transport errors and 5xx may pass; anything else will not
+            if (code > 0 && code < 500) break;
+            delay(1000UL * (attempt + 1));
+            continue;
+        }
+
+        PumpResult result = pumpStream(http);
+        http.end();
+
+        #if DEBUG_ENABLED
+        Serial.printf("OTA: %u/%u bytes after attempt %u\n",
+                      (unsigned)received, (unsigned)streamSize, attempt + 1);
+        #endif
+
+        if (result == PUMP_COMPLETE) {
+            complete = finishImage();
+            break;
+        }
+        if (result == PUMP_FAILED) break;
+        lastError = "interrupted";
+    }
+
+    if (!complete && Update.isRunning()) {
+        Update.abort();
+    }
+    return complete;
+}
+
+bool OtaUpdater::update(const String& url, const String& expectedSha256, const String& apiKey,
+                        const String& deltaUrl) {
+    PROFILE_SCOPE("ota");
+    lastError = "";
+    installedDelta = false;
+
+    // The whole image should arrive within this wake. Charging mode runs
+    // without a budget; it gets that back afterwards
+    bool watchdogArmed = WakeWatchdog::isArmed();
+    WakeWatchdog::arm(OTA_WAKE_BUDGET_MS);
+    mbedtls_sha256_init(&sha);
+
+    bool complete = false;
+    #if OTA_DELTA_ENABLED
+    if (deltaUrl.length() > 0) {
+        delta = new (std::nothrow) DeltaSession(this);
+        uint8_t* window = delta ? (uint8_t*)malloc(TINFL_LZ_DICT_SIZE) : nullptr;
+        if (window) {
+            delta->window = window;
+            expectedSha = expectedSha256;
+            complete = installedDelta = download(deltaUrl, apiKey);
+        } else {
+            lastError = "delta: out of memory";
+        }
+        endDelta();
+
+        #if DEBUG_ENABLED
+        if (!complete) Serial.printf("OTA: delta failed (%s), full image\n", lastError.c_str());
+        #endif
+    }
+    #else
+    (void)deltaUrl;
+    #endif
+
+    if (!complete) {
+        expectedSha = expectedSha256;
+        complete = download(url, apiKey);
+    }
+    mbedtls_sha256_free(&sha);
+
+    if (watchdogArmed) {
+        WakeWatchdog::arm();
+    } else {
+        WakeWatchdog::suspend();
+    }
+
+    if (complete) {
+        // Remember what was installed where, to spot a rollback after the restart
+        const esp_partition_t* slot = esp_ota_get_next_update_partition(nullptr);
+        Preferences prefs;
+        if (slot && prefs.begin(OTA_PREFS_NAMESPACE, false)) {
+            prefs.putString("installed", imageKey(url, expectedSha256));
+            prefs.putUInt("slot", slot->address);
+            prefs.end();
+        }
+    }
+
+    #if DEBUG_ENABLED
+    Serial.printf("OTA: %s%s\n", complete ? "installed, restart to boot it" : "failed: ",
+                  complete ? "" : lastError.c_str());
+    #endif
+    return complete;
+}
+
+bool OtaUpdater::consumeDelta(const uint8_t* data, size_t length) {
+    if (delta->headerFill < DELTA_HEADER_SIZE) {
+        size_t n = DELTA_HEADER_SIZE - delta->headerFill;
+        if (n > length) n = length;
+        memcpy(delta->header + delta->headerFill, data, n);
+        delta->headerFill += n;
+        data += n;
+        length -= n;
+        if (delta->headerFill < DELTA_HEADER_SIZE) return true;
+        if (!beginDelta()) return false;
+    }
+
+    // Inflate into the circular window and hand each new run to the patcher;
+    // keep going while output is pending, even once the input is used up
+    tinfl_status status = TINFL_STATUS_HAS_MORE_OUTPUT;
+    while (!delta->inflated && (length > 0 || status == TINFL_STATUS_HAS_MORE_OUTPUT)) {
+        size_t inBytes = length;
+        size_t outBytes = TINFL_LZ_DICT_SIZE - delta->windowPos;
+        status = tinfl_decompress(&delta->inflater, data, &inBytes, delta->window,
+                                  delta->window + delta->windowPos, &outBytes,
+                                  TINFL_FLAG_PARSE_ZLIB_HEADER | TINFL_FLAG_HAS_MORE_INPUT);
+        data += inBytes;
+        length -= inBytes;
+
+        if (outBytes > 0 && !delta->patcher.feed(delta->window + delta->windowPos, outBytes)) {
+            if (!Update.hasError()) lastError = "delta: bad patch";
+            return false;
+        }
+        delta->windowPos = (delta->windowPos + outBytes) & (TINFL_LZ_DICT_SIZE - 1);
+
+        if (status < TINFL_STATUS_DONE) {
+            lastError = "delta: inflate error " + String((int)status);
+            return false;
+        }
+        if (status == TINFL_STATUS_DONE) delta->inflated = true;
+    }
+    return true;
+}
+
+bool OtaUpdater::beginDelta() {
+    DeltaHeader& info = delta->info;
+    if (!parseDeltaHeader(delta->header, DELTA_HEADER_SIZE, &info)) {
+        lastError = "delta: no patch header";
+        return false;
+    }
+
+    // The server's hash of the full image, when given, must be the patch target
+    String targetHex = toHex(info.targetSha256);
+    if (expectedSha.length() > 0 && !expectedSha.equalsIgnoreCase(targetHex)) {
+        lastError = "delta: different target";
+        return false;
+    }
+    expectedSha = targetHex;
+
+    // Only a patch against exactly the image we run is usable
+    delta->base = esp_ota_get_running_partition();
+    if (!delta->base || info.baseSize > delta->base->size) {
+        lastError = "delta: base size";
+        return false;
+    }
+    uint8_t digest[32];
+    mbedtls_sha256_starts_ret(&sha, 0);
+    for (uint32_t offset = 0; offset < info.baseSize; offset += TINFL_LZ_DICT_SIZE) {
+        uint32_t n = info.baseSize - offset;
+        if (n > TINFL_LZ_DICT_SIZE) n = TINFL_LZ_DICT_SIZE;
+        if (esp_partition_read(delta->base, offset, delta->window, n) != ESP_OK) {
+            lastError = "delta: base read";
+            return false;
+        }
+        mbedtls_sha256_update_ret(&sha, delta->window, n);
+    }
+    mbedtls_sha256_finish_ret(&sha, digest);
+    if (memcmp(digest, info.baseSha256, sizeof(digest)) != 0) {
+        lastError = "delta: not for the running image";
+        return false;
+    }
+
+    if (!Update.begin(info.targetSize)) {
+        lastError = String("begin: ") + Update.errorString();
+        return false;
+    }
+    mbedtls_sha256_starts_ret(&sha, 0);
+    delta->patcher.begin(info);
+
+    #if DEBUG_ENABLED
+    Serial.printf("OTA: delta %u bytes for a %u byte image\n",
+                  (unsigned)streamSize, (unsigned)info.targetSize);
+    #endif
+    return true;
+}
+
+void OtaUpdater::endDelta() {
+    if (!delta) return;
+    free(delta->window);
+    delete delta;
+    delta = nullptr;
+}
+
+bool OtaUpdater::readBase(void* context, uint32_t offset, uint8_t* data, size_t length) {
+    OtaUpdater* self = static_cast<OtaUpdater*>(context);
+    return esp_partition_read(self->delta->base, offset, data, length) == ESP_OK;
+}
+
+bool OtaUpdater::writeTarget(void* context, const uint8_t* data, size_t length) {
+    return static_cast<OtaUpdater*>(context)->writeImage(data, length);
+}
+
+String OtaUpdater::imageKey(const String& url, const String& expectedSha256) {
+    if (expectedSha256.length() > 0) {
+        String key = expectedSha256;
+        key.toLowerCase();
+        return key;
+    }
+    int query = url.indexOf('?');
+    return query >= 0 ? url.substring(0, query) : url;
+}
+
+bool OtaUpdater::isRejected(const String& key) {
+    Preferences prefs;
+    if (!prefs.begin(OTA_PREFS_NAMESPACE, true)) return false;
+    bool rejected = prefs.getString("rejected", "") == key &&
+                    prefs.getUInt("rejections", 0) >= OTA_MAX_INSTALL_ATTEMPTS;
+    prefs.end();
+    return rejected;
+}
+
+void OtaUpdater::beginHealthCheck() {
+    const esp_partition_t* running = esp_ota_get_running_partition();
+    esp_ota_img_states_t state;
+    s_healthCheckPending = running && esp_ota_get_state_partition(running, &state) == ESP_OK &&
+                           state == ESP_OTA_IMG_PENDING_VERIFY;
+    if (s_healthCheckPending) {
+        #if DEBUG_ENABLED
+        Serial.println("OTA: new image on probation until the first good refresh");
+        #endif
+        return;
+    }
+
+    if (!running) return;
+
+    // The bootloader also rolls back on a deep-sleep wake of an unconfirmed
+    // image, so this runs on every boot
+    Preferences prefs;
+    if (!prefs.begin(OTA_PREFS_NAMESPACE, false)) return;
+    String installed = prefs.getString("installed", "");
+    if (installed.length() > 0) {
+        if (prefs.getUInt("slot", 0) != running->address) {
+            // Installed but not running: the image was rolled back
+            uint32_t rejections = prefs.getString("rejected", "") == installed ? prefs.getUInt("rejections", 0) : 0;
+            prefs.putString("rejected", installed);
+            prefs.putUInt("rejections", rejections + 1);
+            #if DEBUG_ENABLED
+            Serial.printf("OTA: image %s was rolled back (%lu times)\n",
+                          installed.c_str(), (unsigned long)(rejections + 1));
+            #endif
+        }
+        prefs.remove("installed");
+        prefs.remove("slot");
+    }
+    prefs.end();
+}
+
+bool OtaUpdater::isHealthCheckPending() {
+    return s_healthCheckPending;
+}
+
+void OtaUpdater::confirmHealthy() {
+    if (!s_healthCheckPending) return;
+    s_healthCheckPending = false;
+    esp_ota_mark_app_valid_cancel_rollback();
+
+    Preferences prefs;
+    if (prefs.begin(OTA_PREFS_NAMESPACE, false)) {
+        prefs.remove("installed");
+        prefs.remove("slot");
+        prefs.end();
+    }
+
+    #if DEBUG_ENABLED
+    Serial.println("OTA: new image confirmed");
+    #endif
+}
+
+void OtaUpdater::failHealthCheck() {
+    if (!s_healthCheckPending) return;
+
+    #if DEBUG_ENABLED
+    Serial.println("OTA: no good refresh on the new image, rolling back");
+    Serial.flush();
+    #endif
+    esp_ota_mark_app_invalid_rollback_and_reboot();
+}
@@ -1,5 +1,10 @@
 #include "paperdink_hardware.h"
+#include "profiler.h"
+#include "energy_model.h"
+#include "wake_watchdog.h"
+#include "power_phases.h"
 #include <esp_sleep.h>
+#include <driver/gpio.h>
 #include <esp_wifi.h>
 #include <esp_bt.h>
 #include <WiFi.h>
@@ -26,6 +31,7 @@ struct PngDrawContext {
     float sX;
     float sY;
     bool invert;
+    uint8_t *frame;  // Render into this 1-bit buffer instead of the panel when set
 };
 
 // PNGdec draw callback: render each decoded line directly to the EPD with scaling (nearest neighbor)
@@ -79,79 +85,192 @@ static int pngDrawToEPD(PNGDRAW *pDraw) {
 
     for (int dy = yStart; dy <= yEnd; ++dy) {
         if (dy < 0 || dy >= DISPLAY_HEIGHT) continue;
-        epd.drawBitmap(0, dy, lineBits, DISPLAY_WIDTH, 1, GxEPD_BLACK);
+        if (ctx->frame) {
+            memcpy(ctx->frame + dy * sizeof(lineBits), lineBits, sizeof(lineBits));
+        } else {
+            epd.drawBitmap(0, dy, lineBits, DISPLAY_WIDTH, 1, GxEPD_BLACK);
+        }
     }
 
     return 1; // continue
 }
 
+// Read the PNG header and set up centered, aspect-preserving scaling
+static bool preparePngContext(const uint8_t *imageData, size_t imageSize, bool invert, PngDrawContext *ctx) {
+    int rc = s_png.openRAM((uint8_t*)imageData, (int)imageSize, pngDrawToEPD);
+    if (rc != PNG_SUCCESS) {
+        #if DEBUG_ENABLED
+        Serial.println("PNG openRAM failed");
+        #endif
+        return false;
+    }
+
+    // Read PNG size
+    int16_t pngW = s_png.getWidth();
+    int16_t pngH = s_png.getHeight();
+    #if DEBUG_ENABLED
+    Serial.printf("PNG size: %dx%d\n", pngW, pngH);
+    #endif
+
+    // Compute uniform scale to fit into DISPLAY (letterbox/pillarbox), keep aspect ratio
+    float s = 1.0f;
+    if (pngW > 0 && pngH > 0) {
+        float sx = (float)DISPLAY_WIDTH / (float)pngW;
+        float sy = (float)DISPLAY_HEIGHT / (float)pngH;
+        s = sx < sy ? sx : sy;
+        if (s <= 0.0f) s = 1.0f;
+    }
+    int tW = (int)floorf(pngW * s);
+    int tH = (int)floorf(pngH * s);
+    if (tW < 1) tW = 1;
+    if (tH < 1) tH = 1;
+
+    // Centered placement
+    ctx->tW = tW;
+    ctx->tH = tH;
+    ctx->sX = s;
+    ctx->sY = s;
+    ctx->x0 = (DISPLAY_WIDTH - tW) / 2;
+    ctx->y0 = (DISPLAY_HEIGHT - tH) / 2;
+    ctx->invert = invert;
+    ctx->frame = nullptr;
+
+    // Close after reading header; callers reopen to decode
+    s_png.close();
+    return true;
+}
+
+static bool isBmpImage(const uint8_t *imageData, size_t imageSize) {
+    return imageSize >= 2 && imageData[0] == 'B' && imageData[1] == 'M';
+}
+
+// Uncompressed 1-bit BMP (what TRMNL servers render) into a 1-bit frame,
+// top-left aligned and cropped to the panel
+static bool decodeBmpToFrame(const uint8_t *data, size_t size, bool invert, uint8_t *frame) {
+    auto u16 = [data](size_t o) { return (uint32_t)data[o] | ((uint32_t)data[o + 1] << 8); };
+    auto u32 = [data](size_t o) {
+        return (uint32_t)data[o] | ((uint32_t)data[o + 1] << 8) |
+               ((uint32_t)data[o + 2] << 16) | ((uint32_t)data[o + 3] << 24);
+    };
+    if (size < 62 || !isBmpImage(data, size)) return false;
+
+    uint32_t pixelOffset = u32(10);
+    uint32_t dibSize = u32(14);
+    int32_t width = (int32_t)u32(18);
+    int32_t height = (int32_t)u32(22);
+    if (dibSize < 40 || u16(28) != 1 || u32(30) != 0 || width <= 0 || height == 0) {
+        #if DEBUG_ENABLED
+        Serial.println("BMP: only uncompressed 1-bit images are supported");
+        #endif
+        return false;
+    }
+    bool topDown = height < 0;
+    if (topDown) height = -height;
+
+    uint32_t rowBytes = ((uint32_t)width + 31) / 32 * 4;
+    size_t palette = 14 + dibSize;
+    if (palette + 8 > size || pixelOffset + (uint64_t)rowBytes * height > size) return false;
+
+    // Index whose palette entry is darker is drawn black
+    uint32_t luma0 = data[palette] + data[palette + 1] + data[palette + 2];
+    uint32_t luma1 = data[palette + 4] + data[palette + 5] + data[palette + 6];
+    bool oneIsBlack = (luma1 < luma0) != invert;
+
+    memset(frame, 0x00, DISPLAY_FRAME_BYTES);
+    int rows = height < DISPLAY_HEIGHT ? height : DISPLAY_HEIGHT;
+    int cols = width < DISPLAY_WIDTH ? width : DISPLAY_WIDTH;
+    for (int y = 0; y < rows; y++) {
+        const uint8_t *src = data + pixelOffset + (size_t)rowBytes * (topDown ? y : height - 1 - y);
+        uint8_t *dst = frame + (size_t)y * (DISPLAY_WIDTH / 8);
+        for (int x = 0; x < cols; x++) {
+            bool bit = (src[x >> 3] >> (7 - (x & 7))) & 1;
+            if (bit == oneIsBlack) dst[x >> 3] |= 0x80 >> (x & 7);
+        }
+    }
+    return true;
+}
+
+// Draw a 1-bit frame (MSB first, set bit = black) over the whole panel
+static void drawFrameToEPD(const uint8_t *frame) {
+    epd.firstPage();
+    do {
+        epd.fillScreen(GxEPD_WHITE);
+        epd.drawBitmap(0, 0, frame, DISPLAY_WIDTH, DISPLAY_HEIGHT, GxEPD_BLACK);
+    } while (epd.nextPage());
+}
+
 // Simple command buffer to accumulate text draws until updateDisplay()
 struct TextCmd { String text; int x; int y; int size; };
-static TextCmd g_text_cmds[16];
+static TextCmd g_text_cmds[24];
 static int g_text_cmd_count = 0;
 
 PaperdInkHardware::PaperdInkHardware()
     : display(nullptr)
     , displayType(DISPLAY_BW)
-    , batteryVoltage(0.0)
+    , panelGeneration(0)
+    , displayPower(DISPLAY_POWER_OFF)
+    , displayInitialRefresh(true)
     , chargingStatus(false)
     , lowBattery(false)
-    , sdCardAvailable(false) {
-
-    // Initialize button states
-    for (int i = 0; i < 4; i++) {
-        buttonPressTime[i] = 0;
-        buttonStates[i] = BUTTON_RELEASED;
-        buttonPressed[i] = false;
-    }
-}
+    , timerWakeAt(0)
+    , sdCardAvailable(false)
+    , sdCardProbed(false)
+    , sdCardMounted(false)
+    , sdSessionDepth(0)
+    , preferencesOpen(false) {}
 
 PaperdInkHardware::~PaperdInkHardware() {
     end();
 }
 
-bool PaperdInkHardware::begin() {
+bool PaperdInkHardware::begin(const HardwareSnapshot* snapshot) {
+    PROFILE_SCOPE("hw.begin");
     #if DEBUG_ENABLED
     Serial.println("Initializing paperd.ink hardware...");
     #endif
 
     // Initialize pins
     initializePins();
+    buzzer.begin();
 
-    // Initialize preferences
-    if (!preferences.begin("paperdink", false)) {
-        #if DEBUG_ENABLED
-        Serial.println("Failed to initialize preferences");
-        #endif
-        return false;
+    if (snapshot) {
+        // Warm boot: settings survived deep sleep, NVS stays closed unless
+        // something changes and needs committing
+        restoreSnapshot(*snapshot);
+    } else {
+        // Cold boot: load persisted settings into RAM
+        if (!openPreferences()) {
+            #if DEBUG_ENABLED
+            Serial.println("Failed to initialize preferences");
+            #endif
+            return false;
+        }
+        settings.begin(&preferences);
     }
 
-    // Load persisted invert setting
-    invertDisplayFlag = loadBool("invert", false);
-
-    // Initialize display
-    if (!initializeDisplay()) {
+    // Initialize display; a warm boot keeps the image currently on the panel
+    if (!initializeDisplay(snapshot != nullptr)) {
         #if DEBUG_ENABLED
         Serial.println("Failed to initialize display");
         #endif
         return false;
     }
 
-
-    // Initialize SD card
-    initializeSDCard();
+    // SD card stays powered off until the first storage access
 
     // Initialize buttons
     initializeButtons();
 
     // Read initial battery voltage
-    batteryVoltage = readBatteryVoltage();
     chargingStatus = checkChargingStatus();
+    battery.setUnderLoad(WiFi.getMode() != WIFI_OFF);  // Fast wake starts WiFi first
+    battery.setCharging(chargingStatus);
+    battery.begin();
 
     #if DEBUG_ENABLED
     Serial.println("Hardware initialization complete");
-    Serial.printf("Battery: %.2fV (%d%%)\n", batteryVoltage, getBatteryPercentage());
-    Serial.printf("SD Card: %s\n", sdCardAvailable ? "Available" : "Not Available");
+    Serial.printf("Battery: %.2fV (%d%%)\n", battery.getVoltage(), getBatteryPercentage());
+    Serial.println("SD Card: deferred until first access");
     #endif
 
     return true;
@@ -162,8 +281,22 @@ void PaperdInkHardware::end() {
     #if DEBUG_ENABLED
     Serial.println("Hardware shutdown");
     #endif
-    preferences.end();
-    SD.end();
+    if (preferencesOpen) {
+        preferences.end();
+        preferencesOpen = false;
+    }
+    sdSessionDepth = 0;
+    unmountSDCard();
+}
+
+void PaperdInkHardware::restoreSnapshot(const HardwareSnapshot& snapshot) {
+    settings.restore(&preferences, snapshot.settings);
+    timerWakeAt = snapshot.timerWakeAt;
+}
+
+void PaperdInkHardware::captureSnapshot(HardwareSnapshot& snapshot) const {
+    snapshot.settings = settings.getAll();
+    snapshot.timerWakeAt = timerWakeAt;
 }
 
 void PaperdInkHardware::initializePins() {
@@ -172,9 +305,9 @@ void PaperdInkHardware::initializePins() {
     pinMode(SD_ENABLE_PIN, OUTPUT);
     pinMode(BATTERY_ENABLE_PIN, OUTPUT);
 
-    // Enable peripherals initially
-    digitalWrite(EPD_ENABLE_PIN, LOW);   // Active low
-    digitalWrite(SD_ENABLE_PIN, LOW);    // Active low
+    // Display and SD card power are switched on when first needed
+    digitalWrite(EPD_ENABLE_PIN, HIGH);  // Active low (off)
+    digitalWrite(SD_ENABLE_PIN, HIGH);   // Active low (off)
     digitalWrite(BATTERY_ENABLE_PIN, HIGH);
 
 
@@ -199,67 +332,117 @@ void PaperdInkHardware::initializePins() {
     SPI.begin(SCK_PIN, MISO_PIN, MOSI_PIN);
 }
 
-bool PaperdInkHardware::initializeDisplay() {
-    // Power on display
-    digitalWrite(EPD_ENABLE_PIN, LOW);  // Active low
-    delay(100);
-
+bool PaperdInkHardware::initializeDisplay(bool keepContent) {
     // Initialize display based on type
     displayType = DISPLAY_BW;   // Default to monochrome
 
-    // Bring up the panel
-    epd.init(0); // use default SPI frequency
+    // GFX state only; the panel itself stays off until the first refresh
     epd.setRotation(DISPLAY_ROTATION);
     epd.setTextColor(GxEPD_BLACK);
-    epd.setFullWindow();
-    epd.firstPage();
-    do { epd.fillScreen(GxEPD_WHITE); } while (epd.nextPage());
+    displayPower = DISPLAY_POWER_OFF;
+
+    // On a warm boot the panel still shows the last image: init with
+    // initial=false so nothing is cleared. A cold boot starts from white.
+    displayInitialRefresh = !keepContent;
+    if (!keepContent) {
+        clearDisplay();
+    }
 
     #if DEBUG_ENABLED
-    Serial.println("Display initialization completed (GxEPD2 4.2\" B/W)");
+    Serial.printf("Display initialization completed (GxEPD2 4.2\" B/W, %s)\n",
+                  keepContent ? "lazy" : "cleared");
     #endif
 
     return true;
 }
 
-void PaperdInkHardware::initializeSDCard() {
+// Display power state machine. Every refresh runs wakeDisplay() ... sleepDisplay(),
+// so between refreshes the controller is hibernated and its rail is off.
+void PaperdInkHardware::wakeDisplay() {
+    if (displayPower == DISPLAY_POWER_READY) return;
+
+    if (displayPower == DISPLAY_POWER_OFF) {
+        digitalWrite(EPD_ENABLE_PIN, LOW);  // Active low
+        delay(EPD_POWER_SETTLE_MS);
+    }
+    // Both the rail cut and hibernation lose the controller setup; init
+    // resets it. initial=false keeps GxEPD2 from treating the retained
+    // image as unknown.
+    epd.init(0, displayInitialRefresh);
+    epd.setFullWindow();
+    displayInitialRefresh = false;
+    displayPower = DISPLAY_POWER_READY;
+}
+
+void PaperdInkHardware::sleepDisplay() {
+    if (displayPower == DISPLAY_POWER_READY) {
+        epd.hibernate();  // Controller deep sleep; required before cutting the rail
+        displayPower = DISPLAY_POWER_HIBERNATED;
+    }
+    if (displayPower == DISPLAY_POWER_HIBERNATED) {
+        digitalWrite(EPD_ENABLE_PIN, HIGH);  // Active low (off)
+        displayPower = DISPLAY_POWER_OFF;
+    }
+}
+
+bool PaperdInkHardware::mountSDCard() {
+    if (sdCardMounted) return true;
+
+    // Once a probe found no card, don't pay the power-up cost again this wake
+    if (sdCardProbed && !sdCardAvailable) return false;
+
     // Enable SD card power
     digitalWrite(SD_ENABLE_PIN, LOW);  // Active low
-    delay(100);
 
+    // Poll until the card answers instead of waiting a fixed settle time
+    unsigned long startTime = millis();
+    bool mounted = SD.begin(SD_CS_PIN);
+    while (!mounted && millis() - startTime < SD_POWER_UP_TIMEOUT_MS) {
+        delay(SD_POLL_INTERVAL_MS);
+        mounted = SD.begin(SD_CS_PIN);
+    }
 
-    // Initialize SD card
-    if (SD.begin(SD_CS_PIN)) {
-        sdCardAvailable = true;
-        #if DEBUG_ENABLED
-        Serial.println("SD card initialized successfully");
-        Serial.printf("SD card size: %lluMB\n", SD.cardSize() / (1024 * 1024));
-        #endif
-    } else {
-        sdCardAvailable = false;
+    sdCardProbed = true;
+    sdCardAvailable = mounted;
+    sdCardMounted = mounted;
+
+    if (!mounted) {
+        digitalWrite(SD_ENABLE_PIN, HIGH);  // Disable SD card power
         #if DEBUG_ENABLED
         Serial.println("SD card initialization failed");
         #endif
+        return false;
     }
+
+    #if DEBUG_ENABLED
+    Serial.printf("SD card mounted after %lums\n", millis() - startTime);
+    Serial.printf("SD card size: %lluMB\n", SD.cardSize() / (1024 * 1024));
+    #endif
+    return true;
+}
+
+void PaperdInkHardware::unmountSDCard() {
+    if (sdCardMounted) {
+        SD.end();
+        sdCardMounted = false;
+    }
+    digitalWrite(SD_ENABLE_PIN, HIGH);  // Disable SD card power
 }
 
 // Display options setters/getters (out-of-line)
 void PaperdInkHardware::setInvertDisplay(bool invert) {
-    invertDisplayFlag = invert;
-    saveBool("invert", invert);
+    settings.setInvertDisplay(invert);
 }
 
 bool PaperdInkHardware::getInvertDisplay() const {
-    return invertDisplayFlag;
+    return settings.getInvertDisplay();
 }
 
 void PaperdInkHardware::initializeButtons() {
-    // Buttons are already configured as INPUT_PULLUP in initializePins()
-    // Initialize button states
-    for (int i = 0; i < 4; i++) {
-        buttonPressTime[i] = 0;
-        buttonStates[i] = BUTTON_RELEASED;
-        buttonPressed[i] = false;
+    // Buttons are already configured as INPUT_PULLUP in initializePins().
+    // Interrupt-driven input; fall back to the GPIO pins without the expander
+    if (!buttons.begin((ButtonInputMode)BUTTON_INPUT_MODE)) {
+        buttons.begin(BUTTON_INPUT_GPIO);
     }
 
     #if DEBUG_ENABLED
@@ -267,57 +450,6 @@ void PaperdInkHardware::initializeButtons() {
     #endif
 }
 
-void PaperdInkHardware::updateButtons() {
-    int buttonPins[4] = {BUTTON_1_PIN, BUTTON_2_PIN, BUTTON_3_PIN, BUTTON_4_PIN};
-    unsigned long currentTime = millis();
-
-    for (int i = 0; i < 4; i++) {
-        bool currentPressed = !digitalRead(buttonPins[i]);  // Active low with pullup
-
-        if (currentPressed && !buttonPressed[i]) {
-            // Button just pressed
-            buttonPressed[i] = true;
-            buttonPressTime[i] = currentTime;
-            buttonStates[i] = BUTTON_PRESSED;
-        } else if (!currentPressed && buttonPressed[i]) {
-            // Button just released
-            buttonPressed[i] = false;
-            buttonStates[i] = BUTTON_RELEASED;
-        } else if (currentPressed && buttonPressed[i]) {
-            // Button held down - check for long press
-            unsigned long pressedDuration = currentTime - buttonPressTime[i];
-
-            if (pressedDuration > BUTTON_VERY_LONG_PRESS_MS) {
-                buttonStates[i] = BUTTON_VERY_LONG_PRESS;
-            } else if (pressedDuration > BUTTON_LONG_PRESS_MS) {
-                buttonStates[i] = BUTTON_LONG_PRESS;
-            }
-        }
-    }
-}
-
-float PaperdInkHardware::readBatteryVoltage() {
-    // Enable battery voltage reading
-    digitalWrite(BATTERY_ENABLE_PIN, HIGH);
-    delay(10);
-
-    // Read ADC value
-    int adcValue = analogRead(BATTERY_VOLTAGE_PIN);
-
-    // Disable battery voltage reading to save power
-    digitalWrite(BATTERY_ENABLE_PIN, LOW);
-
-    // Convert ADC to voltage (ESP32 ADC with voltage divider)
-    // Assuming 2:1 voltage divider and 3.3V reference
-    float voltage = (adcValue / 4095.0) * 3.3 * 2.0;
-
-    #ifdef BATTERY_CALIBRATION_OFFSET
-    voltage += BATTERY_CALIBRATION_OFFSET;
-    #endif
-
-    return voltage;
-}
-
 bool PaperdInkHardware::checkChargingStatus() {
     // Read charging indicator pin
     return digitalRead(CHARGING_INDICATOR_PIN) == LOW;  // Active low
@@ -325,11 +457,21 @@ bool PaperdInkHardware::checkChargingStatus() {
 
 // Display methods (stub implementations)
 void PaperdInkHardware::clearDisplay() {
+    PROFILE_SCOPE("panel");
+    panelGeneration++;
+    EnergyModel::beginPhase(ENERGY_PANEL);
+    wakeDisplay();
     epd.firstPage();
     do { epd.fillScreen(GxEPD_WHITE); } while (epd.nextPage());
+    sleepDisplay();
+    EnergyModel::endPhase(ENERGY_PANEL);
 }
 
 void PaperdInkHardware::updateDisplay() {
+    PROFILE_SCOPE("panel");  // Text render plus refresh
+    panelGeneration++;
+    EnergyModel::beginPhase(ENERGY_PANEL);
+    wakeDisplay();
     epd.firstPage();
     do {
         epd.fillScreen(GxEPD_WHITE);
@@ -339,6 +481,8 @@ void PaperdInkHardware::updateDisplay() {
             epd.print(g_text_cmds[i].text);
         }
     } while (epd.nextPage());
+    sleepDisplay();
+    EnergyModel::endPhase(ENERGY_PANEL);
     g_text_cmd_count = 0; // clear buffer
 }
 
@@ -355,31 +499,45 @@ void PaperdInkHardware::displayText(const char* text, int x, int y, int size) {
 
 void PaperdInkHardware::displayImage(const uint8_t* imageData, size_t imageSize) {
     if (!imageData || imageSize == 0) return;
+    PROFILE_SCOPE("display");  // Decode plus panel refresh
+    panelGeneration++;
+    EnergyModel::beginPhase(ENERGY_PANEL);
 
     #if DEBUG_ENABLED
     Serial.printf("Displaying image of size: %d bytes\n", imageSize);
     #endif
 
     // Try to detect a simple 1-bit raw buffer (exact display size)
-    const size_t raw1bppSize = (DISPLAY_WIDTH * DISPLAY_HEIGHT) / 8;
-    if (imageSize == raw1bppSize) {
-        // Draw raw 1-bit bitmap
-        epd.setFullWindow();
-        epd.firstPage();
-        do {
-            epd.fillScreen(GxEPD_WHITE);
-            // GxEPD2 expects 1-bit bitmap MSB first; assume incoming buffer is MSB-first
-            epd.drawBitmap(0, 0, imageData, DISPLAY_WIDTH, DISPLAY_HEIGHT, GxEPD_BLACK);
-        } while (epd.nextPage());
+    if (imageSize == DISPLAY_FRAME_BYTES) {
+        // GxEPD2 expects 1-bit bitmap MSB first; assume incoming buffer is MSB-first
+        wakeDisplay();
+        drawFrameToEPD(imageData);
+        sleepDisplay();
+        EnergyModel::endPhase(ENERGY_PANEL);
+        return;
+    }
+
+    // 1-bit BMP: convert to a raw frame, then draw that
+    if (isBmpImage(imageData, imageSize)) {
+        uint8_t* frame = (uint8_t*)malloc(DISPLAY_FRAME_BYTES);
+        if (!frame || !decodeBmpToFrame(imageData, imageSize, settings.getInvertDisplay(), frame)) {
+            free(frame);
+            clearDisplay();
+            displayText("BMP decode failed", 10, 60, 1);
+            updateDisplay();
+            return;
+        }
+        wakeDisplay();
+        drawFrameToEPD(frame);
+        sleepDisplay();
+        free(frame);
+        EnergyModel::endPhase(ENERGY_PANEL);
         return;
     }
 
     // Otherwise assume PNG (1-bit or grayscale) and decode with PNGdec
-    int rc = s_png.openRAM((uint8_t*)imageData, (int)imageSize, pngDrawToEPD);
-    if (rc != PNG_SUCCESS) {
-        #if DEBUG_ENABLED
-        Serial.println("PNG openRAM failed");
-        #endif
+    PngDrawContext ctx;
+    if (!preparePngContext(imageData, imageSize, settings.getInvertDisplay(), &ctx)) {
         // fallback: clear
         clearDisplay();
         displayText("PNG decode failed", 10, 60, 1);
@@ -387,48 +545,15 @@ void PaperdInkHardware::displayImage(const uint8_t* imageData, size_t imageSize)
         return;
     }
 
-    // Read PNG size
-    int16_t pngW = s_png.getWidth();
-    int16_t pngH = s_png.getHeight();
-    #if DEBUG_ENABLED
-    Serial.printf("PNG size: %dx%d\n", pngW, pngH);
-    #endif
-
-    // Compute uniform scale to fit into DISPLAY (letterbox/pillarbox), keep aspect ratio
-    float s = 1.0f;
-    if (pngW > 0 && pngH > 0) {
-        float sx = (float)DISPLAY_WIDTH / (float)pngW;
-        float sy = (float)DISPLAY_HEIGHT / (float)pngH;
-        s = sx < sy ? sx : sy;
-        if (s <= 0.0f) s = 1.0f;
-    }
-    int tW = (int)floorf(pngW * s);
-    int tH = (int)floorf(pngH * s);
-    if (tW < 1) tW = 1;
-    if (tH < 1) tH = 1;
-
-    // Centered placement
-    PngDrawContext ctx;
-    ctx.tW = tW;
-    ctx.tH = tH;
-    ctx.sX = s;
-    ctx.sY = s;
-    ctx.x0 = (DISPLAY_WIDTH - tW) / 2;
-    ctx.y0 = (DISPLAY_HEIGHT - tH) / 2;
-    ctx.invert = invertDisplayFlag;
-
-    // Close after reading header; reopen per page (required for GxEPD2 paging)
-    s_png.close();
-
-    // Refresh invert per page in case it changed
-    ctx.invert = invertDisplayFlag;
-
-    epd.setFullWindow();
+    // Reopen per page (required for GxEPD2 paging)
+    wakeDisplay();
     epd.firstPage();
     do {
         epd.fillScreen(GxEPD_WHITE);
+        PROFILE_BEGIN("decode");
         int orc = s_png.openRAM((uint8_t*)imageData, (int)imageSize, pngDrawToEPD);
         if (orc != PNG_SUCCESS) {
+            PROFILE_END("decode");
             #if DEBUG_ENABLED
             Serial.println("PNG openRAM failed on page");
             #endif
@@ -436,6 +561,7 @@ void PaperdInkHardware::displayImage(const uint8_t* imageData, size_t imageSize)
         }
         int dec = s_png.decode(&ctx, 0);
         s_png.close();
+        PROFILE_END("decode");
         if (dec != PNG_SUCCESS) {
             #if DEBUG_ENABLED
             Serial.printf("PNG decode error: %d\n", dec);
@@ -443,65 +569,77 @@ void PaperdInkHardware::displayImage(const uint8_t* imageData, size_t imageSize)
             break;
         }
     } while (epd.nextPage());
+    sleepDisplay();
+    EnergyModel::endPhase(ENERGY_PANEL);
 }
 
-// Button methods
-ButtonState PaperdInkHardware::getButtonState(int buttonNum) {
-    if (buttonNum < 0 || buttonNum >= 4) return BUTTON_RELEASED;
-    return buttonStates[buttonNum];
+bool PaperdInkHardware::renderImageToFrame(const uint8_t* imageData, size_t imageSize, uint8_t* frame) {
+    if (!imageData || imageSize == 0 || !frame) return false;
+
+    // Already a raw frame: nothing to decode
+    if (imageSize == DISPLAY_FRAME_BYTES) {
+        memcpy(frame, imageData, DISPLAY_FRAME_BYTES);
+        return true;
+    }
+    if (isBmpImage(imageData, imageSize)) {
+        return decodeBmpToFrame(imageData, imageSize, settings.getInvertDisplay(), frame);
+    }
+
+    // Decode once into RAM; bits match what displayImage() draws, so the
+    // frame can later be shown through the raw path without PNG decoding
+    PngDrawContext ctx;
+    if (!preparePngContext(imageData, imageSize, settings.getInvertDisplay(), &ctx)) {
+        return false;
+    }
+    ctx.frame = frame;
+    memset(frame, 0x00, DISPLAY_FRAME_BYTES);
+
+    if (s_png.openRAM((uint8_t*)imageData, (int)imageSize, pngDrawToEPD) != PNG_SUCCESS) {
+        return false;
+    }
+    int dec = s_png.decode(&ctx, 0);
+    s_png.close();
+    return dec == PNG_SUCCESS;
 }
 
-bool PaperdInkHardware::isButtonPressed(int buttonNum) {
-    if (buttonNum < 0 || buttonNum >= 4) return false;
-    return buttonStates[buttonNum] == BUTTON_PRESSED;
+// Button methods
+bool PaperdInkHardware::readButtonEvent(ButtonEvent* event) {
+    if (!buttons.readEvent(event)) return false;
+    WakeWatchdog::extend();  // Someone is using the device
+    return true;
 }
 
-bool PaperdInkHardware::isButtonLongPressed(int buttonNum) {
-    if (buttonNum < 0 || buttonNum >= 4) return false;
-    return buttonStates[buttonNum] == BUTTON_LONG_PRESS;
+void PaperdInkHardware::discardButtonEvents() {
+    buttons.discardEvents();
 }
 
-bool PaperdInkHardware::isButtonVeryLongPressed(int buttonNum) {
+bool PaperdInkHardware::isButtonHeld(int buttonNum) {
     if (buttonNum < 0 || buttonNum >= 4) return false;
-    return buttonStates[buttonNum] == BUTTON_VERY_LONG_PRESS;
+    return buttons.isDown(buttonNum);
 }
 
-void PaperdInkHardware::resetButtonState(int buttonNum) {
-    if (buttonNum < 0 || buttonNum >= 4) return;
-    buttonStates[buttonNum] = BUTTON_RELEASED;
-    buttonPressed[buttonNum] = false;
-    buttonPressTime[buttonNum] = 0;
+// Power management
+void PaperdInkHardware::updateBattery() {
+    // Readings taken while the radio is up are sag-compensated
+    battery.setUnderLoad(WiFi.getMode() != WIFI_OFF);
+    battery.setCharging(checkChargingStatus());
+    battery.update();
 }
 
-// Power management
 float PaperdInkHardware::getBatteryVoltage() {
-    batteryVoltage = readBatteryVoltage();
-    return batteryVoltage;
+    return battery.getVoltage();
 }
 
 int PaperdInkHardware::getBatteryPercentage() {
-    float voltage = getBatteryVoltage();
-
-    // LiPo voltage curve approximation
-    if (voltage >= 4.1) return 100;
-    if (voltage >= 4.0) return 90;
-    if (voltage >= 3.9) return 80;
-    if (voltage >= 3.8) return 70;
-    if (voltage >= 3.7) return 60;
-    if (voltage >= 3.6) return 50;
-    if (voltage >= 3.5) return 40;
-    if (voltage >= 3.4) return 30;
-    if (voltage >= 3.3) return 20;
-    if (voltage >= 3.2) return 10;
-    return 0;
+    return battery.getPercent();
 }
 
 bool PaperdInkHardware::isLowBattery() {
-    return getBatteryVoltage() < LOW_BATTERY_THRESHOLD;
+    return battery.isLow();
 }
 
 bool PaperdInkHardware::isCriticalBattery() {
-    return getBatteryVoltage() < CRITICAL_BATTERY_THRESHOLD;
+    return battery.isCritical();
 }
 
 bool PaperdInkHardware::isCharging() {
@@ -516,78 +654,146 @@ void PaperdInkHardware::enterDeepSleep(uint32_t sleepTimeSeconds) {
 
     // Configure wakeup sources
     esp_sleep_enable_timer_wakeup(sleepTimeSeconds * 1000000ULL);  // Convert to microseconds
+    timerWakeAt = (int64_t)time(nullptr) + sleepTimeSeconds;  // RTC keeps system time
+
+    // Button wakeup; an expander still holding INT low would wake us at once
+    buttons.releaseWakeLine();
+    buttons.enableDeepSleepWakeup();
+
+    // Persist any settings changed during this wake in one NVS write
+    commitSettings();
 
-    // Configure button wakeup on Button 1 (active-low) using EXT0 for reliable single-pin wake
-    // Note: Button pins use INPUT_PULLUP, so a press pulls low (level 0)
-    esp_sleep_enable_ext0_wakeup((gpio_num_t)BUTTON_1_PIN, 0);
+    // LEDC stops with the CPU; let a sound still playing finish first
+    buzzer.finish();
 
     // Power down peripherals
     disablePeripherals();
 
+    // Reading at rest right after the radio went down; pairs with this
+    // wake's loaded readings to learn the TX sag
+    battery.setUnderLoad(false);
+    battery.sampleNow();
+
+    EnergyModel::closeCycle(sleepTimeSeconds);
+    Profiler::endCycle();
+    #if DEBUG_ENABLED
+    Profiler::dump();
+    Serial.flush();
+    #endif
+
     // Enter deep sleep
     esp_deep_sleep_start();
 }
 
+void PaperdInkHardware::forceDeepSleep(uint32_t sleepTimeSeconds) {
+    // The main task may be stuck holding SPI, the card or the radio; only
+    // pins and sleep registers from here. The snapshot would describe a wake
+    // that never finished, so the next one starts from NVS
+    digitalWrite(EPD_ENABLE_PIN, HIGH);  // Active low (off)
+    digitalWrite(SD_ENABLE_PIN, HIGH);
+    WakeSnapshot::invalidate();
+
+    esp_sleep_enable_timer_wakeup(sleepTimeSeconds * 1000000ULL);
+    buttons.enableDeepSleepWakeup();  // Same buttons as a normal sleep
+    esp_deep_sleep_start();
+}
+
+uint32_t PaperdInkHardware::getSecondsUntilTimerWake() const {
+    int64_t now = time(nullptr);
+    if (timerWakeAt == 0 || now >= timerWakeAt) return 0;
+    return (uint32_t)(timerWakeAt - now);
+}
+
 void PaperdInkHardware::disablePeripherals() {
-    // Power down display (stub)
-    digitalWrite(EPD_ENABLE_PIN, HIGH);  // Disable display power
+    // Hibernate the controller (if a refresh left it up) and cut its rail
+    sleepDisplay();
 
-    // Power down SD card
-    SD.end();
-    digitalWrite(SD_ENABLE_PIN, HIGH);  // Disable SD card power
+    // Power down SD card, even if a storage session was left open
+    sdSessionDepth = 0;
+    unmountSDCard();
 
     // Disable WiFi and Bluetooth
     WiFi.disconnect(true);
     WiFi.mode(WIFI_OFF);
     esp_wifi_deinit();
     esp_bt_controller_disable();
+    EnergyModel::endPhase(ENERGY_RADIO);
 }
 
 void PaperdInkHardware::enablePeripherals() {
-    // Enable display power
-    digitalWrite(EPD_ENABLE_PIN, LOW);  // Active low
-    delay(100);
+    // Display power is switched on by the next refresh (wakeDisplay()) and
+    // SD card power by acquireSDCard() on first access
+}
 
-    // Enable SD card power
-    digitalWrite(SD_ENABLE_PIN, LOW);  // Active low
-    delay(100);
+// SD Card methods
+bool PaperdInkHardware::acquireSDCard() {
+    if (!mountSDCard()) return false;
+    sdSessionDepth++;
+    return true;
+}
 
-    // Reinitialize SD card if it was available before
-    if (sdCardAvailable) {
-        SD.begin(SD_CS_PIN);
+void PaperdInkHardware::releaseSDCard() {
+    if (sdSessionDepth == 0) return;
+    if (--sdSessionDepth == 0) {
+        unmountSDCard();
     }
 }
 
-// SD Card methods
 bool PaperdInkHardware::isSDCardAvailable() {
+    // Probe once per wake; the result is remembered after that
+    if (!sdCardProbed && acquireSDCard()) {
+        releaseSDCard();
+    }
     return sdCardAvailable;
 }
 
 bool PaperdInkHardware::writeFile(const char* path, const uint8_t* data, size_t size) {
-    if (!sdCardAvailable) return false;
+    if (!acquireSDCard()) return false;
 
     File file = SD.open(path, FILE_WRITE);
     if (!file) {
         #if DEBUG_ENABLED
         Serial.printf("Failed to open file for writing: %s\n", path);
         #endif
+        releaseSDCard();
         return false;
     }
 
     size_t written = file.write(data, size);
     file.close();
+    releaseSDCard();
+
+    return written == size;
+}
+
+bool PaperdInkHardware::appendFile(const char* path, const uint8_t* data, size_t size) {
+    if (!acquireSDCard()) return false;
+
+    File file = SD.open(path, FILE_APPEND);
+    if (!file) {
+        #if DEBUG_ENABLED
+        Serial.printf("Failed to open file for appending: %s\n", path);
+        #endif
+        releaseSDCard();
+        return false;
+    }
+
+    size_t written = file.write(data, size);
+    file.close();
+    releaseSDCard();
 
     return written == size;
 }
 
 bool PaperdInkHardware::readFile(const char* path, uint8_t* buffer, size_t maxSize, size_t* actualSize) {
-    if (!sdCardAvailable) return false;
+    if (!acquireSDCard()) return false;
 
     File file = SD.open(path, FILE_READ);
     if (!file) {
         #if DEBUG_ENABLED
         Serial.printf("Failed to open file for reading: %s\n", path);
         #endif
+        releaseSDCard();
         return false;
     }
 
@@ -596,6 +802,7 @@ bool PaperdInkHardware::readFile(const char* path, uint8_t* buffer, size_t maxSi
 
     size_t bytesRead = file.read(buffer, readSize);
     file.close();
+    releaseSDCard();
 
     if (actualSize) {
         *actualSize = bytesRead;
@@ -605,104 +812,195 @@ bool PaperdInkHardware::readFile(const char* path, uint8_t* buffer, size_t maxSi
 }
 
 bool PaperdInkHardware::fileExists(const char* path) {
-    if (!sdCardAvailable) return false;
-    return SD.exists(path);
+    if (!acquireSDCard()) return false;
+    bool exists = SD.exists(path);
+    releaseSDCard();
+    return exists;
 }
 
 size_t PaperdInkHardware::getFileSize(const char* path) {
-    if (!sdCardAvailable) return 0;
+    if (!acquireSDCard()) return 0;
 
     File file = SD.open(path, FILE_READ);
-    if (!file) return 0;
+    if (!file) {
+        releaseSDCard();
+        return 0;
+    }
 
     size_t size = file.size();
     file.close();
+    releaseSDCard();
     return size;
 }
 
-bool PaperdInkHardware::deleteFile(const char* path) {
-    if (!sdCardAvailable) return false;
-    return SD.remove(path);
+bool PaperdInkHardware::createDirectory(const char* path) {
+    if (!acquireSDCard()) return false;
+    bool ok = SD.exists(path) || SD.mkdir(path);
+    releaseSDCard();
+    return ok;
 }
 
-bool PaperdInkHardware::formatSDCard() {
-    if (!sdCardAvailable) return false;
+bool PaperdInkHardware::deleteFile(const char* path) {
+    if (!acquireSDCard()) return false;
+    bool removed = SD.remove(path);
+    releaseSDCard();
+    return removed;
+}
 
-    // Recursively delete all files and directories on the SD card
-    std::function<bool(const char*)> rmrf = [&](const char* path) -> bool {
-        File entry = SD.open(path);
-        if (!entry) return false;
-        if (!entry.isDirectory()) {
-            entry.close();
-            return SD.remove(path);
+bool PaperdInkHardware::wipeDirectory(const char* path, bool removeRoot,
+                                      StorageProgressCallback progress, void* context) {
+    if (strlen(path) >= SD_WIPE_PATH_MAX) return false;
+    if (!acquireSDCard()) return false;
+
+    // Iterative post-order walk with a fixed-size path stack. Each pass over a
+    // directory deletes every file in it with a single listing (no per-file
+    // handles) and remembers one subdirectory to descend into. A parent is
+    // listed again once that subdirectory is gone.
+    static char stack[SD_WIPE_MAX_DEPTH][SD_WIPE_PATH_MAX];
+    int top = 0;
+    strcpy(stack[0], path);
+
+    uint32_t removed = 0;
+    bool ok = true;
+
+    while (top >= 0) {
+        const char* dirPath = stack[top];
+        File dir = SD.open(dirPath);
+        if (!dir) {
+            // Nothing there (e.g. cache never created)
+            top--;
+            continue;
         }
-        // Directory
-        File child;
-        bool ok = true;
-        while ((child = entry.openNextFile())) {
-            String childPath = String(path);
-            if (!child.isDirectory()) {
-                ok = ok && SD.remove((childPath + "/" + child.name()).c_str());
-            } else {
-                String subdir = childPath + "/" + child.name();
-                child.close();
-                ok = ok && rmrf(subdir.c_str());
+        if (!dir.isDirectory()) {
+            dir.close();
+            ok = SD.remove(dirPath) && ok;
+            removed++;
+            top--;
+            continue;
+        }
+
+        bool descend = false;
+        bool isDir = false;
+        String child;
+        while ((child = dir.getNextFileName(&isDir)).length() > 0) {
+            if (isDir) {
+                if (!descend && top + 1 < SD_WIPE_MAX_DEPTH && child.length() < SD_WIPE_PATH_MAX) {
+                    strcpy(stack[top + 1], child.c_str());
+                    descend = true;
+                }
+                continue;
+            }
+            ok = SD.remove(child.c_str()) && ok;
+            removed++;
+            if (progress && removed % SD_WIPE_PROGRESS_INTERVAL == 0) {
+                progress(removed, context);
             }
         }
-        entry.close();
-        // Remove the directory itself if not root
-        if (String(path) != "/") {
-            ok = ok && SD.rmdir(path);
+        dir.close();
+
+        if (descend) {
+            top++;
+            continue;
         }
-        return ok;
-    };
 
-    bool result = rmrf("/");
+        // No subdirectories left: remove the directory itself
+        if (top > 0 || (removeRoot && strcmp(dirPath, "/") != 0)) {
+            if (!SD.rmdir(dirPath)) {
+                // Still holds entries we could not delete (or nested too deep);
+                // stop instead of listing the parent again forever
+                #if DEBUG_ENABLED
+                Serial.printf("SD wipe: cannot remove %s\n", dirPath);
+                #endif
+                ok = false;
+                break;
+            }
+            removed++;
+        }
+        top--;
+    }
+
+    releaseSDCard();
+    if (progress) progress(removed, context);
+
     #if DEBUG_ENABLED
-    Serial.printf("SD format (rm -rf) result: %s\n", result ? "OK" : "FAIL");
+    Serial.printf("SD wipe of %s: %u entries removed, result %s\n", path, (unsigned)removed, ok ? "OK" : "FAIL");
     #endif
-    return result;
+    return ok;
+}
+
+bool PaperdInkHardware::wipeCache(StorageProgressCallback progress, void* context) {
+    return wipeDirectory(CACHE_DIR, true, progress, context);
+}
+
+bool PaperdInkHardware::formatSDCard(StorageProgressCallback progress, void* context) {
+    // Delete all files and directories on the SD card
+    return wipeDirectory("/", false, progress, context);
 }
 
 
 // Buzzer methods
 void PaperdInkHardware::beep(int frequency, int duration) {
-    tone(BUZZER_PIN, frequency, duration);
-    delay(duration);
-    noTone(BUZZER_PIN);
+    buzzer.tone(frequency, duration);
 }
 
 void PaperdInkHardware::playTone(int frequency, int duration) {
-    tone(BUZZER_PIN, frequency, duration);
+    buzzer.tone(frequency, duration);
+}
+
+void PaperdInkHardware::playPattern(BuzzerPattern pattern) {
+    buzzer.play(pattern);
 }
 
 // Preferences methods
 bool PaperdInkHardware::saveString(const char* key, const char* value) {
+    if (!openPreferences()) return false;
     return preferences.putString(key, value) > 0;
 }
 
 String PaperdInkHardware::loadString(const char* key, const char* defaultValue) {
+    if (!openPreferences()) return String(defaultValue);
     return preferences.getString(key, defaultValue);
 }
 
 bool PaperdInkHardware::saveInt(const char* key, int value) {
+    if (!openPreferences()) return false;
     return preferences.putInt(key, value) > 0;
 }
 
 int PaperdInkHardware::loadInt(const char* key, int defaultValue) {
+    if (!openPreferences()) return defaultValue;
     return preferences.getInt(key, defaultValue);
 }
 
 bool PaperdInkHardware::saveBool(const char* key, bool value) {
+    if (!openPreferences()) return false;
     return preferences.putBool(key, value) > 0;
 }
 
 bool PaperdInkHardware::loadBool(const char* key, bool defaultValue) {
+    if (!openPreferences()) return defaultValue;
     return preferences.getBool(key, defaultValue);
 }
 
+bool PaperdInkHardware::openPreferences() {
+    if (!preferencesOpen) {
+        preferencesOpen = preferences.begin("paperdink", false);
+    }
+    return preferencesOpen;
+}
+
 void PaperdInkHardware::clearPreferences() {
-    preferences.clear();
+    if (openPreferences()) {
+        preferences.clear();
+    }
+    settings.reset();
+    WakeSnapshot::invalidate();
+}
+
+bool PaperdInkHardware::commitSettings() {
+    if (!settings.isDirty()) return true;
+    if (!openPreferences()) return false;
+    return settings.commit();
 }
 
 // Utility methods
@@ -726,14 +1024,17 @@ String PaperdInkHardware::getMacAddress() {
 }
 
 void PaperdInkHardware::restart() {
+    buzzer.finish();  // Let the last feedback sound play out
+    commitSettings();
     ESP.restart();
 }
 
 void PaperdInkHardware::factoryReset() {
+    WakeWatchdog::suspend();  // The wipe may outlast the budget; restart() follows
     clearPreferences();
-    if (sdCardAvailable) {
+    if (isSDCardAvailable()) {
         // Clear cache files
-        deleteFile("/cache");
+        wipeCache();
     }
     delay(1000);
     restart();
@@ -773,15 +1074,52 @@ void PaperdInkHardware::setRotation(int rotation) {
 }
 
 void PaperdInkHardware::powerOffDisplay() {
-    epd.hibernate();
+    sleepDisplay();
 }
 
 void PaperdInkHardware::powerOnDisplay() {
-    epd.init(0);
-    epd.setRotation(DISPLAY_ROTATION);
+    wakeDisplay();
 }
 
 void PaperdInkHardware::enterLightSleep(uint32_t sleepTimeMs) {
     esp_sleep_enable_timer_wakeup(sleepTimeMs * 1000ULL);  // Convert to microseconds
     esp_light_sleep_start();
+}
+
+void PaperdInkHardware::idle(uint32_t timeoutMs) {
+    // A held button would wake us immediately and its long press is timed
+    // by the button task; WiFi (STA or config portal AP) and the buzzer's
+    // LEDC clock do not survive light sleep
+    if (buttons.isAnyDown() || buzzer.isPlaying() || WiFi.getMode() != WIFI_OFF ||
+        timeoutMs < IDLE_LIGHT_SLEEP_MIN_MS) {
+        uint32_t waitMs = timeoutMs < IDLE_POLL_INTERVAL_MS ? timeoutMs : IDLE_POLL_INTERVAL_MS;
+        if (waitMs < IDLE_LIGHT_SLEEP_MIN_MS) {
+            delay(waitMs);
+            return;
+        }
+        // Still cheaper than spinning at full clock: the station radio
+        // sleeps between beacons (an AP cannot) and the CPU runs at the low
+        // clock, which WiFi tolerates
+        if ((WiFi.getMode() & WIFI_STA) && !WiFi.getSleep()) {
+            WiFi.setSleep(true);
+        }
+        PowerPhases::beginIdle();
+        delay(waitMs);
+        PowerPhases::endIdle();
+        return;
+    }
+
+    buttons.enableLightSleepWakeup();
+    esp_sleep_enable_gpio_wakeup();
+    esp_sleep_enable_timer_wakeup(timeoutMs * 1000ULL);
+
+    #if DEBUG_ENABLED
+    Serial.flush();  // UART output stalls during light sleep
+    #endif
+    esp_light_sleep_start();
+
+    // Leave the wake sources as deep sleep expects to configure them
+    esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_GPIO);
+    esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_TIMER);
+    buttons.disableLightSleepWakeup();
 }
\ No newline at end of file
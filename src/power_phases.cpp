@@ -0,0 +1,125 @@
+#include "power_phases.h"
+#include "energy_model.h"
+
+#if CPU_SCALING_ENABLED && CPU_FREQ_LOW_MHZ < 80
+#error "CPU_FREQ_LOW_MHZ below 80 MHz stops the WiFi radio"
+#endif
+
+// Clock requested by each phase marker; phases not listed leave it alone
+struct PhaseClock {
+    const char* id;
+    uint16_t mhz;
+};
+
+static const PhaseClock kPhaseClocks[] = {
+    { "wifi",        CPU_FREQ_LOW_MHZ },   // Association and DHCP wait
+    { "display",     CPU_FREQ_LOW_MHZ },   // Image refresh; decode nests inside
+    { "panel",       CPU_FREQ_LOW_MHZ },   // Text refresh, mostly the BUSY wait
+    { "api.display", CPU_FREQ_HIGH_MHZ },  // TLS handshake and response
+    { "download",    CPU_FREQ_HIGH_MHZ },  // TLS bulk decrypt
+    { "decode",      CPU_FREQ_HIGH_MHZ },  // PNG inflate
+    { "ota",         CPU_FREQ_HIGH_MHZ },  // TLS decrypt, SHA-256 and flash writes
+};
+
+struct OpenPhase {
+    const char* id;
+    uint16_t mhz;
+};
+
+static RTC_DATA_ATTR uint32_t s_wakes = 0;  // Drives CPU_POLICY_ALTERNATE
+static CpuPolicy s_policy = CPU_POLICY_FIXED;
+static uint16_t s_bootMhz = 0;
+static OpenPhase s_open[CPU_PHASE_STACK_DEPTH];
+static uint8_t s_depth = 0;
+static bool s_idle = false;
+
+static uint16_t phaseMhz(const char* id) {
+    for (size_t i = 0; i < sizeof(kPhaseClocks) / sizeof(kPhaseClocks[0]); i++) {
+        if (strcmp(kPhaseClocks[i].id, id) == 0) return kPhaseClocks[i].mhz;
+    }
+    return 0;
+}
+
+// Idle wins, then the innermost open phase; with none open the boot clock
+// is restored
+static void applyClock() {
+    uint16_t mhz = s_depth > 0 ? s_open[s_depth - 1].mhz : s_bootMhz;
+    if (s_idle && mhz > CPU_FREQ_LOW_MHZ) mhz = CPU_FREQ_LOW_MHZ;
+    if (mhz == 0 || mhz == getCpuFrequencyMhz()) return;
+
+    EnergyModel::noteCpuFrequency(mhz);  // Closes the time spent at the old clock
+    setCpuFrequencyMhz(mhz);
+}
+
+void PowerPhases::beginCycle() {
+    s_bootMhz = getCpuFrequencyMhz();
+    s_depth = 0;
+
+    #if CPU_SCALING_ENABLED
+    if (CPU_SCALING_POLICY == CPU_POLICY_ALTERNATE) {
+        s_policy = (CpuPolicy)(s_wakes % CPU_POLICY_COUNT);
+    } else {
+        s_policy = (CpuPolicy)CPU_SCALING_POLICY;
+    }
+    s_wakes++;
+    #endif
+
+    EnergyModel::setCpuPolicy(s_policy);
+
+    #if DEBUG_ENABLED
+    Serial.printf("CPU policy: %s (%u MHz at boot)\n", policyName(s_policy), s_bootMhz);
+    #endif
+}
+
+void PowerPhases::enter(const char* id) {
+    if (s_policy != CPU_POLICY_PHASED) return;
+
+    uint16_t mhz = phaseMhz(id);
+    if (mhz == 0 || s_depth >= CPU_PHASE_STACK_DEPTH) return;
+
+    s_open[s_depth++] = OpenPhase{ id, mhz };
+    applyClock();
+}
+
+void PowerPhases::leave(const char* id) {
+    if (s_policy != CPU_POLICY_PHASED) return;
+
+    // Innermost open phase with this id; phases may close out of order
+    // (the WiFi wait spans work that starts and ends inside it)
+    for (int i = s_depth - 1; i >= 0; i--) {
+        if (strcmp(s_open[i].id, id) == 0) {
+            for (int j = i; j + 1 < s_depth; j++) {
+                s_open[j] = s_open[j + 1];
+            }
+            s_depth--;
+            applyClock();
+            return;
+        }
+    }
+}
+
+void PowerPhases::beginIdle() {
+    #if CPU_SCALING_ENABLED
+    s_idle = true;
+    applyClock();
+    #endif
+}
+
+void PowerPhases::endIdle() {
+    if (!s_idle) return;
+    s_idle = false;
+    applyClock();
+}
+
+CpuPolicy PowerPhases::getPolicy() {
+    return s_policy;
+}
+
+const char* PowerPhases::policyName(CpuPolicy policy) {
+    switch (policy) {
+        case CPU_POLICY_FIXED: return "fixed";
+        case CPU_POLICY_PHASED: return "phased";
+        case CPU_POLICY_ALTERNATE: return "alternate";
+        default: return "?";
+    }
+}
@@ -0,0 +1,96 @@
+#include "profiler.h"
+#include <esp_timer.h>
+
+#if PROFILER_ENABLED
+
+static RTC_DATA_ATTR ProfileCycle s_cycles[PROFILER_HISTORY_CYCLES];
+static RTC_DATA_ATTR uint32_t s_cycleCounter = 0;
+
+static ProfileCycle& currentCycle() {
+    return s_cycles[s_cycleCounter % PROFILER_HISTORY_CYCLES];
+}
+
+void Profiler::beginCycle() {
+    s_cycleCounter++;
+    ProfileCycle& cycle = currentCycle();
+    memset(&cycle, 0, sizeof(cycle));
+    cycle.cycle = s_cycleCounter;
+}
+
+void Profiler::endCycle() {
+    ProfileCycle& cycle = currentCycle();
+    uint32_t now = (uint32_t)esp_timer_get_time();
+    for (uint8_t i = 0; i < cycle.count; i++) {
+        if (cycle.spans[i].durationUs == 0) {
+            cycle.spans[i].durationUs = now - cycle.spans[i].startUs;
+        }
+    }
+    cycle.totalUs = now;
+}
+
+void Profiler::begin(const char* id) {
+    ProfileCycle& cycle = currentCycle();
+    if (cycle.cycle == 0 || cycle.count >= PROFILER_MAX_SPANS) return;
+
+    ProfileSpan& span = cycle.spans[cycle.count++];
+    strncpy(span.id, id, sizeof(span.id) - 1);
+    span.id[sizeof(span.id) - 1] = '\0';
+    span.startUs = (uint32_t)esp_timer_get_time();
+    span.durationUs = 0;
+}
+
+void Profiler::end(const char* id) {
+    ProfileCycle& cycle = currentCycle();
+    uint32_t now = (uint32_t)esp_timer_get_time();
+
+    // Innermost open span with this id
+    for (int i = cycle.count - 1; i >= 0; i--) {
+        ProfileSpan& span = cycle.spans[i];
+        if (span.durationUs == 0 && strncmp(span.id, id, sizeof(span.id) - 1) == 0) {
+            span.durationUs = now - span.startUs;
+            if (span.durationUs == 0) span.durationUs = 1;  // Keep it marked closed
+            return;
+        }
+    }
+}
+
+const ProfileCycle* Profiler::getCycle(uint8_t ago) {
+    if (ago >= PROFILER_HISTORY_CYCLES || ago >= s_cycleCounter) return nullptr;
+    const ProfileCycle& cycle = s_cycles[(s_cycleCounter - ago) % PROFILER_HISTORY_CYCLES];
+    return cycle.cycle != 0 ? &cycle : nullptr;
+}
+
+String Profiler::summary(uint8_t ago) {
+    const ProfileCycle* cycle = getCycle(ago);
+    if (!cycle) return String();
+
+    uint32_t total = cycle->totalUs ? cycle->totalUs : (uint32_t)esp_timer_get_time();
+    String line = "#" + String(cycle->cycle) + " " + String(total / 1000) + "ms:";
+    for (uint8_t i = 0; i < cycle->count; i++) {
+        line += " " + String(cycle->spans[i].id) + "=" + String(cycle->spans[i].durationUs / 1000);
+    }
+    return line;
+}
+
+void Profiler::dump() {
+    #if DEBUG_ENABLED
+    Serial.println("=== Wake profile (ms) ===");
+    for (uint8_t ago = 0; ago < PROFILER_HISTORY_CYCLES; ago++) {
+        String line = summary(ago);
+        if (line.length() == 0) break;
+        Serial.println(line);
+    }
+    #endif
+}
+
+#else
+
+void Profiler::beginCycle() {}
+void Profiler::endCycle() {}
+void Profiler::begin(const char*) {}
+void Profiler::end(const char*) {}
+const ProfileCycle* Profiler::getCycle(uint8_t) { return nullptr; }
+String Profiler::summary(uint8_t) { return String(); }
+void Profiler::dump() {}
+
+#endif // PROFILER_ENABLED
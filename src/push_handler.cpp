@@ -0,0 +1,156 @@
+#include "push_handler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Time depends only on the length of the presented token, not on how much
+// of the secret it matches
+static bool tokenEquals(const char* expected, const char* presented) {
+    size_t expectedLength = strlen(expected);
+    size_t presentedLength = strlen(presented);
+    uint8_t difference = expectedLength == presentedLength ? 0 : 1;
+    for (size_t i = 0; i < presentedLength; i++) {
+        uint8_t e = expectedLength > 0 ? (uint8_t)expected[i % expectedLength] : 0;
+        difference |= e ^ (uint8_t)presented[i];
+    }
+    return difference == 0;
+}
+
+PushRequestHandler::PushRequestHandler(PushDisplayFn displayFn, void* displayContext)
+    : display(displayFn)
+    , context(displayContext) {
+}
+
+bool PushRequestHandler::isSupportedImage(const uint8_t* data, size_t size, size_t frameBytes) {
+    static const uint8_t pngSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    if (size == frameBytes) return true;
+    if (size >= 8 && memcmp(data, pngSignature, 8) == 0) return true;
+    return size >= 2 && data[0] == 'B' && data[1] == 'M';
+}
+
+const char* PushRequestHandler::reasonPhrase(int code) {
+    switch (code) {
+        case 100: return "Continue";
+        case 204: return "No Content";
+        case 400: return "Bad Request";
+        case 401: return "Unauthorized";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 408: return "Request Timeout";
+        case 411: return "Length Required";
+        case 413: return "Payload Too Large";
+        case 414: return "URI Too Long";
+        case 415: return "Unsupported Media Type";
+        case 431: return "Request Header Fields Too Large";
+        case 503: return "Service Unavailable";
+        default:  return "Error";
+    }
+}
+
+void PushRequestHandler::sendStatus(PushStream& stream, int code, uint32_t renderMs) {
+    char head[160];
+    int n = snprintf(head, sizeof(head), "HTTP/1.1 %d %s\r\nContent-Length: 0\r\nConnection: close\r\n",
+                     code, reasonPhrase(code));
+    if (renderMs > 0) {
+        n += snprintf(head + n, sizeof(head) - n, "X-Render-Ms: %lu\r\n", (unsigned long)renderMs);
+    }
+    n += snprintf(head + n, sizeof(head) - n, "\r\n");
+    stream.write((const uint8_t*)head, (size_t)n);
+}
+
+bool PushRequestHandler::readBody(PushStream& stream, uint8_t* body, size_t size, size_t have,
+                                  uint32_t startMs, uint32_t timeoutMs) {
+    while (have < size) {
+        if (stream.nowMs() - startMs > timeoutMs) return false;
+        int available = stream.available();
+        if (available <= 0) {
+            if (!stream.connected()) return false;
+            stream.idle();
+            continue;
+        }
+        int got = stream.read(body + have, size - have);
+        if (got > 0) have += (size_t)got;
+    }
+    return true;
+}
+
+int PushRequestHandler::serve(PushStream& stream, const PushHandlerConfig& config, uint32_t* latencyMs) {
+    uint32_t startMs = stream.nowMs();
+    parser.reset();
+
+    // Request head; whatever follows it in the last chunk is the body's start
+    uint8_t chunk[256];
+    size_t chunkLength = 0;
+    size_t used = 0;
+    while (!parser.isComplete() && !parser.hasFailed()) {
+        if (stream.nowMs() - startMs > config.timeoutMs) {
+            sendStatus(stream, 408);
+            return 408;
+        }
+        int available = stream.available();
+        if (available <= 0) {
+            if (!stream.connected()) return 0;
+            stream.idle();
+            continue;
+        }
+        int got = stream.read(chunk, available < (int)sizeof(chunk) ? (size_t)available : sizeof(chunk));
+        if (got <= 0) continue;
+        chunkLength = (size_t)got;
+        used = parser.feed(chunk, chunkLength);
+    }
+
+    int status = 0;
+    if (parser.hasFailed()) {
+        status = parser.getErrorStatus();
+    } else if (strcmp(parser.getPath(), config.path) != 0) {
+        status = 404;
+    } else if (parser.getMethod() != PUSH_METHOD_PUT) {
+        status = 405;
+    } else if (!config.token || config.token[0] == '\0' || !tokenEquals(config.token, parser.getToken())) {
+        status = 401;
+    } else if (parser.getContentLength() < 0) {
+        status = 411;
+    } else if (parser.getContentLength() == 0 || parser.getContentLength() > (int64_t)config.maxBodySize) {
+        status = 413;
+    }
+    if (status != 0) {
+        sendStatus(stream, status);
+        return status;
+    }
+
+    size_t size = (size_t)parser.getContentLength();
+    uint8_t* body = (uint8_t*)malloc(size);
+    if (!body) {
+        sendStatus(stream, 503);
+        return 503;
+    }
+
+    // curl waits a second for this before sending a larger body
+    if (parser.expectsContinue()) {
+        static const char continueLine[] = "HTTP/1.1 100 Continue\r\n\r\n";
+        stream.write((const uint8_t*)continueLine, sizeof(continueLine) - 1);
+    }
+
+    size_t have = chunkLength - used;
+    if (have > size) have = size;
+    memcpy(body, chunk + used, have);
+    if (!readBody(stream, body, size, have, startMs, config.timeoutMs)) {
+        free(body);
+        sendStatus(stream, 408);
+        return 408;
+    }
+
+    if (!isSupportedImage(body, size, config.frameBytes)) {
+        free(body);
+        sendStatus(stream, 415);
+        return 415;
+    }
+
+    if (display) display(context, body, size);
+    free(body);
+
+    uint32_t latency = stream.nowMs() - startMs;
+    if (latencyMs) *latencyMs = latency;
+    sendStatus(stream, 204, latency);
+    return 204;
+}
@@ -0,0 +1,138 @@
+#include "push_request.h"
+#include <ctype.h>
+#include <string.h>
+#include <strings.h>
+
+// Copies at most size - 1 bytes and terminates; false if src did not fit
+static bool copyField(char* dst, size_t size, const char* src, size_t length) {
+    if (length >= size) return false;
+    memcpy(dst, src, length);
+    dst[length] = '\0';
+    return true;
+}
+
+PushRequestParser::PushRequestParser() {
+    reset();
+}
+
+void PushRequestParser::reset() {
+    stage = STAGE_REQUEST_LINE;
+    lineLength = 0;
+    headBytes = 0;
+    errorStatus = 0;
+    method = PUSH_METHOD_OTHER;
+    path[0] = '\0';
+    token[0] = '\0';
+    contentType[0] = '\0';
+    contentLength = -1;
+    expectContinue = false;
+}
+
+void PushRequestParser::fail(int status) {
+    stage = STAGE_FAILED;
+    errorStatus = status;
+}
+
+bool PushRequestParser::parseRequestLine() {
+    // METHOD SP request-target SP HTTP-version
+    const char* sp1 = (const char*)memchr(line, ' ', lineLength);
+    const char* sp2 = sp1 ? (const char*)memchr(sp1 + 1, ' ', lineLength - (sp1 + 1 - line)) : nullptr;
+    if (!sp1 || !sp2 || strncmp(sp2 + 1, "HTTP/1.", 7) != 0) {
+        fail(400);
+        return false;
+    }
+
+    size_t methodLength = sp1 - line;
+    if (methodLength == 3 && memcmp(line, "PUT", 3) == 0) method = PUSH_METHOD_PUT;
+    else if (methodLength == 3 && memcmp(line, "GET", 3) == 0) method = PUSH_METHOD_GET;
+    else method = PUSH_METHOD_OTHER;
+
+    const char* target = sp1 + 1;
+    const char* query = (const char*)memchr(target, '?', sp2 - target);
+    size_t pathLength = (query ? query : sp2) - target;
+    if (!copyField(path, sizeof(path), target, pathLength)) {
+        fail(414);
+        return false;
+    }
+    return true;
+}
+
+bool PushRequestParser::parseHeader() {
+    const char* colon = (const char*)memchr(line, ':', lineLength);
+    if (!colon || colon == line) {
+        fail(400);
+        return false;
+    }
+    size_t nameLength = colon - line;
+    const char* value = colon + 1;
+    const char* end = line + lineLength;
+    while (value < end && (*value == ' ' || *value == '\t')) value++;
+    while (end > value && (end[-1] == ' ' || end[-1] == '\t')) end--;
+    size_t valueLength = end - value;
+
+    if (nameLength == 14 && strncasecmp(line, "Content-Length", 14) == 0) {
+        if (valueLength == 0 || valueLength > 10) {
+            fail(400);
+            return false;
+        }
+        int64_t n = 0;
+        for (size_t i = 0; i < valueLength; i++) {
+            if (!isdigit((unsigned char)value[i])) {
+                fail(400);
+                return false;
+            }
+            n = n * 10 + (value[i] - '0');
+        }
+        contentLength = n;
+    } else if (nameLength == 12 && strncasecmp(line, "Content-Type", 12) == 0) {
+        // Longer types are cut; only the prefix is looked at
+        copyField(contentType, sizeof(contentType), value,
+                  valueLength < sizeof(contentType) ? valueLength : sizeof(contentType) - 1);
+    } else if (nameLength == 12 && strncasecmp(line, "access-token", 12) == 0) {
+        if (!copyField(token, sizeof(token), value, valueLength)) {
+            fail(431);
+            return false;
+        }
+    } else if (nameLength == 13 && strncasecmp(line, "Authorization", 13) == 0) {
+        if (valueLength > 7 && strncasecmp(value, "Bearer ", 7) == 0 &&
+            !copyField(token, sizeof(token), value + 7, valueLength - 7)) {
+            fail(431);
+            return false;
+        }
+    } else if (nameLength == 6 && strncasecmp(line, "Expect", 6) == 0) {
+        expectContinue = valueLength == 12 && strncasecmp(value, "100-continue", 12) == 0;
+    }
+    return true;
+}
+
+size_t PushRequestParser::feed(const uint8_t* data, size_t length) {
+    size_t used = 0;
+    while (used < length && (stage == STAGE_REQUEST_LINE || stage == STAGE_HEADERS)) {
+        char c = (char)data[used++];
+        if (++headBytes > HEAD_LIMIT) {
+            fail(431);
+            break;
+        }
+        if (c == '\r') continue;
+        if (c != '\n') {
+            if (lineLength >= sizeof(line) - 1) {
+                fail(stage == STAGE_REQUEST_LINE ? 414 : 431);
+                break;
+            }
+            line[lineLength++] = c;
+            continue;
+        }
+
+        line[lineLength] = '\0';
+        if (stage == STAGE_REQUEST_LINE) {
+            // Blank lines before the request line are allowed
+            if (lineLength > 0 && parseRequestLine()) stage = STAGE_HEADERS;
+        } else if (lineLength == 0) {
+            stage = STAGE_DONE;
+        } else {
+            parseHeader();
+        }
+        lineLength = 0;
+    }
+    return used;
+}
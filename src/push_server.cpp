@@ -0,0 +1,84 @@
+#include "push_server.h"
+
+// PushStream over an accepted WiFiClient
+class WiFiPushStream : public PushStream {
+private:
+    WiFiClient& client;
+
+public:
+    explicit WiFiPushStream(WiFiClient& c) : client(c) {}
+    int available() override { return client.available(); }
+    int read(uint8_t* buffer, size_t size) override { return client.read(buffer, size); }
+    size_t write(const uint8_t* data, size_t length) override { return client.write(data, length); }
+    bool connected() override { return client.connected(); }
+    uint32_t nowMs() override { return millis(); }
+    void idle() override { delay(1); }
+};
+
+PushServer::PushServer()
+    : server(PUSH_SERVER_PORT)
+    , handler(displayPushed, this)
+    , hardware(nullptr)
+    , running(false)
+    , pushes(0)
+    , lastLatencyMs(0) {
+}
+
+void PushServer::displayPushed(void* context, const uint8_t* image, size_t size) {
+    PushServer* self = (PushServer*)context;
+    self->hardware->displayImage(image, size);
+}
+
+bool PushServer::begin(PaperdInkHardware* hw, const String& accessToken) {
+    if (running) return true;
+    if (!hw || accessToken.length() == 0) return false;
+
+    hardware = hw;
+    token = accessToken;
+    server.begin();
+    server.setNoDelay(true);
+    running = true;
+
+    #if DEBUG_ENABLED
+    Serial.printf("Push server listening on http://%s:%d%s\n",
+                  WiFi.localIP().toString().c_str(), PUSH_SERVER_PORT, PUSH_SERVER_PATH);
+    #endif
+    return true;
+}
+
+void PushServer::end() {
+    if (!running) return;
+    server.stop();
+    running = false;
+}
+
+bool PushServer::handle() {
+    if (!running) return false;
+    WiFiClient client = server.available();
+    if (!client) return false;
+
+    PushHandlerConfig config;
+    config.path = PUSH_SERVER_PATH;
+    config.token = token.c_str();
+    config.maxBodySize = MAX_IMAGE_SIZE;
+    config.frameBytes = DISPLAY_FRAME_BYTES;
+    config.timeoutMs = PUSH_READ_TIMEOUT_MS;
+
+    WiFiPushStream stream(client);
+    uint32_t latencyMs = 0;
+    int status = handler.serve(stream, config, &latencyMs);
+    client.stop();
+    if (status != 204) {
+        #if DEBUG_ENABLED
+        if (status != 0) Serial.printf("Push rejected with %d\n", status);
+        #endif
+        return false;
+    }
+
+    lastLatencyMs = latencyMs;
+    pushes++;
+    #if DEBUG_ENABLED
+    Serial.printf("Pushed image shown %lu ms after the request\n", (unsigned long)lastLatencyMs);
+    #endif
+    return true;
+}
@@ -0,0 +1,80 @@
+#include "refresh_policy.h"
+
+static const uint32_t SECONDS_PER_DAY = 86400;
+
+RefreshPolicy::RefreshPolicy(const RefreshPolicyConfig& policyConfig)
+    : config(policyConfig) {
+}
+
+uint32_t RefreshPolicy::clampSleep(uint64_t seconds) const {
+    if (seconds < config.minSleepSeconds) return config.minSleepSeconds;
+    if (seconds > config.maxSleepSeconds) return config.maxSleepSeconds;
+    return (uint32_t)seconds;
+}
+
+uint16_t RefreshPolicy::socIntervalPercent(int batteryPercent) const {
+    if (!config.socCurve || config.socCurvePoints == 0) return 100;
+
+    const SocStretchPoint* curve = config.socCurve;
+    if (batteryPercent >= curve[0].percent) return curve[0].intervalPercent;
+
+    for (uint8_t i = 1; i < config.socCurvePoints; i++) {
+        if (batteryPercent >= curve[i].percent) {
+            // Linear between the neighbouring points
+            int span = curve[i - 1].percent - curve[i].percent;
+            if (span <= 0) return curve[i].intervalPercent;
+            int offset = batteryPercent - curve[i].percent;
+            int delta = (int)curve[i - 1].intervalPercent - (int)curve[i].intervalPercent;
+            return (uint16_t)(curve[i].intervalPercent + delta * offset / span);
+        }
+    }
+    return curve[config.socCurvePoints - 1].intervalPercent;
+}
+
+bool RefreshPolicy::inQuietHours(uint32_t secondOfDay) const {
+    uint32_t start = config.quietStartSecond;
+    uint32_t end = config.quietEndSecond;
+    if (start == end) return false;
+    if (start < end) return secondOfDay >= start && secondOfDay < end;
+    return secondOfDay >= start || secondOfDay < end;  // Wraps midnight
+}
+
+uint32_t RefreshPolicy::secondsUntilQuietEnd(uint32_t secondOfDay) const {
+    if (!inQuietHours(secondOfDay)) return 0;
+    uint32_t end = config.quietEndSecond;
+    return end > secondOfDay ? end - secondOfDay : SECONDS_PER_DAY - secondOfDay + end;
+}
+
+uint32_t RefreshPolicy::nextSleepSeconds(const RefreshPolicyInput& input) const {
+    // On external power energy is free: follow the server
+    if (input.charging) return clampSleep(input.serverRefreshSeconds);
+
+    uint64_t sleep = (uint64_t)input.serverRefreshSeconds * socIntervalPercent(input.batteryPercent) / 100;
+
+    // Unchanged content: double the interval per repeat, up to the cap
+    if (input.unchangedCycles > 0 && config.unchangedStretchMax > 1) {
+        uint32_t factor = 1;
+        for (uint8_t i = 0; i < input.unchangedCycles && factor < config.unchangedStretchMax; i++) {
+            factor *= 2;
+        }
+        if (factor > config.unchangedStretchMax) factor = config.unchangedStretchMax;
+        sleep *= factor;
+    }
+
+    if (input.localSecondOfDay >= 0) {
+        uint32_t now = (uint32_t)input.localSecondOfDay % SECONDS_PER_DAY;
+        if (inQuietHours(now)) {
+            // No refreshes at night: sleep through to the end of quiet hours
+            uint32_t untilEnd = secondsUntilQuietEnd(now);
+            if (untilEnd > sleep) sleep = untilEnd;
+        } else {
+            // A wake that would land inside quiet hours is pushed to their end
+            uint32_t wake = (uint32_t)((now + sleep) % SECONDS_PER_DAY);
+            if (sleep < SECONDS_PER_DAY && inQuietHours(wake)) {
+                sleep += secondsUntilQuietEnd(wake);
+            }
+        }
+    }
+
+    return clampSleep(sleep);
+}
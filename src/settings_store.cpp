@@ -0,0 +1,190 @@
+#include "settings_store.h"
+
+static const char* SETTINGS_BLOB_KEY = "settings";
+static const uint16_t SETTINGS_VERSION = 2;
+
+// NVS layout: header followed by the settings struct
+struct SettingsBlob {
+    uint16_t version;
+    uint16_t size;
+    DeviceSettings settings;
+};
+
+// Version 1 layout, before the backend URL was configurable
+struct DeviceSettingsV1 {
+    char wifiSsid[33];
+    char wifiPassword[65];
+    char apiKey[65];
+    char friendlyId[17];
+    int32_t refreshRate;
+    bool invertDisplay;
+};
+
+struct SettingsBlobV1 {
+    uint16_t version;
+    uint16_t size;
+    DeviceSettingsV1 settings;
+};
+
+SettingsStore::SettingsStore()
+    : preferences(nullptr)
+    , dirtyMask(0)
+    , loaded(false) {
+    setDefaults();
+}
+
+void SettingsStore::setDefaults() {
+    memset(&settings, 0, sizeof(settings));
+    settings.refreshRate = DEEP_SLEEP_DURATION_SECONDS;
+    settings.invertDisplay = false;
+}
+
+bool SettingsStore::begin(Preferences* prefs) {
+    preferences = prefs;
+    setDefaults();
+    dirtyMask = 0;
+
+    SettingsBlob blob;
+    if (preferences->getBytesLength(SETTINGS_BLOB_KEY) == sizeof(blob) &&
+        preferences->getBytes(SETTINGS_BLOB_KEY, &blob, sizeof(blob)) == sizeof(blob) &&
+        blob.version == SETTINGS_VERSION && blob.size == sizeof(DeviceSettings)) {
+        settings = blob.settings;
+        loaded = true;
+        return true;
+    }
+
+    if (migrateVersion1()) {
+        loaded = true;
+        return true;
+    }
+
+    // First boot with this layout: pull the old one-key-per-setting values
+    // once; they are written as a blob (and the old keys dropped) on commit
+    loaded = migrateLegacyKeys();
+    return loaded;
+}
+
+void SettingsStore::restore(Preferences* prefs, const DeviceSettings& saved) {
+    preferences = prefs;
+    settings = saved;
+    dirtyMask = 0;
+    loaded = true;
+}
+
+bool SettingsStore::migrateLegacyKeys() {
+    if (!preferences->isKey("api_key") && !preferences->isKey("wifi_ssid") &&
+        !preferences->isKey("refresh_rate") && !preferences->isKey("invert")) {
+        return true;  // Fresh device, defaults apply
+    }
+
+    #if DEBUG_ENABLED
+    Serial.println("Settings: migrating legacy NVS keys");
+    #endif
+
+    setWifiCredentials(preferences->getString("wifi_ssid", "").c_str(),
+                       preferences->getString("wifi_password", "").c_str());
+    setApiKey(preferences->getString("api_key", "").c_str());
+    setFriendlyId(preferences->getString("friendly_id", "").c_str());
+    setRefreshRate(preferences->getInt("refresh_rate", DEEP_SLEEP_DURATION_SECONDS));
+    setInvertDisplay(preferences->getBool("invert", false));
+
+    // Make sure the blob gets written even if every value matched a default
+    dirtyMask |= SETTING_REFRESH_RATE;
+    return true;
+}
+
+bool SettingsStore::migrateVersion1() {
+    SettingsBlobV1 old;
+    if (preferences->getBytesLength(SETTINGS_BLOB_KEY) != sizeof(old) ||
+        preferences->getBytes(SETTINGS_BLOB_KEY, &old, sizeof(old)) != sizeof(old) ||
+        old.version != 1 || old.size != sizeof(DeviceSettingsV1)) {
+        return false;
+    }
+
+    #if DEBUG_ENABLED
+    Serial.println("Settings: migrating version 1 blob");
+    #endif
+
+    memcpy(settings.wifiSsid, old.settings.wifiSsid, sizeof(settings.wifiSsid));
+    memcpy(settings.wifiPassword, old.settings.wifiPassword, sizeof(settings.wifiPassword));
+    memcpy(settings.apiKey, old.settings.apiKey, sizeof(settings.apiKey));
+    memcpy(settings.friendlyId, old.settings.friendlyId, sizeof(settings.friendlyId));
+    settings.refreshRate = old.settings.refreshRate;
+    settings.invertDisplay = old.settings.invertDisplay;
+
+    // Rewritten in the new layout on the next commit
+    dirtyMask |= SETTING_API_BASE_URL;
+    return true;
+}
+
+bool SettingsStore::commit() {
+    if (!dirtyMask) return true;
+    if (!preferences) return false;
+
+    SettingsBlob blob;
+    memset(&blob, 0, sizeof(blob));
+    blob.version = SETTINGS_VERSION;
+    blob.size = sizeof(DeviceSettings);
+    blob.settings = settings;
+
+    if (preferences->putBytes(SETTINGS_BLOB_KEY, &blob, sizeof(blob)) != sizeof(blob)) {
+        #if DEBUG_ENABLED
+        Serial.println("Settings: commit failed");
+        #endif
+        return false;
+    }
+
+    // Old per-key values are superseded by the blob
+    const char* legacyKeys[] = { "wifi_ssid", "wifi_password", "api_key", "friendly_id", "refresh_rate", "invert" };
+    for (const char* key : legacyKeys) {
+        if (preferences->isKey(key)) preferences->remove(key);
+    }
+
+    #if DEBUG_ENABLED
+    Serial.printf("Settings: committed (dirty mask 0x%02x)\n", (unsigned)dirtyMask);
+    #endif
+    dirtyMask = 0;
+    return true;
+}
+
+void SettingsStore::reset() {
+    setDefaults();
+    dirtyMask = 0;
+}
+
+void SettingsStore::setString(char* field, size_t fieldSize, const char* value, SettingsField flag) {
+    if (!value) value = "";
+    if (strncmp(field, value, fieldSize) == 0) return;
+    strncpy(field, value, fieldSize - 1);
+    field[fieldSize - 1] = '\0';
+    dirtyMask |= flag;
+}
+
+void SettingsStore::setWifiCredentials(const char* ssid, const char* password) {
+    setString(settings.wifiSsid, sizeof(settings.wifiSsid), ssid, SETTING_WIFI_SSID);
+    setString(settings.wifiPassword, sizeof(settings.wifiPassword), password, SETTING_WIFI_PASSWORD);
+}
+
+void SettingsStore::setApiKey(const char* apiKey) {
+    setString(settings.apiKey, sizeof(settings.apiKey), apiKey, SETTING_API_KEY);
+}
+
+void SettingsStore::setFriendlyId(const char* friendlyId) {
+    setString(settings.friendlyId, sizeof(settings.friendlyId), friendlyId, SETTING_FRIENDLY_ID);
+}
+
+void SettingsStore::setRefreshRate(int seconds) {
+    if (settings.refreshRate == seconds) return;
+    settings.refreshRate = seconds;
+    dirtyMask |= SETTING_REFRESH_RATE;
+}
+
+void SettingsStore::setInvertDisplay(bool invert) {
+    if (settings.invertDisplay == invert) return;
+    settings.invertDisplay = invert;
+    dirtyMask |= SETTING_INVERT;
+}
+
+void SettingsStore::setApiBaseUrl(const char* url) {
+    setString(settings.apiBaseUrl, sizeof(settings.apiBaseUrl), url, SETTING_API_BASE_URL);
+}
@@ -0,0 +1,71 @@
+#include "soc_estimator.h"
+
+SocEstimator::SocEstimator(const SocEstimatorConfig& estimatorConfig, SocEstimatorState& estimatorState)
+    : config(estimatorConfig)
+    , state(estimatorState) {
+}
+
+uint8_t SocEstimator::curvePercent(float volts) const {
+    if (!config.curve || config.curvePoints == 0) return 0;
+
+    const SocCurvePoint* curve = config.curve;
+    float millivolts = volts * 1000.0f;
+    if (millivolts >= curve[0].millivolts) return curve[0].percent;
+
+    for (uint8_t i = 1; i < config.curvePoints; i++) {
+        if (millivolts >= curve[i].millivolts) {
+            float span = (float)(curve[i - 1].millivolts - curve[i].millivolts);
+            if (span <= 0.0f) return curve[i].percent;
+            float fraction = (millivolts - curve[i].millivolts) / span;
+            float percent = curve[i].percent + fraction * (curve[i - 1].percent - curve[i].percent);
+            return (uint8_t)(percent + 0.5f);
+        }
+    }
+    return curve[config.curvePoints - 1].percent;
+}
+
+void SocEstimator::learnSag(float restVolts, float loadedVolts) {
+    float sag = restVolts - loadedVolts;
+    if (sag < 0.0f || sag > config.maxSagVolts) return;
+
+    if (state.sagVolts <= 0.0f) {
+        state.sagVolts = sag;
+    } else {
+        state.sagVolts += config.sagWeight * (sag - state.sagVolts);
+    }
+}
+
+float SocEstimator::compensate(float volts, bool underLoad) const {
+    return underLoad ? volts + state.sagVolts : volts;
+}
+
+void SocEstimator::update(float restEquivalentVolts, bool charging) {
+    uint8_t percent = curvePercent(restEquivalentVolts);
+
+    if (!state.valid) {
+        state.reportedPercent = percent;
+        state.low = restEquivalentVolts < config.lowVolts;
+        state.critical = restEquivalentVolts < config.criticalVolts;
+        state.valid = 1;
+        return;
+    }
+
+    // Only move the reported value once the estimate has left the band;
+    // while charging let it rise freely
+    int delta = (int)percent - (int)state.reportedPercent;
+    if ((charging && delta > 0) || delta >= config.percentHysteresis || -delta >= config.percentHysteresis) {
+        state.reportedPercent = percent;
+    }
+
+    // Flags set below their threshold and clear only once clearly above it
+    if (restEquivalentVolts < config.lowVolts) {
+        state.low = 1;
+    } else if (restEquivalentVolts > config.lowVolts + config.flagHysteresisVolts) {
+        state.low = 0;
+    }
+    if (restEquivalentVolts < config.criticalVolts) {
+        state.critical = 1;
+    } else if (restEquivalentVolts > config.criticalVolts + config.flagHysteresisVolts) {
+        state.critical = 0;
+    }
+}
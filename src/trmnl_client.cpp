@@ -1,5 +1,8 @@
 #include "trmnl_client.h"
 #include "secrets.h"
+#include "profiler.h"
+#include "energy_model.h"
+#include "wake_watchdog.h"
 #include <Update.h>
 
 TRMNLClient::TRMNLClient(PaperdInkHardware* hw)
@@ -8,30 +11,54 @@ TRMNLClient::TRMNLClient(PaperdInkHardware* hw)
     , dnsServer(nullptr)
     , currentState(STATE_UNINITIALIZED)
     , refreshRate(DEEP_SLEEP_DURATION_SECONDS)
+    , wifiConnectStarted(false)
     , configPortalActive(false)
     , configPortalStartTime(0)
+    , shownPanelGeneration(UINT32_MAX)
+    , unchangedCycles(0)
     , lastUpdateTime(0)
+    , otaUpdater(wifiClient, plainClient)
+    , warmupStage(WARMUP_IDLE)
+    , warmupItems(0)
+    , warmupRenderSlot(0)
+    , warmupStartClock(0)
+    , warmupFullCycle(false)
     , consecutiveErrors(0) {
-
-    macAddress = hardware->getMacAddress();
 }
 
 TRMNLClient::~TRMNLClient() {
     end();
 }
 
-bool TRMNLClient::begin() {
+bool TRMNLClient::begin(const ClientSnapshot* snapshot) {
     #if DEBUG_ENABLED
     Serial.println("Initializing TRMNL client...");
     #endif
 
-    // Load saved device info
+    // Load saved device info (served from the settings store in RAM)
     loadDeviceInfo();
 
     // Configure WiFi client for HTTPS
     wifiClient.setInsecure();  // For now, skip certificate validation
 
-    currentState = STATE_UNINITIALIZED;
+    // Local time for quiet hours; the RTC keeps the clock across deep sleep
+    setenv("TZ", TIME_ZONE, 1);
+    tzset();
+
+    if (snapshot) {
+        currentState = (DeviceState)snapshot->state;
+        macAddress = snapshot->macAddress;
+        lastImageFilename = snapshot->lastImageFilename;
+        consecutiveErrors = snapshot->consecutiveErrors;
+        unchangedCycles = snapshot->unchangedCycles;
+        // The panel kept its image through deep sleep
+        if (snapshot->panelShowsLastImage) {
+            shownPanelGeneration = hardware->getPanelGeneration();
+        }
+    } else {
+        currentState = STATE_UNINITIALIZED;
+        macAddress = hardware->getMacAddress();
+    }
 
     #if DEBUG_ENABLED
     Serial.printf("MAC Address: %s\n", macAddress.c_str());
@@ -42,10 +69,21 @@ bool TRMNLClient::begin() {
     return true;
 }
 
+void TRMNLClient::captureSnapshot(ClientSnapshot& snapshot) const {
+    memset(&snapshot, 0, sizeof(snapshot));
+    snapshot.state = (uint8_t)currentState;
+    strncpy(snapshot.macAddress, macAddress.c_str(), sizeof(snapshot.macAddress) - 1);
+    strncpy(snapshot.lastImageFilename, lastImageFilename.c_str(), sizeof(snapshot.lastImageFilename) - 1);
+    snapshot.consecutiveErrors = consecutiveErrors;
+    snapshot.panelShowsLastImage = isPanelShowingLastImage() ? 1 : 0;
+    snapshot.unchangedCycles = unchangedCycles;
+}
+
 void TRMNLClient::end() {
     stopConfigPortal();
     httpClient.end();
     wifiClient.stop();
+    plainClient.stop();
 }
 
 void TRMNLClient::loop() {
@@ -63,7 +101,9 @@ void TRMNLClient::loop() {
     }
 }
 
-bool TRMNLClient::connectToWiFi() {
+bool TRMNLClient::startWiFiConnect() {
+    if (wifiConnectStarted) return true;
+
     String ssid, password;
     if (!loadCredentials(ssid, password)) {
         #if DEBUG_ENABLED
@@ -74,48 +114,72 @@ bool TRMNLClient::connectToWiFi() {
 
     #if DEBUG_ENABLED
     Serial.printf("Connecting to WiFi: %s\n", ssid.c_str());
-
-    // Scan for available networks
-    Serial.println("Scanning for WiFi networks...");
-    WiFi.mode(WIFI_STA);
-    int n = WiFi.scanNetworks();
-    Serial.printf("Found %d networks:\n", n);
-    for (int i = 0; i < n; i++) {
-        Serial.printf("  %d: %s (%d dBm) %s\n",
-                     i + 1,
-                     WiFi.SSID(i).c_str(),
-                     WiFi.RSSI(i),
-                     WiFi.encryptionType(i) == WIFI_AUTH_OPEN ? "Open" : "Encrypted");
-    }
-    Serial.println();
     #endif
 
+    PROFILE_BEGIN("wifi");
+    EnergyModel::beginPhase(ENERGY_RADIO);
     WiFi.mode(WIFI_STA);
     WiFi.begin(ssid.c_str(), password.c_str());
+    wifiConnectStarted = true;
+    return true;
+}
 
+bool TRMNLClient::waitForWiFi(unsigned long timeoutMs) {
     unsigned long startTime = millis();
     while (WiFi.status() != WL_CONNECTED &&
-           millis() - startTime < WIFI_CONNECT_TIMEOUT_MS) {
-        delay(500);
-        #if DEBUG_ENABLED
-        Serial.print(".");
-        #endif
+           millis() - startTime < timeoutMs && !WakeWatchdog::expired()) {
+        delay(WIFI_POLL_INTERVAL_MS);
     }
+    PROFILE_END("wifi");
 
     if (WiFi.status() == WL_CONNECTED) {
+        syncClock();
         #if DEBUG_ENABLED
-        Serial.println();
-        Serial.printf("WiFi connected! IP: %s\n", WiFi.localIP().toString().c_str());
+        Serial.printf("WiFi connected after %lu ms! IP: %s\n",
+                      millis() - startTime, WiFi.localIP().toString().c_str());
         Serial.printf("RSSI: %d dBm\n", WiFi.RSSI());
         #endif
         return true;
-    } else {
-        #if DEBUG_ENABLED
+    }
+
+    #if DEBUG_ENABLED
+    Serial.println("WiFi connection failed");
+    #endif
+    // Let the next attempt issue a fresh WiFi.begin()
+    wifiConnectStarted = false;
+    return false;
+}
+
+void TRMNLClient::syncClock() {
+    // Asynchronous SNTP request; the RTC clock drifts during deep sleep, so
+    // re-sync on every connect. The old time stays valid until the reply.
+    configTzTime(TIME_ZONE, NTP_SERVER);
+}
+
+bool TRMNLClient::connectToWiFi() {
+    if (isWiFiConnected()) return true;
+
+    #if DEBUG_ENABLED
+    if (!wifiConnectStarted) {
+        // Scan for available networks (skipped when a connect is already
+        // under way, e.g. started first thing on a timer wake)
+        Serial.println("Scanning for WiFi networks...");
+        WiFi.mode(WIFI_STA);
+        int n = WiFi.scanNetworks();
+        Serial.printf("Found %d networks:\n", n);
+        for (int i = 0; i < n; i++) {
+            Serial.printf("  %d: %s (%d dBm) %s\n",
+                         i + 1,
+                         WiFi.SSID(i).c_str(),
+                         WiFi.RSSI(i),
+                         WiFi.encryptionType(i) == WIFI_AUTH_OPEN ? "Open" : "Encrypted");
+        }
         Serial.println();
-        Serial.println("WiFi connection failed");
-        #endif
-        return false;
     }
+    #endif
+
+    if (!startWiFiConnect()) return false;
+    return waitForWiFi(WIFI_CONNECT_TIMEOUT_MS);
 }
 
 bool TRMNLClient::startConfigPortal() {
@@ -127,9 +191,13 @@ bool TRMNLClient::startConfigPortal() {
     Serial.println("Starting configuration portal...");
     #endif
 
+    // The portal has its own timeout (CONFIG_PORTAL_TIMEOUT_MS)
+    WakeWatchdog::suspend();
+
     // Create access point
     String apName = "paperdink-setup-" + macAddress.substring(9);  // Last 6 chars of MAC
     WiFi.mode(WIFI_AP_STA);
+    EnergyModel::beginPhase(ENERGY_RADIO);
     WiFi.softAP(apName.c_str(), "paperdink123");
 
     // Start DNS server for captive portal
@@ -178,6 +246,7 @@ void TRMNLClient::stopConfigPortal() {
 
     WiFi.softAPdisconnect(true);
     configPortalActive = false;
+    WakeWatchdog::arm();
 }
 
 void TRMNLClient::handleConfigPortal() {
@@ -198,23 +267,35 @@ void TRMNLClient::handleWiFiSave() {
     String ssid = configServer->arg("ssid");
     String password = configServer->arg("password");
 
-    if (ssid.length() > 0) {
-        saveCredentials(ssid, password);
+    // Check every field before anything is stored: a new server URL drops
+    // the registration, which a rejected form must not do
+    if (ssid.length() == 0) {
+        configServer->send(400, "text/html", "<html><body><h1>Error: SSID required</h1></body></html>");
+        return;
+    }
+    // Empty field: back to the default backend
+    bool hasUrl = configServer->hasArg("api_url");
+    String base;
+    if (hasUrl && !normalizeApiBaseUrl(configServer->arg("api_url"), base)) {
+        configServer->send(400, "text/html", "<html><body><h1>Error: server URL must start with http:// or https://</h1></body></html>");
+        return;
+    }
 
-        String html = "<html><body><h1>WiFi Saved!</h1>";
-        html += "<p>SSID: " + ssid + "</p>";
-        html += "<p>Device will restart and connect...</p>";
-        html += "<script>setTimeout(function(){window.location.href='/';}, 3000);</script>";
-        html += "</body></html>";
+    if (hasUrl) setApiBaseUrl(base);
+    saveCredentials(ssid, password);
 
-        configServer->send(200, "text/html", html);
+    String html = "<html><body><h1>WiFi Saved!</h1>";
+    html += "<p>SSID: " + ssid + "</p>";
+    html += "<p>Server: " + getApiBaseUrl() + "</p>";
+    html += "<p>Device will restart and connect...</p>";
+    html += "<script>setTimeout(function(){window.location.href='/';}, 3000);</script>";
+    html += "</body></html>";
 
-        delay(2000);
-        stopConfigPortal();
-        hardware->restart();
-    } else {
-        configServer->send(400, "text/html", "<html><body><h1>Error: SSID required</h1></body></html>");
-    }
+    configServer->send(200, "text/html", html);
+
+    delay(2000);
+    stopConfigPortal();
+    hardware->restart();
 }
 
 void TRMNLClient::handleReset() {
@@ -238,7 +319,7 @@ String TRMNLClient::generateConfigPage() {
     html += "body { font-family: Arial, sans-serif; margin: 20px; background: #f0f0f0; }";
     html += ".container { max-width: 400px; margin: 0 auto; background: white; padding: 20px; border-radius: 10px; }";
     html += "h1 { color: #333; text-align: center; }";
-    html += "input[type=text], input[type=password] { width: 100%; padding: 10px; margin: 5px 0; border: 1px solid #ddd; border-radius: 5px; }";
+    html += "input[type=text], input[type=password], input[type=url] { width: 100%; padding: 10px; margin: 5px 0; border: 1px solid #ddd; border-radius: 5px; }";
     html += "button { width: 100%; padding: 12px; background: #007cba; color: white; border: none; border-radius: 5px; cursor: pointer; margin: 5px 0; }";
     html += "button:hover { background: #005a87; }";
     html += ".info { background: #e7f3ff; padding: 10px; border-radius: 5px; margin: 10px 0; }";
@@ -257,6 +338,10 @@ String TRMNLClient::generateConfigPage() {
     html += "<h3>WiFi Configuration</h3>";
     html += "<input type='text' name='ssid' placeholder='WiFi Network Name (SSID)' required>";
     html += "<input type='password' name='password' placeholder='WiFi Password'>";
+    html += "<h3>Server</h3>";
+    html += "<input type='url' name='api_url' placeholder='" + String(TRMNL_API_BASE_URL) + "' value='" +
+            String(hardware->getSettings().getApiBaseUrl()) + "'>";
+    html += "<p>Leave empty for TRMNL. Use http:// only for a trusted server on this network.</p>";
     html += "<button type='submit'>Save WiFi Settings</button>";
     html += "</form>";
 
@@ -278,8 +363,7 @@ bool TRMNLClient::hasWiFiCredentials() {
 }
 
 void TRMNLClient::saveCredentials(const String& ssid, const String& password) {
-    hardware->saveString("wifi_ssid", ssid.c_str());
-    hardware->saveString("wifi_password", password.c_str());
+    hardware->getSettings().setWifiCredentials(ssid.c_str(), password.c_str());
 
     #if DEBUG_ENABLED
     Serial.printf("WiFi credentials saved: %s\n", ssid.c_str());
@@ -297,16 +381,15 @@ bool TRMNLClient::loadCredentials(String& ssid, String& password) {
     #endif
     return true;
     #else
-    // Load from preferences
-    ssid = hardware->loadString("wifi_ssid", "");
-    password = hardware->loadString("wifi_password", "");
+    // Load from the settings store
+    ssid = hardware->getSettings().getWifiSsid();
+    password = hardware->getSettings().getWifiPassword();
     return ssid.length() > 0;
     #endif
 }
 
 void TRMNLClient::clearWiFiCredentials() {
-    hardware->saveString("wifi_ssid", "");
-    hardware->saveString("wifi_password", "");
+    hardware->getSettings().setWifiCredentials("", "");
 }
 
 // Device registration
@@ -315,9 +398,11 @@ bool TRMNLClient::isDeviceRegistered() {
 }
 
 void TRMNLClient::saveDeviceInfo() {
-    hardware->saveString("api_key", apiKey.c_str());
-    hardware->saveString("friendly_id", friendlyId.c_str());
-    hardware->saveInt("refresh_rate", refreshRate);
+    // Only changed fields mark the store dirty; written once before sleep
+    SettingsStore& settings = hardware->getSettings();
+    settings.setApiKey(apiKey.c_str());
+    settings.setFriendlyId(friendlyId.c_str());
+    settings.setRefreshRate(refreshRate);
 }
 
 bool TRMNLClient::loadDeviceInfo() {
@@ -325,17 +410,17 @@ bool TRMNLClient::loadDeviceInfo() {
     #ifdef TRMNL_API_KEY
     apiKey = TRMNL_API_KEY;
     #else
-    apiKey = hardware->loadString("api_key", "");
+    apiKey = hardware->getSettings().getApiKey();
     #endif
 
     // Use predefined friendly ID if available, otherwise load from preferences
     #ifdef CUSTOM_FRIENDLY_ID
     friendlyId = CUSTOM_FRIENDLY_ID;
     #else
-    friendlyId = hardware->loadString("friendly_id", "");
+    friendlyId = hardware->getSettings().getFriendlyId();
     #endif
 
-    refreshRate = hardware->loadInt("refresh_rate", DEEP_SLEEP_DURATION_SECONDS);
+    refreshRate = hardware->getSettings().getRefreshRate();
 
     return isDeviceRegistered();
 }
@@ -343,8 +428,66 @@ bool TRMNLClient::loadDeviceInfo() {
 void TRMNLClient::clearDeviceRegistration() {
     apiKey = "";
     friendlyId = "";
-    hardware->saveString("api_key", "");
-    hardware->saveString("friendly_id", "");
+    hardware->getSettings().setApiKey("");
+    hardware->getSettings().setFriendlyId("");
+}
+
+String TRMNLClient::getApiBaseUrl() const {
+    const char* url = hardware->getSettings().getApiBaseUrl();
+    return url[0] ? String(url) : String(TRMNL_API_BASE_URL);
+}
+
+bool TRMNLClient::normalizeApiBaseUrl(const String& url, String& base) {
+    base = url;
+    base.trim();
+    while (base.endsWith("/")) base.remove(base.length() - 1);
+    if (base == TRMNL_API_BASE_URL) base = "";
+    if (base.length() == 0) return true;
+
+    bool schemeOk = base.startsWith("http://") || base.startsWith("https://");
+    bool fits = base.length() < sizeof(DeviceSettings::apiBaseUrl);
+    // Shown back in the portal form, so no quotes, brackets or spaces
+    for (size_t i = 0; i < base.length() && fits; i++) {
+        char c = base[i];
+        if (c <= ' ' || c == '"' || c == '\'' || c == '<' || c == '>') fits = false;
+    }
+    return schemeOk && fits && base.indexOf("://") + 3 < (int)base.length();
+}
+
+bool TRMNLClient::setApiBaseUrl(const String& url) {
+    String base;
+    if (!normalizeApiBaseUrl(url, base)) {
+        lastError = "invalid API base URL";
+        return false;
+    }
+
+    String previous = getApiBaseUrl();
+    hardware->getSettings().setApiBaseUrl(base.c_str());
+    // The API key belongs to the old backend
+    if (getApiBaseUrl() != previous) {
+        clearDeviceRegistration();
+    }
+
+    #if DEBUG_ENABLED
+    Serial.printf("API base URL: %s\n", getApiBaseUrl().c_str());
+    #endif
+    return true;
+}
+
+bool TRMNLClient::isPlainHttp() const {
+    return getApiBaseUrl().startsWith("http://");
+}
+
+WiFiClient* TRMNLClient::transportFor(const String& url) {
+    if (!url.startsWith("http://")) return &wifiClient;
+    if (isPlainHttp() && OtaUpdater::isPlainHttpAllowed(url, getApiBaseUrl())) return &plainClient;
+
+    // The access token would go out in the clear to a host nobody configured
+    lastError = "plain http:// URL not allowed: " + url;
+    #if DEBUG_ENABLED
+    Serial.println(lastError);
+    #endif
+    return nullptr;
 }
 
 // WiFi management functions
@@ -391,7 +534,7 @@ bool TRMNLClient::registerDevice() {
 }
 
 // Content management
-bool TRMNLClient::updateContent() {
+bool TRMNLClient::updateContent(bool forceRedraw) {
     if (!isWiFiConnected()) {
         setState(STATE_OFFLINE);
         return false;
@@ -399,21 +542,48 @@ bool TRMNLClient::updateContent() {
 
     DisplayResponse response;
     if (callDisplayAPI(response)) {
+        // Same screen as the one still on the panel: skip download and refresh,
+        // unless asked to redraw it (manual refresh, invert toggle); the
+        // cached copy is enough for that
+        bool unchanged = response.filename.length() > 0 &&
+                         CacheIndex::storedName(response.filename.c_str()) == lastImageFilename &&
+                         isPanelShowingLastImage();
+        if (unchanged && (!forceRedraw || displayCachedContent())) {
+            #if DEBUG_ENABLED
+            Serial.printf("Content unchanged (%s), %s\n", response.filename.c_str(),
+                          forceRedraw ? "redrawn from cache" : "skipping refresh");
+            #endif
+            if (unchangedCycles < UINT8_MAX) unchangedCycles++;
+            lastUpdateTime = millis();
+            consecutiveErrors = 0;
+            offlineScheduler.recordRadioSuccess();
+            OtaUpdater::confirmHealthy();
+            return true;
+        }
+
         if (response.imageUrl.length() > 0) {
             // Download, aber Puffer erst NACH TLS/GET-Header allozieren
             uint8_t* imageBuffer = nullptr;
             size_t imageSize = 0;
             if (downloadImageAutoAlloc(response.imageUrl, &imageBuffer, &imageSize)) {
                 hardware->displayImage(imageBuffer, imageSize);
+                shownPanelGeneration = hardware->getPanelGeneration();
+                unchangedCycles = 0;
 
                 // Cache die Bilddaten falls aktiviert
-                if (CACHE_ENABLED && response.filename.length() > 0) {
-                    cacheImage(response.filename, imageBuffer, imageSize);
+                if (CACHE_ENABLED && response.filename.length() > 0 &&
+                    cacheImage(response.filename, imageBuffer, imageSize)) {
+                    // Offline rotation continues from the screen shown now
+                    const CacheEntry* entry = cacheIndex.find(response.filename.c_str());
+                    if (entry) offlineScheduler.setRotationCursor(entry->seq);
                 }
 
-                lastImageFilename = response.filename;
+                // Stored name: fits the wake snapshot and names the cached file
+                lastImageFilename = CacheIndex::storedName(response.filename.c_str());
                 lastUpdateTime = millis();
                 consecutiveErrors = 0;
+                offlineScheduler.recordRadioSuccess();
+                OtaUpdater::confirmHealthy();
                 free(imageBuffer);
                 return true;
             } else {
@@ -441,44 +611,119 @@ bool TRMNLClient::hasNewContent() {
 }
 
 void TRMNLClient::forceRefresh() {
-    updateContent();
+    updateContent(true);
 }
 
 // Offline mode
 bool TRMNLClient::enterOfflineMode() {
     setState(STATE_OFFLINE);
-    return displayCachedContent();
+    offlineScheduler.recordRadioFailure();
+    queueLog(String("offline: ") + lastError);
+    return displayNextCachedImage();
+}
+
+bool TRMNLClient::clearCache(StorageProgressCallback progress, void* context) {
+    bool ok = hardware->wipeCache(progress, context);
+    // Forget the in-memory index too so a later save doesn't resurrect it
+    cacheIndex.clear();
+    offlineScheduler.setRotationCursor(UINT32_MAX);
+    lastImageFilename = "";
+    return ok;
+}
+
+bool TRMNLClient::shouldAttemptRadio() {
+    return offlineScheduler.shouldAttemptRadio();
+}
+
+bool TRMNLClient::displayNextCachedImage() {
+    return displayRotatedImage(true);
+}
+
+bool TRMNLClient::displayPreviousCachedImage() {
+    return displayRotatedImage(false);
+}
+
+bool TRMNLClient::displayRotatedImage(bool forward) {
+    if (!hardware->acquireSDCard()) {
+        return false;
+    }
+
+    // Walk the playlist in the order the server originally served it
+    loadCacheIndex();
+    uint32_t cursor = offlineScheduler.getRotationCursor();
+    const CacheEntry* entry = forward ? cacheIndex.nextInPlaylist(cursor)
+                                      : cacheIndex.prevInPlaylist(cursor);
+    uint8_t* imageBuffer = entry ? (uint8_t*)malloc(MAX_IMAGE_SIZE) : nullptr;
+    size_t imageSize = 0;
+    bool loaded = imageBuffer && loadCachedScreen(entry->filename, imageBuffer, MAX_IMAGE_SIZE, &imageSize);
+
+    if (entry) {
+        offlineScheduler.setRotationCursor(entry->seq);
+        if (loaded) {
+            lastImageFilename = entry->filename;
+        } else if (imageBuffer) {
+            // Image vanished from the card; drop it so the rotation moves on
+            cacheIndex.remove(entry->filename);
+            cacheIndex.save(hardware);
+        }
+    }
+
+    // Card is not needed while the panel refreshes
+    hardware->releaseSDCard();
+
+    if (loaded) {
+        #if DEBUG_ENABLED
+        Serial.printf("Offline rotation: showing %s\n", lastImageFilename.c_str());
+        #endif
+        hardware->displayImage(imageBuffer, imageSize);
+        shownPanelGeneration = hardware->getPanelGeneration();
+    }
+    if (imageBuffer) free(imageBuffer);
+    return loaded;
 }
 
 bool TRMNLClient::displayCachedContent() {
-    if (!hardware->isSDCardAvailable() || lastImageFilename.length() == 0) {
+    if (lastImageFilename.length() == 0 || !hardware->acquireSDCard()) {
         return false;
     }
 
     uint8_t* imageBuffer = (uint8_t*)malloc(MAX_IMAGE_SIZE);
     if (imageBuffer) {
         size_t imageSize;
-        if (loadCachedImage(lastImageFilename, imageBuffer, MAX_IMAGE_SIZE, &imageSize)) {
+        bool loaded = loadCachedScreen(lastImageFilename, imageBuffer, MAX_IMAGE_SIZE, &imageSize);
+        // Card is not needed while the panel refreshes
+        hardware->releaseSDCard();
+        if (loaded) {
             hardware->displayImage(imageBuffer, imageSize);
+            shownPanelGeneration = hardware->getPanelGeneration();
             free(imageBuffer);
             return true;
         }
         free(imageBuffer);
+        return false;
     }
 
+    hardware->releaseSDCard();
     return false;
 }
 
+bool TRMNLClient::isPanelShowingLastImage() const {
+    return lastImageFilename.length() > 0 &&
+           shownPanelGeneration == hardware->getPanelGeneration();
+}
+
 bool TRMNLClient::hasCachedContent() {
-    return hardware->isSDCardAvailable() &&
-           lastImageFilename.length() > 0 &&
-           isCacheValid(lastImageFilename);
+    if (!hardware->acquireSDCard()) return false;
+    bool cached = (lastImageFilename.length() > 0 && isCacheValid(lastImageFilename)) ||
+                  (loadCacheIndex() && cacheIndex.size() > 0);
+    hardware->releaseSDCard();
+    return cached;
 }
 
 // Settings
 void TRMNLClient::setRefreshRate(int seconds) {
     refreshRate = seconds;
-    hardware->saveInt("refresh_rate", refreshRate);
+    hardware->getSettings().setRefreshRate(refreshRate);
 }
 
 // Error handling
@@ -496,8 +741,12 @@ void TRMNLClient::printStatus() {
     Serial.printf("MAC: %s\n", macAddress.c_str());
     Serial.printf("API Key: %s\n", apiKey.length() > 0 ? "Set" : "Not Set");
     Serial.printf("Friendly ID: %s\n", friendlyId.c_str());
+    Serial.printf("API: %s (%s)\n", getApiBaseUrl().c_str(), isPlainHttp() ? "plain HTTP" : "HTTPS");
     Serial.printf("Refresh Rate: %d seconds\n", refreshRate);
     Serial.printf("Consecutive Errors: %d\n", consecutiveErrors);
+    Serial.printf("Radio breaker: state %d, %u failures, next trial in %lu s\n",
+                  offlineScheduler.getBreakerState(), offlineScheduler.getRadioFailures(),
+                  (unsigned long)offlineScheduler.getSecondsUntilRadio());
     Serial.printf("Last Error: %s\n", lastError.c_str());
     Serial.println("==========================");
     #endif
@@ -533,12 +782,15 @@ bool TRMNLClient::callSetupAPI(SetupResponse& response) {
     macAddress = hardware->getMacAddress();
 
     // Build GET URL with query parameters
-    String url = String(TRMNL_API_BASE_URL) + TRMNL_API_SETUP_ENDPOINT +
+    String url = getApiBaseUrl() + TRMNL_API_SETUP_ENDPOINT +
                  "?mac=" + macAddress +
                  "&firmware_version=" + String(FIRMWARE_VERSION) +
                  "&device_type=paperdink";
 
-    httpClient.begin(wifiClient, url);
+    EnergyModel::setTransport(isPlainHttp() ? API_TRANSPORT_PLAIN : API_TRANSPORT_TLS);
+    WiFiClient* transport = transportFor(url);
+    if (!transport) return false;
+    httpClient.begin(*transport, url);
     httpClient.addHeader("Accept", "application/json");
     httpClient.addHeader("Accept-Encoding", "identity"); // avoid gzip/deflate
     httpClient.addHeader("User-Agent", "paperdink-trmnl/1.0");
@@ -550,7 +802,7 @@ bool TRMNLClient::callSetupAPI(SetupResponse& response) {
     httpClient.setReuse(false);
 
     // Increase timeout and add simple retry loop for robustness
-    httpClient.setTimeout(45000); // 45 seconds
+    httpClient.setTimeout(WakeWatchdog::clampTimeout(45000)); // 45 seconds
 
     #if DEBUG_ENABLED
     Serial.printf("Setup GET URL: %s\n", url.c_str());
@@ -635,9 +887,13 @@ bool TRMNLClient::callSetupAPI(SetupResponse& response) {
 
 bool TRMNLClient::callDisplayAPI(DisplayResponse& response) {
     if (!isWiFiConnected() || apiKey.length() == 0) return false;
+    PROFILE_SCOPE("api.display");
 
-    String url = String(TRMNL_API_BASE_URL) + TRMNL_API_DISPLAY_ENDPOINT;
-    httpClient.begin(wifiClient, url);
+    String url = getApiBaseUrl() + TRMNL_API_DISPLAY_ENDPOINT;
+    EnergyModel::setTransport(isPlainHttp() ? API_TRANSPORT_PLAIN : API_TRANSPORT_TLS);
+    WiFiClient* transport = transportFor(url);
+    if (!transport) return false;
+    httpClient.begin(*transport, url);
     // No Content-Type for GET; accept image or JSON
     httpClient.addHeader("Accept", "image/*, application/json");
     httpClient.addHeader("Accept-Encoding", "identity"); // avoid gzip/deflate
@@ -647,18 +903,25 @@ bool TRMNLClient::callDisplayAPI(DisplayResponse& response) {
     if (friendlyId.length() > 0) {
         httpClient.addHeader("X-Friendly-Id", friendlyId);
     }
+    // Energy estimate of recent cycles (see EnergyModel)
+    if (EnergyModel::getAverageCycleMah() > 0.0f) {
+        httpClient.addHeader("X-Energy-Per-Cycle", String(EnergyModel::getAverageCycleMah(), 4));
+        httpClient.addHeader("X-Battery-Days", String(EnergyModel::projectedDays(hardware->getBatteryPercentage()), 1));
+    }
     httpClient.addHeader("Connection", "close");
     httpClient.useHTTP10(true); // HTTP/1.0 to avoid keep-alive
     httpClient.setFollowRedirects(HTTPC_STRICT_FOLLOW_REDIRECTS);
     httpClient.setReuse(false);
-    httpClient.setTimeout(45000);
+    httpClient.setTimeout(WakeWatchdog::clampTimeout(45000));
 
     #if DEBUG_ENABLED
     Serial.printf("Display API URL: %s\n", url.c_str());
     #endif
 
+    // Retries only pay off while the network is healthy; during an outage
+    // each wake (or breaker trial) makes a single attempt
     int httpResponseCode = -1;
-    const int maxRetries = 3;
+    const int maxRetries = offlineScheduler.getRadioAttempts(DISPLAY_API_MAX_ATTEMPTS);
     for (int attempt = 1; attempt <= maxRetries; ++attempt) {
         httpResponseCode = httpClient.GET();
         #if DEBUG_ENABLED
@@ -688,6 +951,8 @@ bool TRMNLClient::callDisplayAPI(DisplayResponse& response) {
             response.filename = responseDoc["filename"] | "";
             response.updateFirmware = responseDoc["update_firmware"] | false;
             response.firmwareUrl = responseDoc["firmware_url"] | "";
+            response.firmwareSha256 = responseDoc["firmware_sha256"] | "";
+            response.firmwareDeltaUrl = responseDoc["firmware_delta_url"] | "";
             response.refreshRate = responseDoc["refresh_rate"] | refreshRate;
             response.resetFirmware = responseDoc["reset_firmware"] | false;
             response.error = responseDoc["error"] | "";
@@ -699,14 +964,23 @@ bool TRMNLClient::callDisplayAPI(DisplayResponse& response) {
 
             bool success = (response.status == 200) || (response.imageUrl.length() > 0 && response.error.length() == 0);
 
+            // Installed after the refresh, once the new screen is up
+            if (response.updateFirmware && response.firmwareUrl.length() > 0) {
+                offeredFirmwareUrl = response.firmwareUrl;
+                offeredFirmwareSha256 = response.firmwareSha256;
+                offeredFirmwareDeltaUrl = response.firmwareDeltaUrl;
+            } else {
+                offeredFirmwareUrl = "";
+                offeredFirmwareSha256 = "";
+                offeredFirmwareDeltaUrl = "";
+            }
+
             // If backend signals firmware reset, clear registration to force setup on next loop
             if (response.resetFirmware) {
                 #if DEBUG_ENABLED
                 Serial.println("Backend requested firmware reset; clearing registration and scheduling re-setup");
                 #endif
                 clearDeviceRegistration();
-                // Small delay to ensure NVS write completes before next cycle
-                delay(100);
             }
 
             #if DEBUG_ENABLED
@@ -725,6 +999,8 @@ bool TRMNLClient::callDisplayAPI(DisplayResponse& response) {
             response.filename = "";
             response.updateFirmware = false;
             response.firmwareUrl = "";
+            response.firmwareSha256 = "";
+            response.firmwareDeltaUrl = "";
             response.refreshRate = refreshRate;
             response.resetFirmware = false;
             response.error = "";
@@ -748,13 +1024,15 @@ bool TRMNLClient::callDisplayAPI(DisplayResponse& response) {
 bool TRMNLClient::downloadImage(const String& imageUrl, uint8_t* buffer, size_t maxSize, size_t* actualSize) {
     if (!isWiFiConnected() || imageUrl.length() == 0) return false;
 
-    httpClient.begin(wifiClient, imageUrl);
+    WiFiClient* transport = transportFor(imageUrl);
+    if (!transport) return false;
+    httpClient.begin(*transport, imageUrl);
     httpClient.addHeader("Accept", "image/*");
     httpClient.addHeader("access-token", apiKey);
     httpClient.addHeader("Connection", "close");
     httpClient.addHeader("User-Agent", "paperdink-trmnl/1.0");
     httpClient.useHTTP10(true);
-    httpClient.setTimeout(30000);
+    httpClient.setTimeout(WakeWatchdog::clampTimeout(30000));
 
     #if DEBUG_ENABLED
     Serial.printf("Downloading image: %s\n", imageUrl.c_str());
@@ -771,7 +1049,7 @@ bool TRMNLClient::downloadImage(const String& imageUrl, uint8_t* buffer, size_t
         Serial.printf("Image HTTP 200, Content-Length: %d\n", contentLength);
         #endif
 
-        while (httpClient.connected() && bytesRead < maxSize) {
+        while (httpClient.connected() && bytesRead < maxSize && !WakeWatchdog::expired()) {
             size_t available = stream->available();
             if (available) {
                 size_t toRead = min(available, maxSize - bytesRead);
@@ -804,7 +1082,10 @@ bool TRMNLClient::downloadImage(const String& imageUrl, uint8_t* buffer, size_t
 bool TRMNLClient::sendLogs(const String& logData) {
     if (!isWiFiConnected() || apiKey.length() == 0) return false;
 
-    httpClient.begin(wifiClient, String(TRMNL_API_BASE_URL) + TRMNL_API_LOGS_ENDPOINT);
+    String url = getApiBaseUrl() + TRMNL_API_LOGS_ENDPOINT;
+    WiFiClient* transport = transportFor(url);
+    if (!transport) return false;
+    httpClient.begin(*transport, url);
     httpClient.addHeader("Content-Type", "application/json");
     httpClient.addHeader("Authorization", String("Bearer ") + apiKey);
     httpClient.addHeader("User-Agent", "paperdink-trmnl/1.0");
@@ -824,32 +1105,100 @@ bool TRMNLClient::sendLogs(const String& logData) {
 }
 
 // Cache implementation
+String TRMNLClient::cacheFilePath(const String& filename, const char* suffix) {
+    return String(CACHE_DIR) + "/" + CacheIndex::storedName(filename.c_str()) + suffix;
+}
+
 bool TRMNLClient::cacheImage(const String& filename, const uint8_t* imageData, size_t imageSize) {
-    if (!hardware->isSDCardAvailable()) return false;
+    if (!hardware->acquireSDCard()) return false;
+
+    loadCacheIndex();
+    hardware->createDirectory(CACHE_DIR);
+    String cachePath = cacheFilePath(filename);
+    bool ok = hardware->writeFile(cachePath.c_str(), imageData, imageSize);
+
+    if (ok) {
+        // Record playlist position and recency; evict the LRU screen when full
+        String evicted;
+        if (!cacheIndex.touch(filename.c_str(), imageSize, &evicted)) {
+            deleteCachedScreen(evicted);
+        }
+        cacheIndex.save(hardware);
+    }
 
-    String cachePath = "/cache/" + filename;
-    return hardware->writeFile(cachePath.c_str(), imageData, imageSize);
+    hardware->releaseSDCard();
+    return ok;
 }
 
 bool TRMNLClient::loadCachedImage(const String& filename, uint8_t* buffer, size_t maxSize, size_t* actualSize) {
     if (!hardware->isSDCardAvailable()) return false;
 
-    String cachePath = "/cache/" + filename;
+    String cachePath = cacheFilePath(filename);
     return hardware->readFile(cachePath.c_str(), buffer, maxSize, actualSize);
 }
 
+bool TRMNLClient::loadCachedScreen(const String& filename, uint8_t* buffer, size_t maxSize, size_t* actualSize) {
+    // Prefer the pre-rendered frame: no PNG decode on the display path
+    const CacheEntry* entry = cacheIndex.find(filename.c_str());
+    if (entry && entry->frameFlags == currentFrameFlags() && maxSize >= DISPLAY_FRAME_BYTES) {
+        String framePath = cacheFilePath(filename, ".raw");
+        size_t frameSize = 0;
+        if (hardware->readFile(framePath.c_str(), buffer, DISPLAY_FRAME_BYTES, &frameSize) &&
+            frameSize == DISPLAY_FRAME_BYTES) {
+            if (actualSize) *actualSize = frameSize;
+            return true;
+        }
+    }
+    return loadCachedImage(filename, buffer, maxSize, actualSize);
+}
+
+bool TRMNLClient::storeRenderedFrame(const String& filename, const uint8_t* imageData, size_t imageSize) {
+    uint8_t* frame = (uint8_t*)malloc(DISPLAY_FRAME_BYTES);
+    if (!frame) return false;
+
+    bool ok = hardware->renderImageToFrame(imageData, imageSize, frame);
+    if (ok) {
+        String framePath = cacheFilePath(filename, ".raw");
+        ok = hardware->writeFile(framePath.c_str(), frame, DISPLAY_FRAME_BYTES);
+    }
+    free(frame);
+
+    cacheIndex.setFrameFlags(filename.c_str(), ok ? currentFrameFlags() : 0);
+    return ok;
+}
+
+void TRMNLClient::deleteCachedScreen(const String& filename) {
+    hardware->deleteFile(cacheFilePath(filename).c_str());
+    hardware->deleteFile(cacheFilePath(filename, ".raw").c_str());
+}
+
+uint8_t TRMNLClient::currentFrameFlags() {
+    return CACHE_FRAME_RENDERED | (hardware->getInvertDisplay() ? CACHE_FRAME_INVERTED : 0);
+}
+
+bool TRMNLClient::loadCacheIndex() {
+    // Loaded once per wake; a missing index simply starts empty
+    if (!cacheIndex.isLoaded()) {
+        cacheIndex.load(hardware);
+    }
+    return cacheIndex.size() > 0;
+}
+
 bool TRMNLClient::downloadImageAutoAlloc(const String& imageUrl, uint8_t** outBuffer, size_t* outSize) {
     if (!isWiFiConnected() || imageUrl.length() == 0) return false;
+    PROFILE_SCOPE("download");
     *outBuffer = nullptr;
     if (outSize) *outSize = 0;
 
-    httpClient.begin(wifiClient, imageUrl);
+    WiFiClient* transport = transportFor(imageUrl);
+    if (!transport) return false;
+    httpClient.begin(*transport, imageUrl);
     httpClient.addHeader("Accept", "image/*");
     httpClient.addHeader("access-token", apiKey);
     httpClient.addHeader("Connection", "close");
     httpClient.addHeader("User-Agent", "paperdink-trmnl/1.0");
     httpClient.useHTTP10(true);
-    httpClient.setTimeout(30000);
+    httpClient.setTimeout(WakeWatchdog::clampTimeout(30000));
 
     #if DEBUG_ENABLED
     Serial.printf("Downloading image (auto alloc): %s\n", imageUrl.c_str());
@@ -894,7 +1243,7 @@ bool TRMNLClient::downloadImageAutoAlloc(const String& imageUrl, uint8_t** outBu
     size_t bytesRead = 0;
     const size_t maxSize = allocSize;
 
-    while (httpClient.connected()) {
+    while (httpClient.connected() && !WakeWatchdog::expired()) {
         size_t available = stream->available();
         if (!available) {
             if (!stream->connected()) break;
@@ -937,18 +1286,225 @@ bool TRMNLClient::downloadImageAutoAlloc(const String& imageUrl, uint8_t** outBu
 bool TRMNLClient::isCacheValid(const String& filename) {
     if (!hardware->isSDCardAvailable()) return false;
 
-    String cachePath = "/cache/" + filename;
+    String cachePath = cacheFilePath(filename);
     return hardware->fileExists(cachePath.c_str());
 }
 
 void TRMNLClient::cleanupCache() {
-    // Simple cache cleanup - could be enhanced
-    if (!hardware->isSDCardAvailable()) return;
+    if (!hardware->acquireSDCard()) return;
 
-    // TODO: Implement cache cleanup logic
+    // Drop index entries whose image is gone from the card
+    loadCacheIndex();
+    for (int i = cacheIndex.size() - 1; i >= 0; i--) {
+        const CacheEntry* entry = cacheIndex.entryAt(i);
+        if (!isCacheValid(entry->filename)) {
+            #if DEBUG_ENABLED
+            Serial.printf("Cache cleanup: dropping missing %s\n", entry->filename);
+            #endif
+            cacheIndex.remove(entry->filename);
+        }
+    }
+    cacheIndex.save(hardware);
+
+    hardware->releaseSDCard();
+}
+
+// Charging mode
+void TRMNLClient::beginChargingWarmup() {
     #if DEBUG_ENABLED
-    Serial.println("Cache cleanup not implemented yet");
+    Serial.println("Charging: starting cache warm-up");
     #endif
+
+    if (hardware->acquireSDCard()) {
+        loadCacheIndex();
+        hardware->releaseSDCard();
+    }
+    warmupStage = WARMUP_PLAYLIST;
+    warmupItems = 0;
+    warmupRenderSlot = 0;
+    warmupStartClock = cacheIndex.getUseClock();
+    warmupFullCycle = false;
+}
+
+bool TRMNLClient::runChargingWarmupStep() {
+    switch (warmupStage) {
+        case WARMUP_PLAYLIST:
+            if (!warmupFetchNextItem()) {
+                warmupStage = WARMUP_PRUNE;
+            }
+            break;
+
+        case WARMUP_PRUNE:
+            warmupPruneStale();
+            warmupStage = WARMUP_RENDER;
+            break;
+
+        case WARMUP_RENDER:
+            if (!warmupRenderNext()) {
+                warmupStage = WARMUP_LOGS;
+            }
+            break;
+
+        case WARMUP_LOGS:
+            flushLogs();
+            warmupStage = WARMUP_DONE;
+            #if DEBUG_ENABLED
+            Serial.printf("Charging: warm-up done (%u playlist items, full cycle: %s)\n",
+                          warmupItems, warmupFullCycle ? "yes" : "no");
+            #endif
+            break;
+
+        default:
+            return false;
+    }
+    return warmupStage != WARMUP_DONE;
+}
+
+void TRMNLClient::endChargingWarmup() {
+    #if DEBUG_ENABLED
+    if (warmupStage != WARMUP_IDLE && warmupStage != WARMUP_DONE) {
+        Serial.printf("Charging ended: stopping warm-up at stage %d\n", warmupStage);
+    }
+    #endif
+    // Every step leaves the cache and index consistent, so stopping is safe
+    warmupStage = WARMUP_IDLE;
+}
+
+bool TRMNLClient::warmupFetchNextItem() {
+    if (warmupItems >= CHARGING_PREFETCH_MAX_ITEMS) return false;
+
+    // Each display call advances the playlist by one item
+    DisplayResponse response;
+    if (!callDisplayAPI(response) || response.imageUrl.length() == 0 || response.filename.length() == 0) {
+        return false;
+    }
+    warmupItems++;
+
+    if (!hardware->acquireSDCard()) return false;
+    loadCacheIndex();
+
+    const CacheEntry* entry = cacheIndex.find(response.filename.c_str());
+    if (entry && entry->lastUsed > warmupStartClock) {
+        // Served twice during this walk: we have seen the whole playlist
+        warmupFullCycle = true;
+        hardware->releaseSDCard();
+        return false;
+    }
+
+    bool fetched = true;
+    if (entry && isCacheValid(response.filename)) {
+        // Unchanged screen: only refresh its recency
+        cacheIndex.touch(response.filename.c_str(), entry->size, nullptr);
+        cacheIndex.save(hardware);
+    } else {
+        // Card is not needed while downloading
+        hardware->releaseSDCard();
+        uint8_t* imageBuffer = nullptr;
+        size_t imageSize = 0;
+        fetched = downloadImageAutoAlloc(response.imageUrl, &imageBuffer, &imageSize);
+        hardware->acquireSDCard();
+        if (fetched && cacheImage(response.filename, imageBuffer, imageSize)) {
+            storeRenderedFrame(response.filename, imageBuffer, imageSize);
+            cacheIndex.save(hardware);
+        }
+        if (imageBuffer) free(imageBuffer);
+    }
+
+    hardware->releaseSDCard();
+
+    #if DEBUG_ENABLED
+    Serial.printf("Charging: playlist item %u '%s' %s\n", warmupItems, response.filename.c_str(),
+                  fetched ? "cached" : "failed");
+    #endif
+    return fetched;
+}
+
+void TRMNLClient::warmupPruneStale() {
+    // Only a complete walk proves which screens left the playlist
+    if (!warmupFullCycle || !hardware->acquireSDCard()) return;
+
+    for (int i = cacheIndex.size() - 1; i >= 0; i--) {
+        const CacheEntry* entry = cacheIndex.entryAt(i);
+        if (entry->lastUsed <= warmupStartClock) {
+            String filename = entry->filename;
+            #if DEBUG_ENABLED
+            Serial.printf("Charging: pruning stale %s\n", filename.c_str());
+            #endif
+            deleteCachedScreen(filename);
+            cacheIndex.remove(filename.c_str());
+        }
+    }
+    cacheIndex.save(hardware);
+    hardware->releaseSDCard();
+}
+
+bool TRMNLClient::warmupRenderNext() {
+    if (!hardware->acquireSDCard()) return false;
+
+    // Find the next cached screen whose frame is missing or stale
+    uint8_t flags = currentFrameFlags();
+    const CacheEntry* entry = nullptr;
+    while (warmupRenderSlot < cacheIndex.size()) {
+        const CacheEntry* candidate = cacheIndex.entryAt(warmupRenderSlot++);
+        if (candidate->frameFlags != flags) {
+            entry = candidate;
+            break;
+        }
+    }
+
+    if (entry) {
+        String filename = entry->filename;
+        uint8_t* imageBuffer = (uint8_t*)malloc(MAX_IMAGE_SIZE);
+        size_t imageSize = 0;
+        if (imageBuffer && loadCachedImage(filename, imageBuffer, MAX_IMAGE_SIZE, &imageSize)) {
+            storeRenderedFrame(filename, imageBuffer, imageSize);
+            cacheIndex.save(hardware);
+        }
+        if (imageBuffer) free(imageBuffer);
+    }
+
+    hardware->releaseSDCard();
+    return entry != nullptr;
+}
+
+// Buffered logs
+bool TRMNLClient::queueLog(const String& line) {
+    if (!hardware->acquireSDCard()) return false;
+
+    bool ok = false;
+    if (hardware->getFileSize(LOG_BUFFER_PATH) < LOG_BUFFER_MAX_BYTES) {
+        String entry = String(millis()) + " " + line + "\n";
+        hardware->createDirectory(LOG_BUFFER_DIR);
+        ok = hardware->appendFile(LOG_BUFFER_PATH, (const uint8_t*)entry.c_str(), entry.length());
+    }
+
+    hardware->releaseSDCard();
+    return ok;
+}
+
+bool TRMNLClient::flushLogs() {
+    if (!isWiFiConnected() || !hardware->acquireSDCard()) return false;
+
+    bool ok = true;
+    size_t logSize = hardware->getFileSize(LOG_BUFFER_PATH);
+    if (logSize > 0) {
+        char* logBuffer = (char*)malloc(LOG_BUFFER_MAX_BYTES + 1);
+        size_t bytesRead = 0;
+        ok = logBuffer && hardware->readFile(LOG_BUFFER_PATH, (uint8_t*)logBuffer, LOG_BUFFER_MAX_BYTES, &bytesRead);
+        if (ok) {
+            logBuffer[bytesRead] = '\0';
+            ok = sendLogs(String(logBuffer));
+            if (ok) hardware->deleteFile(LOG_BUFFER_PATH);
+        }
+        if (logBuffer) free(logBuffer);
+
+        #if DEBUG_ENABLED
+        Serial.printf("Buffered logs (%u bytes) upload: %s\n", (unsigned)logSize, ok ? "OK" : "FAIL");
+        #endif
+    }
+
+    hardware->releaseSDCard();
+    return ok;
 }
 
 // Firmware update functions
@@ -960,13 +1516,52 @@ bool TRMNLClient::checkForFirmwareUpdate() {
     return false;
 }
 
-bool TRMNLClient::performFirmwareUpdate(const String& firmwareUrl) {
-    // OTA update implementation would go here
+bool TRMNLClient::performFirmwareUpdate(const String& firmwareUrl, const String& expectedSha256,
+                                        const String& deltaUrl) {
     #if DEBUG_ENABLED
     Serial.printf("Firmware update requested: %s\n", firmwareUrl.c_str());
-    Serial.println("OTA update not implemented yet");
     #endif
-    return false;
+
+    if (!isWiFiConnected()) return false;
+
+    // A flat battery mid-write only costs a retry, but don't spend the charge
+    if (!hardware->isCharging() && hardware->getBatteryPercentage() < OTA_MIN_BATTERY_PERCENT) {
+        #if DEBUG_ENABLED
+        Serial.println("Battery too low for a firmware update, postponed");
+        #endif
+        return false;
+    }
+
+    String key = OtaUpdater::imageKey(firmwareUrl, expectedSha256);
+    if (OtaUpdater::isRejected(key)) {
+        #if DEBUG_ENABLED
+        Serial.println("Firmware image was rolled back before, skipped");
+        #endif
+        return false;
+    }
+
+    otaUpdater.setPlainHttpBase(isPlainHttp() ? getApiBaseUrl() : String());
+    bool ok = otaUpdater.update(firmwareUrl, expectedSha256, apiKey, deltaUrl);
+    queueLog(ok ? String("ota installed ") + key + (otaUpdater.wasDelta() ? " (delta)" : "")
+                : String("ota failed: ") + otaUpdater.getLastError());
+    if (!ok) {
+        lastError = "firmware update failed";
+        return false;
+    }
+
+    hardware->restart();
+    return true;
+}
+
+bool TRMNLClient::installOfferedFirmware() {
+    if (offeredFirmwareUrl.length() == 0) return false;
+    String url = offeredFirmwareUrl;
+    String sha = offeredFirmwareSha256;
+    String deltaUrl = offeredFirmwareDeltaUrl;
+    offeredFirmwareUrl = "";
+    offeredFirmwareSha256 = "";
+    offeredFirmwareDeltaUrl = "";
+    return performFirmwareUpdate(url, sha, deltaUrl);
 }
 
 bool TRMNLClient::downloadFirmware(const String& firmwareUrl) {
@@ -976,12 +1571,14 @@ bool TRMNLClient::downloadFirmware(const String& firmwareUrl) {
 long TRMNLClient::getRemoteContentLength(const String& url) {
     if (!isWiFiConnected()) return -1;
     HTTPClient headClient;
-    headClient.begin(wifiClient, url);
+    WiFiClient* transport = transportFor(url);
+    if (!transport) return -1;
+    headClient.begin(*transport, url);
     headClient.addHeader("User-Agent", "paperdink-trmnl/1.0");
     headClient.addHeader("access-token", apiKey);
     headClient.addHeader("Accept", "image/*");
     headClient.useHTTP10(true);
-    headClient.setTimeout(15000);
+    headClient.setTimeout(WakeWatchdog::clampTimeout(15000));
     int code = headClient.sendRequest("HEAD");
     long len = -1;
     if (code > 0) {
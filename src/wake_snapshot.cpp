@@ -0,0 +1,50 @@
+#include "wake_snapshot.h"
+#include <rom/crc.h>
+
+static const uint32_t SNAPSHOT_MAGIC = 0x50445753;  // "PDWS"
+static const uint16_t SNAPSHOT_VERSION = 4;
+
+struct SnapshotImage {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size;
+    HardwareSnapshot hardware;
+    ClientSnapshot client;
+    uint32_t crc;  // Over everything above
+};
+
+static RTC_DATA_ATTR SnapshotImage s_snapshot;
+
+static uint32_t snapshotCrc(const SnapshotImage& image) {
+    return crc32_le(0, (const uint8_t*)&image, offsetof(SnapshotImage, crc));
+}
+
+bool WakeSnapshot::load(HardwareSnapshot* hardware, ClientSnapshot* client) {
+    if (s_snapshot.magic != SNAPSHOT_MAGIC ||
+        s_snapshot.version != SNAPSHOT_VERSION ||
+        s_snapshot.size != sizeof(SnapshotImage) ||
+        s_snapshot.crc != snapshotCrc(s_snapshot)) {
+        #if DEBUG_ENABLED
+        Serial.println("Wake snapshot: none or invalid, cold start");
+        #endif
+        return false;
+    }
+
+    *hardware = s_snapshot.hardware;
+    *client = s_snapshot.client;
+    return true;
+}
+
+void WakeSnapshot::store(const HardwareSnapshot& hardware, const ClientSnapshot& client) {
+    memset(&s_snapshot, 0, sizeof(s_snapshot));
+    s_snapshot.magic = SNAPSHOT_MAGIC;
+    s_snapshot.version = SNAPSHOT_VERSION;
+    s_snapshot.size = sizeof(SnapshotImage);
+    s_snapshot.hardware = hardware;
+    s_snapshot.client = client;
+    s_snapshot.crc = snapshotCrc(s_snapshot);
+}
+
+void WakeSnapshot::invalidate() {
+    s_snapshot.magic = 0;
+}
@@ -0,0 +1,165 @@
+#include "wake_watchdog.h"
+
+static RTC_DATA_ATTR WakeOverrun s_overrun = {};
+
+static esp_timer_handle_t s_softTimer = nullptr;
+static esp_timer_handle_t s_hardTimer = nullptr;
+static WakeWatchdog::ForcedSleepFn s_forcedSleep = nullptr;
+static volatile bool s_armed = false;
+static volatile bool s_expired = false;
+static uint32_t s_budgetMs = WAKE_BUDGET_MS;
+static int64_t s_deadlineUs = 0;
+
+// Open phases, innermost last; read from the esp_timer task at a deadline
+static const char* volatile s_phases[WAKE_WATCHDOG_PHASE_DEPTH];
+static volatile uint8_t s_phaseDepth = 0;
+
+static void recordOverrun(bool forced) {
+    uint8_t depth = s_phaseDepth;
+    const char* phase = depth > 0 ? s_phases[depth - 1] : "none";
+
+    // One overrun per wake; the hard deadline updates what the soft one
+    // recorded with the phase that actually hangs
+    if (!s_expired) {
+        s_overrun.count++;
+    }
+    strncpy(s_overrun.phase, phase, sizeof(s_overrun.phase) - 1);
+    s_overrun.phase[sizeof(s_overrun.phase) - 1] = '\0';
+    s_overrun.elapsedMs = (uint32_t)(esp_timer_get_time() / 1000);
+    s_overrun.forced = forced ? 1 : 0;
+    s_overrun.reported = 0;
+}
+
+static void onSoftDeadline(void*) {
+    if (!s_armed) return;
+    recordOverrun(false);
+    s_expired = true;
+
+    #if DEBUG_ENABLED
+    Serial.printf("Wake budget of %lu ms spent in phase '%s'\n",
+                  (unsigned long)s_budgetMs, s_overrun.phase);
+    #endif
+}
+
+static void onHardDeadline(void*) {
+    if (!s_armed) return;
+    recordOverrun(true);
+
+    #if DEBUG_ENABLED
+    Serial.printf("Wake still running in phase '%s': forcing deep sleep\n", s_overrun.phase);
+    Serial.flush();
+    #endif
+
+    if (s_forcedSleep) {
+        s_forcedSleep(WAKE_OVERRUN_RETRY_SECONDS);
+    }
+}
+
+bool WakeWatchdog::begin(ForcedSleepFn forcedSleep) {
+    s_forcedSleep = forcedSleep;
+    if (s_softTimer) return true;
+
+    esp_timer_create_args_t args = {};
+    args.callback = onSoftDeadline;
+    args.name = "wake-soft";
+    if (esp_timer_create(&args, &s_softTimer) != ESP_OK) {
+        s_softTimer = nullptr;
+        return false;
+    }
+
+    args.callback = onHardDeadline;
+    args.name = "wake-hard";
+    if (esp_timer_create(&args, &s_hardTimer) != ESP_OK) {
+        esp_timer_delete(s_softTimer);
+        s_softTimer = nullptr;
+        s_hardTimer = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void WakeWatchdog::arm(uint32_t budgetMs) {
+    #if WAKE_WATCHDOG_ENABLED
+    if (!s_softTimer) return;
+
+    esp_timer_stop(s_softTimer);
+    esp_timer_stop(s_hardTimer);
+    s_budgetMs = budgetMs;
+    s_expired = false;
+    s_deadlineUs = esp_timer_get_time() + (int64_t)budgetMs * 1000;
+    s_armed = true;
+    esp_timer_start_once(s_softTimer, (uint64_t)budgetMs * 1000);
+    esp_timer_start_once(s_hardTimer, (uint64_t)(budgetMs + WAKE_BUDGET_GRACE_MS) * 1000);
+    #else
+    (void)budgetMs;
+    #endif
+}
+
+void WakeWatchdog::extend() {
+    // An expired budget stays expired; the wake is already on its way to sleep
+    if (s_armed && !s_expired) {
+        arm(s_budgetMs);
+    }
+}
+
+void WakeWatchdog::suspend() {
+    if (!s_softTimer) return;
+    s_armed = false;
+    s_expired = false;
+    esp_timer_stop(s_softTimer);
+    esp_timer_stop(s_hardTimer);
+}
+
+bool WakeWatchdog::expired() {
+    return s_armed && s_expired;
+}
+
+bool WakeWatchdog::isArmed() {
+    return s_armed;
+}
+
+uint32_t WakeWatchdog::remainingMs() {
+    if (!s_armed) return UINT32_MAX;
+    int64_t left = s_deadlineUs - esp_timer_get_time();
+    return left > 0 ? (uint32_t)(left / 1000) : 0;
+}
+
+uint32_t WakeWatchdog::clampTimeout(uint32_t timeoutMs) {
+    uint32_t left = remainingMs();
+    if (left < 1000) left = 1000;
+    return timeoutMs < left ? timeoutMs : left;
+}
+
+void WakeWatchdog::enterPhase(const char* id) {
+    if (s_phaseDepth < WAKE_WATCHDOG_PHASE_DEPTH) {
+        s_phases[s_phaseDepth] = id;
+        s_phaseDepth = s_phaseDepth + 1;
+    }
+}
+
+void WakeWatchdog::leavePhase(const char* id) {
+    // Innermost open phase with this id; phases may close out of order
+    for (int i = s_phaseDepth - 1; i >= 0; i--) {
+        if (strcmp(s_phases[i], id) == 0) {
+            for (int j = i; j + 1 < s_phaseDepth; j++) {
+                s_phases[j] = s_phases[j + 1];
+            }
+            s_phaseDepth = s_phaseDepth - 1;
+            return;
+        }
+    }
+}
+
+bool WakeWatchdog::takeOverrunReport(String* line) {
+    if (s_overrun.count == 0 || s_overrun.reported) return false;
+    s_overrun.reported = 1;
+    if (line) {
+        *line = String("overrun ") + s_overrun.phase + " after " + String(s_overrun.elapsedMs) + " ms" +
+                (s_overrun.forced ? " (forced sleep)" : "") + ", #" + String(s_overrun.count);
+    }
+    return true;
+}
+
+const WakeOverrun& WakeWatchdog::getLastOverrun() {
+    return s_overrun;
+}
@@ -0,0 +1,443 @@
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <zlib.h>
+#include "delta_patch.h"
+#include "host_sha256.h"
+
+// The checked-in pair is two builds of a small C program (gcc -O2, stripped;
+// the second adds a function and changes a constant, so code and addresses
+// shift like they do between firmware releases). Point DELTA_BASE_BIN and
+// DELTA_TARGET_BIN at two firmware.bin builds to run the same test on those.
+// Patches come from tools/make_delta.py, the generator used on the server;
+// DELTA_PYTHON overrides the interpreter.
+static const char* BASE_BIN_FIXTURE = "fixtures/base.bin";
+static const char* TARGET_BIN_FIXTURE = "fixtures/target.bin";
+static const char* GENERATOR_SCRIPT = "../../tools/make_delta.py";
+
+typedef std::vector<uint8_t> Bytes;
+
+// Deterministic, so a failing split can be replayed
+struct Rng {
+    uint32_t state;
+    explicit Rng(uint32_t seed) : state(seed ? seed : 1) {}
+    uint32_t next() {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+    uint32_t below(uint32_t limit) { return limit ? next() % limit : 0; }
+};
+
+static void putU32(Bytes& out, uint32_t value) {
+    for (int i = 0; i < 4; i++) out.push_back((uint8_t)(value >> (8 * i)));
+}
+
+static void putRecord(Bytes& out, uint32_t diffLen, uint32_t extraLen, int32_t seek) {
+    putU32(out, diffLen);
+    putU32(out, extraLen);
+    putU32(out, (uint32_t)seek);
+}
+
+static bool loadFile(const char* path, Bytes& out) {
+    FILE* file = fopen(path, "rb");
+    if (!file) return false;
+    uint8_t buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        out.insert(out.end(), buffer, buffer + n);
+    }
+    fclose(file);
+    return !out.empty();
+}
+
+// Path next to this file, so the test runs from any working directory
+static std::string testPath(const char* relative) {
+    std::string file = __FILE__;
+    size_t slash = file.find_last_of("/\\");
+    return (slash == std::string::npos ? std::string(".") : file.substr(0, slash)) + "/" + relative;
+}
+
+// Runs tools/make_delta.py on two files and reads back the patch
+static bool generateDelta(const std::string& basePath, const std::string& targetPath, Bytes& out) {
+    const char* python = getenv("DELTA_PYTHON");
+    const char* tmp = getenv("TMPDIR");
+    std::string outPath = std::string(tmp ? tmp : "/tmp") + "/paperdink_test.delta";
+    std::string command = std::string(python ? python : "python3") + " \"" + testPath(GENERATOR_SCRIPT) +
+                          "\" \"" + basePath + "\" \"" + targetPath + "\" \"" + outPath + "\"";
+    if (system(command.c_str()) != 0) return false;
+    bool loaded = loadFile(outPath.c_str(), out);
+    remove(outPath.c_str());
+    return loaded;
+}
+
+static DeltaHeader makeHeader(const Bytes& base, const Bytes& target) {
+    DeltaHeader header;
+    header.baseSize = (uint32_t)base.size();
+    header.targetSize = (uint32_t)target.size();
+    HostSha256::digest(base.data(), base.size(), header.baseSha256);
+    HostSha256::digest(target.data(), target.size(), header.targetSha256);
+    return header;
+}
+
+// Valid records with random lengths and seeks (backwards and forwards), so
+// the patcher sees short and long runs and base reads all over the image
+static Bytes encodeRecords(const Bytes& base, const Bytes& target, Rng& rng) {
+    Bytes records;
+    uint32_t pos = 0;
+    uint32_t produced = 0;
+    while (produced < target.size()) {
+        uint32_t remaining = (uint32_t)target.size() - produced;
+        uint32_t diffLen = rng.below(8192);
+        if (diffLen > remaining) diffLen = remaining;
+        if (diffLen > base.size() - pos) diffLen = (uint32_t)base.size() - pos;
+        uint32_t extraLen = rng.below(4) == 0 ? rng.below(512) : 0;
+        if (extraLen > remaining - diffLen) extraLen = remaining - diffLen;
+        if (diffLen + extraLen == 0) extraLen = 1;
+
+        uint32_t next = rng.below((uint32_t)base.size());
+        int32_t seek = (int32_t)next - (int32_t)(pos + diffLen);
+        putRecord(records, diffLen, extraLen, seek);
+        for (uint32_t i = 0; i < diffLen; i++) {
+            records.push_back((uint8_t)(target[produced + i] - base[pos + i]));
+        }
+        produced += diffLen;
+        records.insert(records.end(), target.begin() + produced, target.begin() + produced + extraLen);
+        produced += extraLen;
+        pos = next;
+    }
+    return records;
+}
+
+// Header plus zlib stream, as served at firmware_delta_url
+static Bytes encodeDelta(const Bytes& base, const Bytes& target, Rng& rng) {
+    DeltaHeader header = makeHeader(base, target);
+    Bytes records = encodeRecords(base, target, rng);
+
+    Bytes file(DELTA_MAGIC, DELTA_MAGIC + 8);
+    putU32(file, header.baseSize);
+    putU32(file, header.targetSize);
+    file.insert(file.end(), header.baseSha256, header.baseSha256 + 32);
+    file.insert(file.end(), header.targetSha256, header.targetSha256 + 32);
+
+    uLongf compressedSize = compressBound(records.size());
+    Bytes compressed(compressedSize);
+    TEST_ASSERT_EQUAL(Z_OK, compress2(compressed.data(), &compressedSize, records.data(), records.size(), 9));
+    file.insert(file.end(), compressed.begin(), compressed.begin() + compressedSize);
+    return file;
+}
+
+struct PatchTarget {
+    const Bytes* base;
+    Bytes output;
+    bool failReads;
+    bool readOutOfRange;  // The patcher must bounds-check before reading
+};
+
+static bool readBase(void* context, uint32_t offset, uint8_t* buffer, size_t length) {
+    PatchTarget* target = (PatchTarget*)context;
+    if (offset + length > target->base->size()) {
+        target->readOutOfRange = true;
+        return false;
+    }
+    if (target->failReads) return false;
+    memcpy(buffer, target->base->data() + offset, length);
+    return true;
+}
+
+static bool writeTarget(void* context, const uint8_t* data, size_t length) {
+    PatchTarget* target = (PatchTarget*)context;
+    target->output.insert(target->output.end(), data, data + length);
+    return true;
+}
+
+// Inflates the delta the way the device does: input and output in random
+// pieces, every inflated run handed to the patcher as it comes
+static bool applyDelta(const Bytes& file, const Bytes& base, Rng& rng, PatchTarget* target) {
+    DeltaHeader header;
+    if (!parseDeltaHeader(file.data(), file.size(), &header)) return false;
+
+    target->base = &base;
+    target->output.clear();
+    target->failReads = false;
+    target->readOutOfRange = false;
+    DeltaPatcher patcher(readBase, writeTarget, target);
+    patcher.begin(header);
+
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (inflateInit(&stream) != Z_OK) return false;
+
+    size_t offset = DELTA_HEADER_SIZE;
+    uint8_t window[4096];
+    int status = Z_OK;
+    while (status == Z_OK) {
+        if (stream.avail_in == 0 && offset < file.size()) {
+            size_t piece = 1 + rng.below(1500);
+            if (piece > file.size() - offset) piece = file.size() - offset;
+            stream.next_in = (Bytef*)file.data() + offset;
+            stream.avail_in = (uInt)piece;
+            offset += piece;
+        }
+        stream.next_out = window;
+        stream.avail_out = 1 + rng.below(sizeof(window));
+        uInt before = stream.avail_out;
+        status = inflate(&stream, Z_NO_FLUSH);
+        size_t produced = before - stream.avail_out;
+        if (produced > 0 && !patcher.feed(window, produced)) break;
+        // Out of input with nothing produced: truncated stream
+        if (status == Z_BUF_ERROR || (status == Z_OK && produced == 0 && offset == file.size() &&
+                                      stream.avail_in == 0)) {
+            break;
+        }
+    }
+    inflateEnd(&stream);
+    return status == Z_STREAM_END && patcher.isComplete() && !patcher.hasFailed();
+}
+
+// Applies a patch in several split patterns; each must rebuild the target
+static void assertDeltaRebuildsTarget(const Bytes& file, const Bytes& base, const Bytes& target,
+                                      uint32_t seed) {
+    DeltaHeader header;
+    TEST_ASSERT_TRUE(parseDeltaHeader(file.data(), file.size(), &header));
+    TEST_ASSERT_EQUAL_UINT32(base.size(), header.baseSize);
+    TEST_ASSERT_EQUAL_UINT32(target.size(), header.targetSize);
+    uint8_t sha[32];
+    HostSha256::digest(base.data(), base.size(), sha);
+    TEST_ASSERT_EQUAL_MEMORY(sha, header.baseSha256, 32);
+    HostSha256::digest(target.data(), target.size(), sha);
+    TEST_ASSERT_EQUAL_MEMORY(sha, header.targetSha256, 32);
+
+    for (uint32_t run = 0; run < 4; run++) {
+        Rng splits(seed * 31 + run);
+        PatchTarget patched;
+        TEST_ASSERT_TRUE(applyDelta(file, base, splits, &patched));
+        TEST_ASSERT_EQUAL_UINT32(header.targetSize, patched.output.size());
+        uint8_t outputSha[32];
+        HostSha256::digest(patched.output.data(), patched.output.size(), outputSha);
+        TEST_ASSERT_EQUAL_MEMORY(header.targetSha256, outputSha, 32);
+    }
+}
+
+static void assertPatchRebuildsTarget(const Bytes& base, const Bytes& target, uint32_t seed) {
+    Rng rng(seed);
+    assertDeltaRebuildsTarget(encodeDelta(base, target, rng), base, target, seed);
+}
+
+// A firmware-like pair: mostly shared code with an inserted function,
+// scattered changed words (relocated addresses) and a removed block
+static void makeImagePair(Bytes& base, Bytes& target) {
+    Rng rng(0x5eed);
+    base.resize(320 * 1024);
+    for (size_t i = 0; i < base.size(); i++) {
+        base[i] = (i % 64 < 48) ? (uint8_t)rng.next() : (uint8_t)(i >> 6);
+    }
+    target.assign(base.begin(), base.begin() + 100000);
+    for (int i = 0; i < 7000; i++) target.push_back((uint8_t)rng.next());
+    target.insert(target.end(), base.begin() + 100000, base.begin() + 250000);
+    target.insert(target.end(), base.begin() + 262144, base.end());
+    for (size_t i = 0; i < target.size(); i += 997) target[i] ^= 0x5a;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_header_parse(void) {
+    Bytes base(1000, 1), target(1200, 2);
+    Rng rng(1);
+    Bytes file = encodeDelta(base, target, rng);
+
+    DeltaHeader header;
+    TEST_ASSERT_TRUE(parseDeltaHeader(file.data(), file.size(), &header));
+    TEST_ASSERT_EQUAL_UINT32(1000, header.baseSize);
+    TEST_ASSERT_EQUAL_UINT32(1200, header.targetSize);
+    TEST_ASSERT_FALSE(parseDeltaHeader(file.data(), DELTA_HEADER_SIZE - 1, &header));
+
+    Bytes badMagic = file;
+    badMagic[7] = '2';
+    TEST_ASSERT_FALSE(parseDeltaHeader(badMagic.data(), badMagic.size(), &header));
+
+    Bytes emptyTarget = file;
+    memset(emptyTarget.data() + 12, 0, 4);
+    TEST_ASSERT_FALSE(parseDeltaHeader(emptyTarget.data(), emptyTarget.size(), &header));
+}
+
+void test_generated_delta_real_pair(void) {
+    const char* baseEnv = getenv("DELTA_BASE_BIN");
+    const char* targetEnv = getenv("DELTA_TARGET_BIN");
+    std::string basePath = baseEnv ? baseEnv : testPath(BASE_BIN_FIXTURE);
+    std::string targetPath = targetEnv ? targetEnv : testPath(TARGET_BIN_FIXTURE);
+    Bytes base, target;
+    TEST_ASSERT_TRUE_MESSAGE(loadFile(basePath.c_str(), base), "base image missing");
+    TEST_ASSERT_TRUE_MESSAGE(loadFile(targetPath.c_str(), target), "target image missing");
+    if (baseEnv && targetEnv) {
+        // An ESP32 application image starts with 0xE9
+        TEST_ASSERT_EQUAL_UINT8(0xE9, base[0]);
+        TEST_ASSERT_EQUAL_UINT8(0xE9, target[0]);
+    }
+
+    Bytes file;
+    TEST_ASSERT_TRUE_MESSAGE(generateDelta(basePath, targetPath, file), "tools/make_delta.py failed");
+    // A real diff, not the target shipped again
+    TEST_ASSERT_LESS_THAN(target.size() / 4, file.size());
+    for (uint32_t seed = 1; seed <= 3; seed++) {
+        assertDeltaRebuildsTarget(file, base, target, seed);
+    }
+}
+
+void test_generated_delta_image_pair(void) {
+    Bytes base, target;
+    makeImagePair(base, target);
+    std::string tmp = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+    std::string basePath = tmp + "/paperdink_test_base.bin";
+    std::string targetPath = tmp + "/paperdink_test_target.bin";
+    FILE* file = fopen(basePath.c_str(), "wb");
+    TEST_ASSERT_NOT_NULL(file);
+    fwrite(base.data(), 1, base.size(), file);
+    fclose(file);
+    file = fopen(targetPath.c_str(), "wb");
+    TEST_ASSERT_NOT_NULL(file);
+    fwrite(target.data(), 1, target.size(), file);
+    fclose(file);
+
+    Bytes delta;
+    bool generated = generateDelta(basePath, targetPath, delta);
+    remove(basePath.c_str());
+    remove(targetPath.c_str());
+    TEST_ASSERT_TRUE_MESSAGE(generated, "tools/make_delta.py failed");
+    TEST_ASSERT_LESS_THAN(target.size() / 4, delta.size());
+    assertDeltaRebuildsTarget(delta, base, target, 1);
+}
+
+void test_image_pair_random_splits(void) {
+    Bytes base, target;
+    makeImagePair(base, target);
+    for (uint32_t seed = 1; seed <= 5; seed++) {
+        assertPatchRebuildsTarget(base, target, seed);
+    }
+}
+
+void test_truncated_patch(void) {
+    Bytes base, target;
+    makeImagePair(base, target);
+    Rng rng(7);
+    Bytes file = encodeDelta(base, target, rng);
+
+    // Compressed stream cut short: nothing fails, but it never completes
+    Bytes cut(file.begin(), file.end() - 64);
+    Rng splits(8);
+    PatchTarget patched;
+    TEST_ASSERT_FALSE(applyDelta(cut, base, splits, &patched));
+    TEST_ASSERT_LESS_THAN(target.size(), patched.output.size());
+
+    // Records cut inside a control triple
+    DeltaHeader header = makeHeader(base, target);
+    Rng recordRng(9);
+    Bytes records = encodeRecords(base, target, recordRng);
+    PatchTarget direct;
+    direct.base = &base;
+    direct.failReads = false;
+    direct.readOutOfRange = false;
+    DeltaPatcher patcher(readBase, writeTarget, &direct);
+    patcher.begin(header);
+    TEST_ASSERT_TRUE(patcher.feed(records.data(), records.size() - 1));
+    TEST_ASSERT_FALSE(patcher.isComplete());
+    TEST_ASSERT_FALSE(patcher.hasFailed());
+}
+
+void test_record_overrunning_target_fails(void) {
+    Bytes base(100, 7), target(100, 9);
+    DeltaHeader header = makeHeader(base, target);
+    PatchTarget patched;
+    patched.base = &base;
+    patched.failReads = false;
+    patched.readOutOfRange = false;
+
+    Bytes records;
+    putRecord(records, 60, 41, 0);  // 101 bytes into a 100-byte target
+    DeltaPatcher patcher(readBase, writeTarget, &patched);
+    patcher.begin(header);
+    TEST_ASSERT_FALSE(patcher.feed(records.data(), records.size()));
+    TEST_ASSERT_TRUE(patcher.hasFailed());
+    TEST_ASSERT_EQUAL_UINT32(0, patched.output.size());
+}
+
+void test_base_read_out_of_range_fails(void) {
+    Bytes base(100, 7), target(200, 9);
+    DeltaHeader header = makeHeader(base, target);
+    PatchTarget patched;
+    patched.base = &base;
+    patched.failReads = false;
+    patched.readOutOfRange = false;
+
+    // Seek before the start of the base
+    Bytes before;
+    putRecord(before, 10, 0, -20);
+    before.insert(before.end(), 10, 0);
+    putRecord(before, 5, 0, 0);  // Reads from base offset -10
+    before.insert(before.end(), 5, 0);
+    DeltaPatcher patcher(readBase, writeTarget, &patched);
+    patcher.begin(header);
+    TEST_ASSERT_FALSE(patcher.feed(before.data(), before.size()));
+    TEST_ASSERT_TRUE(patcher.hasFailed());
+    TEST_ASSERT_FALSE(patched.readOutOfRange);
+
+    // Diff run past the end of the base
+    Bytes past;
+    putRecord(past, 101, 0, 0);
+    past.insert(past.end(), 101, 0);
+    patched.output.clear();
+    patcher.begin(header);
+    TEST_ASSERT_FALSE(patcher.feed(past.data(), past.size()));
+    TEST_ASSERT_TRUE(patcher.hasFailed());
+    TEST_ASSERT_FALSE(patched.readOutOfRange);
+
+    // Base read error (flash read failed on the device)
+    Bytes valid;
+    putRecord(valid, 50, 0, 0);
+    valid.insert(valid.end(), 50, 0);
+    patched.output.clear();
+    patched.failReads = true;
+    patcher.begin(header);
+    TEST_ASSERT_FALSE(patcher.feed(valid.data(), valid.size()));
+    TEST_ASSERT_TRUE(patcher.hasFailed());
+}
+
+void test_trailing_bytes_fail(void) {
+    Bytes base(100, 7), target(100, 9);
+    DeltaHeader header = makeHeader(base, target);
+    PatchTarget patched;
+    patched.base = &base;
+    patched.failReads = false;
+    patched.readOutOfRange = false;
+
+    Bytes records;
+    putRecord(records, 100, 0, 0);
+    for (int i = 0; i < 100; i++) records.push_back(2);  // 7 + 2 = 9
+    DeltaPatcher patcher(readBase, writeTarget, &patched);
+    patcher.begin(header);
+    TEST_ASSERT_TRUE(patcher.feed(records.data(), records.size()));
+    TEST_ASSERT_TRUE(patcher.isComplete());
+    TEST_ASSERT_TRUE(patched.output == target);
+
+    uint8_t extra = 0;
+    TEST_ASSERT_FALSE(patcher.feed(&extra, 1));
+    TEST_ASSERT_TRUE(patcher.hasFailed());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_header_parse);
+    RUN_TEST(test_generated_delta_real_pair);
+    RUN_TEST(test_generated_delta_image_pair);
+    RUN_TEST(test_image_pair_random_splits);
+    RUN_TEST(test_truncated_patch);
+    RUN_TEST(test_record_overrunning_target_fails);
+    RUN_TEST(test_base_read_out_of_range_fails);
+    RUN_TEST(test_trailing_bytes_fail);
+    return UNITY_END();
+}
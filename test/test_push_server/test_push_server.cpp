@@ -0,0 +1,327 @@
+#include <unity.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "push_handler.h"
+#include "push_request.h"
+
+static const size_t FRAME_BYTES = 600 * 448 / 8;
+static const uint8_t PNG_SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+// A recorded request, handed out in the given piece sizes. Bytes after
+// holdUntilContinue only arrive once the handler has sent 100 Continue,
+// like curl does with Expect: 100-continue.
+class ScriptedStream : public PushStream {
+public:
+    std::string input;
+    std::vector<size_t> pieces;     // Cycled; empty means all at once
+    size_t holdUntilContinue;       // Offset in input; npos for none
+    bool closeWhenDrained;
+    std::string output;
+    uint32_t clock;
+
+    size_t offset;
+    size_t pieceIndex;
+
+    explicit ScriptedStream(const std::string& request)
+        : input(request), holdUntilContinue(std::string::npos), closeWhenDrained(true),
+          clock(1000), offset(0), pieceIndex(0) {}
+
+    size_t readable() const {
+        size_t end = input.size();
+        if (holdUntilContinue != std::string::npos &&
+            output.find("HTTP/1.1 100 Continue\r\n\r\n") == std::string::npos) {
+            end = holdUntilContinue;
+        }
+        return end > offset ? end - offset : 0;
+    }
+
+    int available() override {
+        size_t n = readable();
+        if (n > 0 && !pieces.empty()) {
+            size_t piece = pieces[pieceIndex % pieces.size()];
+            if (piece < n) n = piece;
+        }
+        return (int)n;
+    }
+
+    int read(uint8_t* buffer, size_t size) override {
+        size_t n = (size_t)available();
+        if (n > size) n = size;
+        memcpy(buffer, input.data() + offset, n);
+        offset += n;
+        pieceIndex++;
+        return (int)n;
+    }
+
+    size_t write(const uint8_t* data, size_t length) override {
+        output.append((const char*)data, length);
+        return length;
+    }
+
+    bool connected() override { return !closeWhenDrained || readable() > 0; }
+    uint32_t nowMs() override { return clock; }
+    void idle() override { clock += 1; }
+};
+
+struct Shown {
+    std::string image;
+    int calls;
+};
+
+static void recordImage(void* context, const uint8_t* image, size_t size) {
+    Shown* shown = (Shown*)context;
+    shown->image.assign((const char*)image, size);
+    shown->calls++;
+}
+
+static PushHandlerConfig makeConfig() {
+    PushHandlerConfig config;
+    config.path = "/image";
+    config.token = "s3cret";
+    config.maxBodySize = 122880;
+    config.frameBytes = FRAME_BYTES;
+    config.timeoutMs = 5000;
+    return config;
+}
+
+static std::string pngBody(size_t size) {
+    std::string body((const char*)PNG_SIGNATURE, 8);
+    for (size_t i = 8; i < size; i++) body.push_back((char)(i * 7));
+    return body;
+}
+
+static std::string putRequest(const std::string& body, const std::string& extraHeaders = "") {
+    return "PUT /image HTTP/1.1\r\nHost: 192.168.1.20\r\naccess-token: s3cret\r\n"
+           "Content-Length: " + std::to_string(body.size()) + "\r\n" + extraHeaders + "\r\n" + body;
+}
+
+static int serve(ScriptedStream& stream, Shown* shown) {
+    PushRequestHandler handler(recordImage, shown);
+    shown->calls = 0;
+    return handler.serve(stream, makeConfig());
+}
+
+static bool startsWith(const std::string& text, const char* prefix) {
+    return text.compare(0, strlen(prefix), prefix) == 0;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// --- PushRequestParser ---
+
+void test_parser_split_head(void) {
+    const char* head = "PUT /image?x=1 HTTP/1.1\r\nContent-Length: 42\r\n"
+                       "Authorization: Bearer abc\r\nContent-Type: image/png\r\n"
+                       "Expect: 100-continue\r\n\r\nBODY";
+    size_t headLength = strlen(head) - 4;
+
+    // Every split point of the head gives the same result
+    for (size_t split = 1; split < headLength; split++) {
+        PushRequestParser parser;
+        size_t used = parser.feed((const uint8_t*)head, split);
+        TEST_ASSERT_EQUAL(split, used);
+        TEST_ASSERT_FALSE(parser.isComplete());
+        used = parser.feed((const uint8_t*)head + split, strlen(head) - split);
+        TEST_ASSERT_EQUAL(headLength - split, used);
+        TEST_ASSERT_TRUE(parser.isComplete());
+        TEST_ASSERT_EQUAL(PUSH_METHOD_PUT, parser.getMethod());
+        TEST_ASSERT_EQUAL_STRING("/image", parser.getPath());
+        TEST_ASSERT_EQUAL_STRING("abc", parser.getToken());
+        TEST_ASSERT_EQUAL_STRING("image/png", parser.getContentType());
+        TEST_ASSERT_TRUE(parser.getContentLength() == 42);
+        TEST_ASSERT_TRUE(parser.expectsContinue());
+    }
+
+    // One byte at a time
+    PushRequestParser parser;
+    size_t used = 0;
+    for (size_t i = 0; i < headLength; i++) used += parser.feed((const uint8_t*)head + i, 1);
+    TEST_ASSERT_EQUAL(headLength, used);
+    TEST_ASSERT_TRUE(parser.isComplete());
+}
+
+void test_parser_defaults_and_errors(void) {
+    PushRequestParser parser;
+    const char* get = "GET /status HTTP/1.1\r\naccess-token: t\r\n\r\n";
+    parser.feed((const uint8_t*)get, strlen(get));
+    TEST_ASSERT_TRUE(parser.isComplete());
+    TEST_ASSERT_EQUAL(PUSH_METHOD_GET, parser.getMethod());
+    TEST_ASSERT_TRUE(parser.getContentLength() == -1);
+    TEST_ASSERT_FALSE(parser.expectsContinue());
+
+    parser.reset();
+    const char* bad = "NONSENSE\r\n\r\n";
+    parser.feed((const uint8_t*)bad, strlen(bad));
+    TEST_ASSERT_TRUE(parser.hasFailed());
+    TEST_ASSERT_EQUAL(400, parser.getErrorStatus());
+
+    parser.reset();
+    const char* badLength = "PUT /image HTTP/1.1\r\nContent-Length: 12a\r\n\r\n";
+    parser.feed((const uint8_t*)badLength, strlen(badLength));
+    TEST_ASSERT_TRUE(parser.hasFailed());
+    TEST_ASSERT_EQUAL(400, parser.getErrorStatus());
+
+    parser.reset();
+    std::string longPath = "PUT /" + std::string(100, 'a') + " HTTP/1.1\r\n\r\n";
+    parser.feed((const uint8_t*)longPath.data(), longPath.size());
+    TEST_ASSERT_TRUE(parser.hasFailed());
+    TEST_ASSERT_EQUAL(414, parser.getErrorStatus());
+
+    parser.reset();
+    std::string longHeader = "PUT /image HTTP/1.1\r\nX-Pad: " + std::string(300, 'p') + "\r\n\r\n";
+    parser.feed((const uint8_t*)longHeader.data(), longHeader.size());
+    TEST_ASSERT_TRUE(parser.hasFailed());
+    TEST_ASSERT_EQUAL(431, parser.getErrorStatus());
+}
+
+// --- PushRequestHandler ---
+
+void test_serve_shows_image(void) {
+    std::string body = pngBody(5000);
+    ScriptedStream stream(putRequest(body));
+    stream.pieces = { 7, 1, 300, 13 };
+    Shown shown;
+    TEST_ASSERT_EQUAL(204, serve(stream, &shown));
+    TEST_ASSERT_EQUAL(1, shown.calls);
+    TEST_ASSERT_TRUE(shown.image == body);
+    TEST_ASSERT_TRUE(startsWith(stream.output, "HTTP/1.1 204 No Content\r\n"));
+}
+
+void test_serve_body_in_head_chunk(void) {
+    // Head and the whole body arrive in one read
+    std::string body = pngBody(100);
+    ScriptedStream stream(putRequest(body));
+    Shown shown;
+    TEST_ASSERT_EQUAL(204, serve(stream, &shown));
+    TEST_ASSERT_TRUE(shown.image == body);
+
+    // Head plus the first part of the body in one read, the rest later
+    std::string larger = pngBody(3000);
+    std::string request = putRequest(larger);
+    size_t headLength = request.size() - larger.size();
+    ScriptedStream split(request);
+    split.pieces = { headLength + 50, 1000 };
+    TEST_ASSERT_EQUAL(204, serve(split, &shown));
+    TEST_ASSERT_TRUE(shown.image == larger);
+}
+
+void test_serve_expect_continue(void) {
+    std::string body = pngBody(2000);
+    std::string request = putRequest(body, "Expect: 100-continue\r\n");
+    ScriptedStream stream(request);
+    stream.holdUntilContinue = request.size() - body.size();
+    Shown shown;
+    TEST_ASSERT_EQUAL(204, serve(stream, &shown));
+    TEST_ASSERT_TRUE(shown.image == body);
+    TEST_ASSERT_TRUE(startsWith(stream.output, "HTTP/1.1 100 Continue\r\n\r\nHTTP/1.1 204"));
+
+    // Rejected before the body: no 100 Continue
+    std::string wrongToken = "PUT /image HTTP/1.1\r\naccess-token: nope\r\nContent-Length: 2000\r\n"
+                             "Expect: 100-continue\r\n\r\n";
+    ScriptedStream rejected(wrongToken);
+    TEST_ASSERT_EQUAL(401, serve(rejected, &shown));
+    TEST_ASSERT_TRUE(startsWith(rejected.output, "HTTP/1.1 401 Unauthorized\r\n"));
+}
+
+void test_serve_rejects_token(void) {
+    Shown shown;
+    std::string missing = "PUT /image HTTP/1.1\r\nContent-Length: 10\r\n\r\n";
+    ScriptedStream noToken(missing + pngBody(10));
+    TEST_ASSERT_EQUAL(401, serve(noToken, &shown));
+
+    std::string wrong = "PUT /image HTTP/1.1\r\nAuthorization: Bearer s3cre\r\nContent-Length: 10\r\n\r\n";
+    ScriptedStream wrongToken(wrong + pngBody(10));
+    TEST_ASSERT_EQUAL(401, serve(wrongToken, &shown));
+
+    // Same length, longer, and the token repeated
+    const char* near[] = { "s3creT", "s3cret0", "s3crets3cret" };
+    for (size_t i = 0; i < sizeof(near) / sizeof(near[0]); i++) {
+        std::string request = std::string("PUT /image HTTP/1.1\r\naccess-token: ") + near[i] +
+                              "\r\nContent-Length: 10\r\n\r\n" + pngBody(10);
+        ScriptedStream nearToken(request);
+        TEST_ASSERT_EQUAL(401, serve(nearToken, &shown));
+    }
+
+    // An empty configured token never matches, not even an empty header
+    PushHandlerConfig config = makeConfig();
+    config.token = "";
+    std::string empty = "PUT /image HTTP/1.1\r\naccess-token: \r\nContent-Length: 10\r\n\r\n";
+    ScriptedStream emptyToken(empty + pngBody(10));
+    PushRequestHandler handler(recordImage, &shown);
+    shown.calls = 0;
+    TEST_ASSERT_EQUAL(401, handler.serve(emptyToken, config));
+    TEST_ASSERT_EQUAL(0, shown.calls);
+}
+
+void test_serve_rejects_path_and_method(void) {
+    Shown shown;
+    ScriptedStream otherPath("PUT /other HTTP/1.1\r\naccess-token: s3cret\r\nContent-Length: 1\r\n\r\nx");
+    TEST_ASSERT_EQUAL(404, serve(otherPath, &shown));
+    TEST_ASSERT_TRUE(startsWith(otherPath.output, "HTTP/1.1 404 Not Found\r\n"));
+
+    ScriptedStream get("GET /image HTTP/1.1\r\naccess-token: s3cret\r\n\r\n");
+    TEST_ASSERT_EQUAL(405, serve(get, &shown));
+    TEST_ASSERT_TRUE(startsWith(get.output, "HTTP/1.1 405 Method Not Allowed\r\n"));
+    TEST_ASSERT_EQUAL(0, shown.calls);
+}
+
+void test_serve_rejects_length(void) {
+    Shown shown;
+    ScriptedStream noLength("PUT /image HTTP/1.1\r\naccess-token: s3cret\r\n\r\n");
+    TEST_ASSERT_EQUAL(411, serve(noLength, &shown));
+
+    ScriptedStream zero("PUT /image HTTP/1.1\r\naccess-token: s3cret\r\nContent-Length: 0\r\n\r\n");
+    TEST_ASSERT_EQUAL(413, serve(zero, &shown));
+
+    ScriptedStream tooLarge("PUT /image HTTP/1.1\r\naccess-token: s3cret\r\nContent-Length: 122881\r\n\r\n");
+    TEST_ASSERT_EQUAL(413, serve(tooLarge, &shown));
+    TEST_ASSERT_TRUE(startsWith(tooLarge.output, "HTTP/1.1 413 Payload Too Large\r\n"));
+    TEST_ASSERT_EQUAL(0, shown.calls);
+}
+
+void test_serve_rejects_unknown_format(void) {
+    Shown shown;
+    ScriptedStream text(putRequest("hello, panel"));
+    TEST_ASSERT_EQUAL(415, serve(text, &shown));
+    TEST_ASSERT_TRUE(startsWith(text.output, "HTTP/1.1 415 Unsupported Media Type\r\n"));
+    TEST_ASSERT_EQUAL(0, shown.calls);
+
+    // BMP magic and an exact raw frame are accepted
+    ScriptedStream bmp(putRequest("BM" + std::string(60, '\0')));
+    TEST_ASSERT_EQUAL(204, serve(bmp, &shown));
+    ScriptedStream frame(putRequest(std::string(FRAME_BYTES, '\x55')));
+    frame.pieces = { 1460 };
+    TEST_ASSERT_EQUAL(204, serve(frame, &shown));
+}
+
+void test_serve_short_body_times_out(void) {
+    std::string request = putRequest(pngBody(1000));
+    ScriptedStream stream(request.substr(0, request.size() - 10));
+    stream.closeWhenDrained = false;  // Client stalls with the connection open
+    Shown shown;
+    TEST_ASSERT_EQUAL(408, serve(stream, &shown));
+    TEST_ASSERT_TRUE(startsWith(stream.output, "HTTP/1.1 408 Request Timeout\r\n"));
+    TEST_ASSERT_EQUAL(0, shown.calls);
+
+    // Client gone before the head was complete: nothing to answer
+    ScriptedStream gone("PUT /image HTTP/1.1\r\nContent-");
+    TEST_ASSERT_EQUAL(0, serve(gone, &shown));
+    TEST_ASSERT_TRUE(gone.output.empty());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_parser_split_head);
+    RUN_TEST(test_parser_defaults_and_errors);
+    RUN_TEST(test_serve_shows_image);
+    RUN_TEST(test_serve_body_in_head_chunk);
+    RUN_TEST(test_serve_expect_continue);
+    RUN_TEST(test_serve_rejects_token);
+    RUN_TEST(test_serve_rejects_path_and_method);
+    RUN_TEST(test_serve_rejects_length);
+    RUN_TEST(test_serve_rejects_unknown_format);
+    RUN_TEST(test_serve_short_body_times_out);
+    return UNITY_END();
+}
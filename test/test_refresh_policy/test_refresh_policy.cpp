@@ -0,0 +1,116 @@
+#include <unity.h>
+#include "refresh_policy.h"
+
+// Same shape as the device build (REFRESH_* in config.h)
+static const SocStretchPoint socCurve[] = { {50, 100}, {30, 150}, {15, 250}, {5, 400} };
+static const RefreshPolicyConfig policyConfig = {
+    socCurve, 4,
+    23 * 3600, 6 * 3600,  // Quiet 23:00-06:00
+    4,
+    60, 86400
+};
+static const RefreshPolicy policy(policyConfig);
+
+static RefreshPolicyInput makeInput(int batteryPercent) {
+    RefreshPolicyInput input;
+    input.serverRefreshSeconds = 600;
+    input.batteryPercent = batteryPercent;
+    input.charging = false;
+    input.localSecondOfDay = -1;
+    input.unchangedCycles = 0;
+    return input;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_soc_curve_points_and_interpolation(void) {
+    TEST_ASSERT_EQUAL_UINT16(100, policy.socIntervalPercent(100));
+    TEST_ASSERT_EQUAL_UINT16(100, policy.socIntervalPercent(50));
+    TEST_ASSERT_EQUAL_UINT16(125, policy.socIntervalPercent(40));
+    TEST_ASSERT_EQUAL_UINT16(150, policy.socIntervalPercent(30));
+    TEST_ASSERT_EQUAL_UINT16(250, policy.socIntervalPercent(15));
+    TEST_ASSERT_EQUAL_UINT16(325, policy.socIntervalPercent(10));
+    TEST_ASSERT_EQUAL_UINT16(400, policy.socIntervalPercent(5));
+    TEST_ASSERT_EQUAL_UINT16(400, policy.socIntervalPercent(0));
+}
+
+void test_draining_battery_never_shortens_sleep(void) {
+    // Simulated discharge, one percent per wake
+    uint32_t previous = 0;
+    for (int percent = 100; percent >= 0; percent--) {
+        uint32_t sleep = policy.nextSleepSeconds(makeInput(percent));
+        TEST_ASSERT_TRUE(sleep >= previous);
+        previous = sleep;
+    }
+    TEST_ASSERT_EQUAL_UINT32(600, policy.nextSleepSeconds(makeInput(80)));
+    TEST_ASSERT_EQUAL_UINT32(900, policy.nextSleepSeconds(makeInput(30)));
+    TEST_ASSERT_EQUAL_UINT32(2400, policy.nextSleepSeconds(makeInput(3)));
+}
+
+void test_charging_follows_server(void) {
+    RefreshPolicyInput input = makeInput(3);
+    input.charging = true;
+    TEST_ASSERT_EQUAL_UINT32(600, policy.nextSleepSeconds(input));
+
+    // Neither quiet hours nor unchanged content stretch it on external power
+    input.localSecondOfDay = 2 * 3600;
+    input.unchangedCycles = 3;
+    TEST_ASSERT_EQUAL_UINT32(600, policy.nextSleepSeconds(input));
+}
+
+void test_quiet_hours_window(void) {
+    TEST_ASSERT_FALSE(policy.inQuietHours(22 * 3600));
+    TEST_ASSERT_TRUE(policy.inQuietHours(23 * 3600));
+    TEST_ASSERT_TRUE(policy.inQuietHours(0));
+    TEST_ASSERT_TRUE(policy.inQuietHours(6 * 3600 - 1));
+    TEST_ASSERT_FALSE(policy.inQuietHours(6 * 3600));
+    TEST_ASSERT_EQUAL_UINT32(6 * 3600 + 1800, policy.secondsUntilQuietEnd(23 * 3600 + 1800));
+
+    SocStretchPoint flat[] = { {0, 100} };
+    RefreshPolicyConfig noQuiet = { flat, 1, 3600, 3600, 1, 60, 86400 };
+    TEST_ASSERT_FALSE(RefreshPolicy(noQuiet).inQuietHours(3600));
+}
+
+void test_sleeps_through_quiet_hours(void) {
+    RefreshPolicyInput input = makeInput(80);
+
+    // Inside quiet hours: sleep until they end
+    input.localSecondOfDay = 23 * 3600 + 1800;
+    TEST_ASSERT_EQUAL_UINT32(6 * 3600 + 1800, policy.nextSleepSeconds(input));
+
+    // A wake that would land in quiet hours moves to their end
+    input.localSecondOfDay = 22 * 3600 + 55 * 60;
+    TEST_ASSERT_EQUAL_UINT32(600 + 6 * 3600 + 55 * 60, policy.nextSleepSeconds(input));
+
+    // Daytime and unknown clock: unchanged
+    input.localSecondOfDay = 12 * 3600;
+    TEST_ASSERT_EQUAL_UINT32(600, policy.nextSleepSeconds(input));
+    input.localSecondOfDay = -1;
+    TEST_ASSERT_EQUAL_UINT32(600, policy.nextSleepSeconds(input));
+}
+
+void test_unchanged_content_and_clamp(void) {
+    RefreshPolicyInput input = makeInput(80);
+    input.unchangedCycles = 1;
+    TEST_ASSERT_EQUAL_UINT32(1200, policy.nextSleepSeconds(input));
+    input.unchangedCycles = 5;
+    TEST_ASSERT_EQUAL_UINT32(2400, policy.nextSleepSeconds(input));
+
+    input = makeInput(80);
+    input.serverRefreshSeconds = 10;
+    TEST_ASSERT_EQUAL_UINT32(60, policy.nextSleepSeconds(input));
+    input.serverRefreshSeconds = 200000;
+    TEST_ASSERT_EQUAL_UINT32(86400, policy.nextSleepSeconds(input));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_soc_curve_points_and_interpolation);
+    RUN_TEST(test_draining_battery_never_shortens_sleep);
+    RUN_TEST(test_charging_follows_server);
+    RUN_TEST(test_quiet_hours_window);
+    RUN_TEST(test_sleeps_through_quiet_hours);
+    RUN_TEST(test_unchanged_content_and_clamp);
+    return UNITY_END();
+}
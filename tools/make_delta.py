@@ -0,0 +1,185 @@
+#!/usr/bin/env python3
+"""Build a firmware delta for firmware_delta_url.
+
+    python3 tools/make_delta.py base.bin target.bin out.delta
+
+base.bin is the image the devices run now (the firmware.bin of that
+release), target.bin the new one. The output is the format described in
+include/delta_patch.h: the 80-byte header followed by a zlib stream of
+sequential bsdiff records. Records are found with bsdiff's algorithm
+(suffix array of the base, approximate matches extended forwards and
+backwards), so a rebuilt image with shifted addresses still patches with
+mostly zero diff bytes. Standard library only; run it on the server side
+next to the firmware_url image.
+"""
+
+import hashlib
+import struct
+import sys
+import zlib
+
+MAGIC = b"PDDELTA1"
+
+
+def suffix_array(data):
+    """Suffix array by prefix doubling, with the empty suffix at index 0."""
+    n = len(data)
+    sa = list(range(n))
+    rank = list(data)
+    k = 1
+    while n > 1:
+        key = [(rank[i], rank[i + k] if i + k < n else -1) for i in range(n)]
+        sa.sort(key=key.__getitem__)
+        fresh = [0] * n
+        for j in range(1, n):
+            fresh[sa[j]] = fresh[sa[j - 1]] + (key[sa[j]] != key[sa[j - 1]])
+        rank = fresh
+        if rank[sa[-1]] == n - 1:
+            break
+        k *= 2
+    return [n] + sa
+
+
+def match_length(a, a_pos, b, b_pos):
+    n = min(len(a) - a_pos, len(b) - b_pos)
+    length = 0
+    step = 64
+    while length < n:
+        m = min(step, n - length)
+        if a[a_pos + length:a_pos + length + m] == b[b_pos + length:b_pos + length + m]:
+            length += m
+            continue
+        while length < n and a[a_pos + length] == b[b_pos + length]:
+            length += 1
+        break
+    return length
+
+
+def compare(a, a_pos, b, b_pos):
+    """memcmp of a[a_pos:] and b[b_pos:] over the shorter length: <0, 0, >0."""
+    length = match_length(a, a_pos, b, b_pos)
+    if a_pos + length == len(a) or b_pos + length == len(b):
+        return 0
+    return a[a_pos + length] - b[b_pos + length]
+
+
+def search(sa, old, new, scan, start, end):
+    """Longest match of new[scan:] in old; returns (length, position)."""
+    while end - start >= 2:
+        middle = start + (end - start) // 2
+        if compare(old, sa[middle], new, scan) < 0:
+            start = middle
+        else:
+            end = middle
+    x = match_length(old, sa[start], new, scan)
+    y = match_length(old, sa[end], new, scan)
+    return (x, sa[start]) if x > y else (y, sa[end])
+
+
+def diff_records(old, new):
+    """bsdiff's main loop; yields (diff_len, extra_len, seek, diff, extra)."""
+    sa = suffix_array(old)
+    old_size = len(old)
+    new_size = len(new)
+    scan = length = last_scan = last_pos = last_offset = 0
+    pos = 0
+
+    def old_at(i):
+        return old[i] if 0 <= i < old_size else None
+
+    while scan < new_size:
+        old_score = 0
+        scan += length
+        scsc = scan
+        while scan < new_size:
+            length, pos = search(sa, old, new, scan, 0, old_size)
+            while scsc < scan + length:
+                if old_at(scsc + last_offset) == new[scsc]:
+                    old_score += 1
+                scsc += 1
+            if (length == old_score and length != 0) or length > old_score + 8:
+                break
+            if old_at(scan + last_offset) == new[scan]:
+                old_score -= 1
+            scan += 1
+
+        if length == old_score and scan != new_size:
+            continue
+
+        # Extend the previous match forwards ...
+        s = best = len_f = 0
+        i = 0
+        while last_scan + i < scan and last_pos + i < old_size:
+            if old[last_pos + i] == new[last_scan + i]:
+                s += 1
+            i += 1
+            if s * 2 - i > best * 2 - len_f:
+                best, len_f = s, i
+
+        # ... and the next one backwards
+        len_b = 0
+        if scan < new_size:
+            s = best = 0
+            i = 1
+            while scan >= last_scan + i and pos >= i:
+                if old[pos - i] == new[scan - i]:
+                    s += 1
+                if s * 2 - i > best * 2 - len_b:
+                    best, len_b = s, i
+                i += 1
+
+        # Split an overlap where it scores best
+        if last_scan + len_f > scan - len_b:
+            overlap = (last_scan + len_f) - (scan - len_b)
+            s = best = len_s = 0
+            for i in range(overlap):
+                if new[last_scan + len_f - overlap + i] == old[last_pos + len_f - overlap + i]:
+                    s += 1
+                if new[scan - len_b + i] == old[pos - len_b + i]:
+                    s -= 1
+                if s > best:
+                    best, len_s = s, i + 1
+            len_f += len_s - overlap
+            len_b -= len_s
+
+        diff = bytes((new[last_scan + i] - old[last_pos + i]) & 0xFF for i in range(len_f))
+        extra = new[last_scan + len_f:scan - len_b]
+        seek = (pos - len_b) - (last_pos + len_f)
+        yield len_f, len(extra), seek, diff, extra
+
+        last_scan = scan - len_b
+        last_pos = pos - len_b
+        last_offset = pos - scan
+
+
+def make_delta(old, new):
+    records = bytearray()
+    for diff_len, extra_len, seek, diff, extra in diff_records(old, new):
+        records += struct.pack("<IIi", diff_len, extra_len, seek)
+        records += diff
+        records += extra
+    header = MAGIC + struct.pack("<II", len(old), len(new))
+    header += hashlib.sha256(old).digest() + hashlib.sha256(new).digest()
+    return header + zlib.compress(bytes(records), 9)
+
+
+def main(argv):
+    if len(argv) != 4:
+        sys.stderr.write("usage: make_delta.py base.bin target.bin out.delta\n")
+        return 2
+    with open(argv[1], "rb") as f:
+        old = f.read()
+    with open(argv[2], "rb") as f:
+        new = f.read()
+    if not old or not new:
+        sys.stderr.write("make_delta.py: empty image\n")
+        return 1
+    delta = make_delta(old, new)
+    with open(argv[3], "wb") as f:
+        f.write(delta)
+    print("%s: %d bytes for a %d-byte image" % (argv[3], len(delta), len(new)))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))